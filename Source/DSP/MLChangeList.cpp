@@ -9,6 +9,7 @@ MLChangeList::MLChangeList() : mSize(0), mChanges(0), mValue(0.f)
 {	
 	// setup glide time = 1 sample
 	mGlideCounter = 0;
+	mGlideShape = kMLGlideLinear;
 	mGlideTimeInSamples = 1;
 	mInvGlideTimeInSamples = 1.f;
 	mGlideTime = 0.f;
@@ -94,6 +95,13 @@ void MLChangeList::addChange(MLSample val, int time)
 	}
 }
 
+void MLChangeList::setValue(MLSample val)
+{
+	clearChanges();
+	mValue = mGlideStartValue = mGlideEndValue = val;
+	mGlideCounter = 0;
+}
+
 inline void MLChangeList::setGlideTarget(float target)
 {
 	mGlideStartValue = mValue;
@@ -101,6 +109,120 @@ inline void MLChangeList::setGlideTarget(float target)
 	mGlideCounter = mGlideTimeInSamples;
 }
 
+// steepness of the exponential glide shape.
+static const float kExpGlideCurve = 5.f;
+
+// write frames samples of the current glide, with the glide position x0 at the first sample
+// and increasing by dx each sample.
+void MLChangeList::writeRamp(MLSample* y, int frames, float x0, float dx)
+{
+	const float a = mGlideStartValue;
+	const float d = mGlideEndValue - mGlideStartValue;
+	const int vectors = frames >> kMLSamplesPerSSEVectorBits;
+	const int vFrames = vectors << kMLSamplesPerSSEVectorBits;
+	const __m128 vA = _mm_set1_ps(a);
+	const __m128 vD = _mm_set1_ps(d);
+	const __m128 vK = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+	int t;
+	
+	switch(mGlideShape)
+	{
+		case kMLGlideLinear:
+		default:
+		{
+			// y = a + d*x, as start + k*step.
+			__m128 vY = _mm_add_ps(_mm_set1_ps(a + d*x0), _mm_mul_ps(vK, _mm_set1_ps(d*dx)));
+			const __m128 vStep = _mm_set1_ps(d*dx*kSSEVecSize);
+			for(t = 0; t < vFrames; t += kSSEVecSize)
+			{
+				_mm_storeu_ps(y + t, vY);
+				vY = _mm_add_ps(vY, vStep);
+			}
+			for(; t < frames; ++t)
+			{
+				y[t] = a + d*(x0 + dx*t);
+			}
+			break;
+		}
+		case kMLGlideExponential:
+		{
+			// y = a + d*(1 - e^(-cx))/(1 - e^(-c)) = b - s*m, with m = e^(-cx) 
+			// multiplied by a constant ratio each sample.
+			const float scale = d/(1.f - expf(-kExpGlideCurve));
+			const float r = expf(-kExpGlideCurve*dx);
+			const float r2 = r*r;
+			const float r4 = r2*r2;
+			const __m128 vB = _mm_set1_ps(a + scale);
+			const __m128 vS = _mm_set1_ps(scale);
+			const __m128 vR4 = _mm_set1_ps(r4);
+			const float m0 = expf(-kExpGlideCurve*x0);
+			__m128 vM = _mm_mul_ps(_mm_set1_ps(m0), _mm_set_ps(r2*r, r2, r, 1.f));
+			for(t = 0; t < vFrames; t += kSSEVecSize)
+			{
+				_mm_storeu_ps(y + t, _mm_sub_ps(vB, _mm_mul_ps(vS, vM)));
+				vM = _mm_mul_ps(vM, vR4);
+			}
+			float m = m0*powf(r, (float)vFrames);
+			for(; t < frames; ++t)
+			{
+				y[t] = a + scale - scale*m;
+				m *= r;
+			}
+			break;
+		}
+		case kMLGlideSCurve:
+		{
+			// y = a + d*x*x*(3 - 2x)
+			const __m128 vThree = _mm_set1_ps(3.f);
+			const __m128 vTwo = _mm_set1_ps(2.f);
+			__m128 vX = _mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(vK, _mm_set1_ps(dx)));
+			const __m128 vStep = _mm_set1_ps(dx*kSSEVecSize);
+			for(t = 0; t < vFrames; t += kSSEVecSize)
+			{
+				__m128 vF = _mm_mul_ps(_mm_mul_ps(vX, vX), _mm_sub_ps(vThree, _mm_mul_ps(vTwo, vX)));
+				_mm_storeu_ps(y + t, _mm_add_ps(vA, _mm_mul_ps(vD, vF)));
+				vX = _mm_add_ps(vX, vStep);
+			}
+			for(; t < frames; ++t)
+			{
+				float x = x0 + dx*t;
+				y[t] = a + d*x*x*(3.f - 2.f*x);
+			}
+			break;
+		}
+	}
+}
+
+// write the current glide, or the current value if not gliding, to y[start, end). 
+void MLChangeList::writeSegment(MLSample* y, int start, int end)
+{
+	if (end <= start) return;
+	int t = start;
+	if (mGlideCounter > 0)
+	{
+		const int n = min(end - start, mGlideCounter);
+		const float x0 = (float)(mGlideTimeInSamples - mGlideCounter + 1) * mInvGlideTimeInSamples;
+		writeRamp(y + t, n, x0, mInvGlideTimeInSamples);
+		mGlideCounter -= n;
+		t += n;
+		
+		// land exactly on the target at the end of a glide.
+		if (mGlideCounter <= 0)
+		{
+			mValue = mGlideEndValue;
+			y[t - 1] = mValue;
+		}
+		else
+		{
+			mValue = y[t - 1];
+		}
+	}
+	for(; t < end; ++t)
+	{
+		y[t] = mValue;
+	}
+}
+
 // write the input change list from the given offset into the output signal y .
 // 
 void MLChangeList::writeToSignal(MLSignal& y, int frames)
@@ -109,75 +231,45 @@ void MLChangeList::writeToSignal(MLSignal& y, int frames)
 	size = min(size, frames);
 	int t=0;
 	int changeTime;
-	y.setConstant(false);
+	
+	// a single change at the start of the buffer with no glide time is a step: 
+	// the output is constant from here.
+	if ((mChanges == 1) && ((int)mTimeSignal[0] == 0) && (mGlideTimeInSamples <= 1))
+	{
+		mValue = mValueSignal[0];
+		mGlideCounter = 0;
+		mChanges = 0;
+	}
 	
 	// no changes, no glide?  mark constant and bail.
 	if (!mChanges && (mGlideCounter <= 0)) 
 	{
 		y.setToConstant(mValue);		
+		return;
 	}
-	else if (!mChanges) // just gliding to target
-	{
-		for(; t<size; ++t)
-		{
-			// tick glide
-			if (mGlideCounter > 0) 
-			{
-				mGlideCounter--;
-				float x = (float)(mGlideTimeInSamples - mGlideCounter) * mInvGlideTimeInSamples;
-				mValue = lerp(mGlideStartValue, mGlideEndValue, x);
-			}
-			y[t] = mValue;
-		}
-	}
-	else
-	{
-		y.setConstant(false);
 	
-		// write current value up to each change time, then change current value
-		for(int i = 0; i<mChanges; ++i)
+	MLSample* py = y.getBuffer();
+	y.setConstant(false);
+	
+	// write current value or glide up to each change time, then start a new glide.
+	for(int i = 0; i<mChanges; ++i)
+	{
+		changeTime = (int)mTimeSignal[i];
+		if (changeTime >= size)
 		{
-			changeTime = (int)mTimeSignal[i];
-			if (changeTime >= size)
-            {
 #ifdef DEBUG
-                debug() << "warning: MLChangeList time (" << changeTime <<  ") > size!\n";
+			debug() << "warning: MLChangeList time (" << changeTime <<  ") > size!\n";
 #endif
-                
-                break;
-            }
-			
-			// write current glide up to change
-			for(; t<changeTime; ++t)
-			{
-				// tick glide
-				if (mGlideCounter > 0) 
-				{
-					mGlideCounter--;
-					float mx = (float)(mGlideTimeInSamples - mGlideCounter) * mInvGlideTimeInSamples;
-					mValue = lerp(mGlideStartValue, mGlideEndValue, mx);
-				}				
-				y[t] = mValue;			
-			}
-			
-			float nextTarget = mValueSignal[i];
-			setGlideTarget(nextTarget);
+			break;
 		}
-		
-		// tick out to end
-		for(; t<size; ++t)
-		{
-			// tick glide
-			if (mGlideCounter > 0) 
-			{
-				mGlideCounter--;
-				float mx = (float)(mGlideTimeInSamples - mGlideCounter) * mInvGlideTimeInSamples;
-				mValue = lerp(mGlideStartValue, mGlideEndValue, mx);
-			}
-			y[t] = mValue;
-		}		
-		mChanges = 0;
+		writeSegment(py, t, changeTime);
+		t = max(t, changeTime);
+		setGlideTarget(mValueSignal[i]);
 	}
+	
+	// write out to end
+	writeSegment(py, t, size);
+	mChanges = 0;
 }
 
 void MLChangeList::dump(void)
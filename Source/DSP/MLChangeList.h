@@ -10,9 +10,20 @@
 // wavelet-based or similar analytic description of a signal
 // might be a better, more general, tool for making synthesizers.
 
+// shapes for gliding from one value to the next.
+// exponential moves quickly at first and slows toward the target.
+// S-curve eases in and out.
+enum eMLGlideShape
+{
+	kMLGlideLinear = 0,
+	kMLGlideExponential,
+	kMLGlideSCurve
+};
+
 // MLChangeList stores an ordered list of time-stamped changes to a scalar 
 // value that can be written out to a 1D time domain signal.
 // Changes are relative to the start of a process buffer, and must be added in order. 
+// Between changes, glides are written as SIMD ramps and constant values as fills.
 //
 class MLChangeList 
 {
@@ -24,7 +35,11 @@ public:
 	void clearChanges();
 	void zero();
 	void addChange(MLSample val, int time);
+	
+	// jump to val now, without gliding, and clear any changes.
+	void setValue(MLSample val);
 	void setGlideTime(float time);
+	void setGlideShape(eMLGlideShape shape) { mGlideShape = shape; }
 	void setSampleRate(unsigned rate);
 	void writeToSignal(MLSignal& y, int frames);
 	void dump();
@@ -32,6 +47,8 @@ public:
 private:
 	void calcGlide();
 	inline void setGlideTarget(float target);
+	void writeSegment(MLSample* y, int start, int end);
+	void writeRamp(MLSample* y, int frames, float x0, float dx);
 
 	// size of the output vector.
 	int mSize;
@@ -43,6 +60,7 @@ private:
 	int mGlideTimeInSamples;
 	float mInvGlideTimeInSamples;
 	int mGlideCounter;
+	eMLGlideShape mGlideShape;
 	
 	MLSample mValue;
 	MLSample mGlideStartValue;
@@ -55,6 +55,24 @@ public:
     int findFreeEvent() const;
 };
 
+// a range of events [begin, end) in storage owned by someone else, so a block's
+// events can be handed out piece by piece without copying.
+class MLControlEventSpan
+{
+public:
+    MLControlEventSpan() : mpBegin(0), mpEnd(0) {}
+    MLControlEventSpan(const MLControlEvent* b, const MLControlEvent* e) : mpBegin(b), mpEnd(e) {}
+    
+    const MLControlEvent* begin() const { return mpBegin; }
+    const MLControlEvent* end() const { return mpEnd; }
+    int size() const { return (int)(mpEnd - mpBegin); }
+    bool empty() const { return mpEnd == mpBegin; }
+    
+private:
+    const MLControlEvent* mpBegin;
+    const MLControlEvent* mpEnd;
+};
+
 
 
 #endif /* defined(__Aalto__MLControlEvent__) */
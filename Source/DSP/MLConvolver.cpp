@@ -0,0 +1,490 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLConvolver.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolverKernel
+
+MLConvolverKernel::MLConvolverKernel() :
+	mLength(0),
+	mHeadPartitions(0),
+	mTailPartitions(0)
+{
+}
+
+MLConvolverKernel::~MLConvolverKernel()
+{
+}
+
+bool MLConvolverKernel::build(const MLSignal& ir)
+{
+	const int length = ir.getWidth();
+	if (length < 1)
+	{
+		debug() << "MLConvolverKernel::build: empty impulse\n";
+		return false;
+	}
+	mLength = length;
+
+	const int head = kMLConvolverHeadSize;
+	mDirect.setDims(head);
+	for(int k=0; k<head; ++k)
+	{
+		const int t = head - 1 - k;
+		mDirect[k] = (t < length) ? ir[t] : 0.f;
+	}
+
+	mHeadPartitions = clamp((length - head + head - 1)/head, 0, (int)kMLConvolverHeadPartitions);
+	mTailPartitions = max((length - kMLConvolverTailStart + kMLConvolverTailBlockSize - 1)/kMLConvolverTailBlockSize, 0);
+	makePartitions(ir, head, head, mHeadPartitions, mHeadRe, mHeadIm);
+	makePartitions(ir, kMLConvolverTailStart, kMLConvolverTailBlockSize, mTailPartitions, mTailRe, mTailIm);
+	return true;
+}
+
+// make the spectrum of each partition, zero-padded to twice its size for overlap-save.
+void MLConvolverKernel::makePartitions(const MLSignal& ir, int start, int size, int partitions, MLSignal& re, MLSignal& im)
+{
+	MLFFT fft;
+	fft.resize(size*2);
+	re.setDims(size, max(partitions, 1));
+	im.setDims(size, max(partitions, 1));
+	MLSignal block(size*2);
+	const int length = ir.getWidth();
+	for(int j=0; j<partitions; ++j)
+	{
+		block.clear();
+		const int first = start + j*size;
+		const int count = min(size, length - first);
+		for(int i=0; i<count; ++i)
+		{
+			block[i] = ir[first + i];
+		}
+		fft.forward(block.getConstBuffer(), re.getBuffer() + re.row(j), im.getBuffer() + im.row(j));
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLImpulseBank
+
+MLImpulseBank::MLImpulseBank()
+{
+	for(int i=0; i<kMLMaxImpulses; ++i)
+	{
+		mKernelPtrs[i] = 0;
+	}
+}
+
+MLImpulseBank::~MLImpulseBank()
+{
+}
+
+bool MLImpulseBank::setImpulse(int index, const MLSignal& ir)
+{
+	if (!within(index, 0, kMLMaxImpulses)) return false;
+	MLConvolverKernelPtr pKernel(new MLConvolverKernel);
+	if (!pKernel->build(ir)) return false;
+	if (mKernels[index])
+	{
+		mRetiredKernels.push_back(mKernels[index]);
+	}
+	mKernels[index] = pKernel;
+	mKernelPtrs[index] = pKernel.get();
+	return true;
+}
+
+void MLImpulseBank::releaseUnusedImpulses()
+{
+	MLConvolverWorker::theWorker().waitUntilIdle();
+	mRetiredKernels.clear();
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolverWorker
+
+const int kMLConvolverWorkerPollMicros = 500;
+
+void* MLConvolverWorkerThread(void* arg)
+{
+	MLConvolverWorker* pW = static_cast<MLConvolverWorker*>(arg);
+	pW->run();
+	return 0;
+}
+
+MLConvolverWorker::MLConvolverWorker() :
+	mRunning(false),
+	mEnabled(true),
+	mIdlePasses(0)
+{
+	pthread_mutex_init(&mMutex, 0);
+}
+
+MLConvolverWorker::~MLConvolverWorker()
+{
+	stopThread();
+	pthread_mutex_destroy(&mMutex);
+}
+
+void MLConvolverWorker::addConvolver(MLConvolver* pC)
+{
+	lock();
+	mConvolvers.push_back(pC);
+	const bool start = !mRunning;
+	mRunning = true;
+	unlock();
+	
+	// if the thread can't be started, convolvers compute their tails in process().
+	if (start && (pthread_create(&mThread, 0, MLConvolverWorkerThread, this) != 0))
+	{
+		debug() << "MLConvolverWorker: couldn't start thread, computing tails in process().\n";
+		mRunning = false;
+	}
+}
+
+void MLConvolverWorker::removeConvolver(MLConvolver* pC)
+{
+	lock();
+	mConvolvers.erase(std::remove(mConvolvers.begin(), mConvolvers.end(), pC), mConvolvers.end());
+	const bool stop = mConvolvers.empty();
+	unlock();
+	if (stop)
+	{
+		stopThread();
+	}
+}
+
+void MLConvolverWorker::stopThread()
+{
+	if (mRunning)
+	{
+		mRunning = false;
+		pthread_join(mThread, 0);
+	}
+}
+
+// a pass that finds no work and starts after this is called means that every block 
+// written before the call is done.
+void MLConvolverWorker::waitUntilIdle()
+{
+	const int passes = mIdlePasses;
+	while (mRunning && (mIdlePasses < passes + 2))
+	{
+		usleep(kMLConvolverWorkerPollMicros);
+	}
+	__sync_synchronize();
+}
+
+void MLConvolverWorker::run()
+{
+	while (mRunning)
+	{
+		bool worked = false;
+		lock();
+		if (mEnabled)
+		{
+			for(std::vector<MLConvolver*>::iterator it = mConvolvers.begin(); it != mConvolvers.end(); ++it)
+			{
+				int block;
+				while ((block = (*it)->claimTailBlock()) >= 0)
+				{
+					(*it)->finishTailBlock(block);
+					worked = true;
+				}
+			}
+		}
+		if (!worked)
+		{
+			mIdlePasses = mIdlePasses + 1;
+		}
+		unlock();
+		if (!worked)
+		{
+			usleep(kMLConvolverWorkerPollMicros);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolver
+
+MLConvolver::MLConvolver() :
+	mpKernel(0),
+	mMaxTailPartitions(0),
+	mHeadPos(0),
+	mHeadFDLIndex(0),
+	mTailPos(0),
+	mTailBlock(0),
+	mTailBlocksWritten(0),
+	mTailBlocksClaimed(0),
+	mTailBlocksDone(0),
+	mTailReady(false),
+	mTailInputFree(true),
+	mUseThread(false)
+{
+}
+
+MLConvolver::~MLConvolver()
+{
+	if (mUseThread)
+	{
+		MLConvolverWorker::theWorker().removeConvolver(this);
+	}
+}
+
+bool MLConvolver::resize(int maxLength, bool useThread)
+{
+	if (mUseThread)
+	{
+		MLConvolverWorker::theWorker().removeConvolver(this);
+		mUseThread = false;
+	}
+
+	const int head = kMLConvolverHeadSize;
+	const int tail = kMLConvolverTailBlockSize;
+	mMaxTailPartitions = max((maxLength - kMLConvolverTailStart + tail - 1)/tail, 0);
+	const int tailRows = max(mMaxTailPartitions, 1);
+
+	mHeadFFT.resize(head*2);
+	mTailFFT.resize(tail*2);
+	bool ok = true;
+	ok &= (mHeadWindow.setDims(head*2) != 0);
+	ok &= (mHeadOut.setDims(head*2) != 0);
+	ok &= (mHeadFDLRe.setDims(head, kMLConvolverHeadPartitions) != 0);
+	ok &= (mHeadFDLIm.setDims(head, kMLConvolverHeadPartitions) != 0);
+	ok &= (mHeadAccRe.setDims(head) != 0);
+	ok &= (mHeadAccIm.setDims(head) != 0);
+	ok &= (mTailInput.setDims(tail, 4) != 0);
+	ok &= (mTailOutput.setDims(tail, 2) != 0);
+	ok &= (mTailWindow.setDims(tail*2) != 0);
+	ok &= (mTailFDLRe.setDims(tail, tailRows) != 0);
+	ok &= (mTailFDLIm.setDims(tail, tailRows) != 0);
+	ok &= (mTailAccRe.setDims(tail) != 0);
+	ok &= (mTailAccIm.setDims(tail) != 0);
+	clear();
+
+	if (ok && useThread && (mMaxTailPartitions > 0))
+	{
+		MLConvolverWorker::theWorker().addConvolver(this);
+		mUseThread = true;
+	}
+	return ok;
+}
+
+// not for the audio thread: locks the worker so that no tail block is being computed.
+void MLConvolver::clear()
+{
+	MLConvolverWorker& worker = MLConvolverWorker::theWorker();
+	if (mUseThread) worker.lock();
+	mHeadWindow.clear();
+	mHeadOut.clear();
+	mHeadFDLRe.clear();
+	mHeadFDLIm.clear();
+	mTailInput.clear();
+	mTailOutput.clear();
+	mTailFDLRe.clear();
+	mTailFDLIm.clear();
+	mHeadPos = 0;
+	mHeadFDLIndex = 0;
+	mTailPos = 0;
+	mTailBlock = 0;
+	mTailBlocksDone = 0;
+	mTailBlocksClaimed = 0;
+	mTailBlocksWritten = 0;
+	mTailReady = false;
+	mTailInputFree = true;
+	__sync_synchronize();
+	if (mUseThread) worker.unlock();
+}
+
+void MLConvolver::process(const MLSample* x, MLSample* y, const int frames)
+{
+	const int head = kMLConvolverHeadSize;
+	const int tail = kMLConvolverTailBlockSize;
+	const MLConvolverKernel* pKernel = mpKernel;
+	MLSample* pWindow = mHeadWindow.getBuffer();
+	const MLSample* pHeadOut = mHeadOut.getConstBuffer() + head;
+
+	int n = 0;
+	while(n < frames)
+	{
+		const int count = min(min(frames - n, head - mHeadPos), tail - mTailPos);
+
+		if ((mTailPos == 0) && (mMaxTailPartitions > 0))
+		{
+			startTailBlock();
+		}
+
+		// write input
+		std::copy(x + n, x + n + count, pWindow + head + mHeadPos);
+		if ((mMaxTailPartitions > 0) && mTailInputFree)
+		{
+			MLSample* pTailIn = mTailInput.getBuffer() + mTailInput.row(mTailBlock & 3);
+			std::copy(x + n, x + n + count, pTailIn + mTailPos);
+		}
+
+		// direct taps
+		if (pKernel)
+		{
+			const MLSample* pTaps = pKernel->getDirectTaps();
+			for(int i=0; i<count; ++i)
+			{
+				const MLSample* px = pWindow + mHeadPos + i + 1;
+				__m128 acc = _mm_setzero_ps();
+				for(int k=0; k<head; k += kSSEVecSize)
+				{
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(pTaps + k), _mm_loadu_ps(px + k)));
+				}
+				float r[4];
+				_mm_storeu_ps(r, acc);
+				y[n + i] = r[0] + r[1] + r[2] + r[3];
+			}
+		}
+		else
+		{
+			std::fill(y + n, y + n + count, 0.f);
+		}
+
+		// head and tail partitions
+		for(int i=0; i<count; ++i)
+		{
+			y[n + i] += pHeadOut[mHeadPos + i];
+		}
+		if ((mMaxTailPartitions > 0) && (mTailBlock >= 2) && mTailReady)
+		{
+			const MLSample* pTailOut = mTailOutput.getConstBuffer() + mTailOutput.row(mTailBlock & 1);
+			for(int i=0; i<count; ++i)
+			{
+				y[n + i] += pTailOut[mTailPos + i];
+			}
+		}
+
+		n += count;
+		mHeadPos += count;
+		mTailPos += count;
+		if (mHeadPos == head)
+		{
+			processHeadBlock(pKernel);
+			mHeadPos = 0;
+		}
+		if (mTailPos == tail)
+		{
+			if (mMaxTailPartitions > 0)
+			{
+				__sync_synchronize();
+				mTailBlocksWritten = mTailBlock + 1;
+			}
+			mTailBlock++;
+			mTailPos = 0;
+		}
+	}
+}
+
+// at the start of each tail block, compute any written blocks the worker has not
+// started, up to the one whose output is needed now. Never waits for the worker.
+void MLConvolver::startTailBlock()
+{
+	int block;
+	while ((mTailBlocksDone < mTailBlock - 1) && ((block = claimTailBlock()) >= 0))
+	{
+		finishTailBlock(block);
+	}
+	__sync_synchronize();
+	const int done = mTailBlocksDone;
+	const int claimed = mTailBlocksClaimed;
+
+	// the output of block mTailBlock - 2 is needed now.
+	mTailReady = (done >= mTailBlock - 1);
+
+	// a block being computed reads its own input row and the one before it. If the
+	// worker is so late that one of these is about to be written, leave this block
+	// of tail input out instead.
+	mTailInputFree = (claimed == done) || (mTailBlock - done < 3);
+}
+
+int MLConvolver::claimTailBlock()
+{
+	const int claimed = mTailBlocksClaimed;
+	if ((mTailBlocksDone != claimed) || (claimed >= mTailBlocksWritten)) return -1;
+	return __sync_bool_compare_and_swap(&mTailBlocksClaimed, claimed, claimed + 1) ? claimed : -1;
+}
+
+void MLConvolver::finishTailBlock(int block)
+{
+	processTailBlock(block);
+	__sync_synchronize();
+	mTailBlocksDone = block + 1;
+}
+
+void MLConvolver::processHeadBlock(const MLConvolverKernel* pKernel)
+{
+	const int head = kMLConvolverHeadSize;
+	const int fdlSize = kMLConvolverHeadPartitions;
+	MLSample* pWindow = mHeadWindow.getBuffer();
+	MLSample* pAccRe = mHeadAccRe.getBuffer();
+	MLSample* pAccIm = mHeadAccIm.getBuffer();
+
+	mHeadFFT.forward(pWindow, mHeadFDLRe.getBuffer() + mHeadFDLRe.row(mHeadFDLIndex),
+		mHeadFDLIm.getBuffer() + mHeadFDLIm.row(mHeadFDLIndex));
+
+	mHeadAccRe.clear();
+	mHeadAccIm.clear();
+	const int partitions = pKernel ? pKernel->getHeadPartitions() : 0;
+	if (partitions > 0)
+	{
+		const MLSignal& hRe = pKernel->getHeadRe();
+		const MLSignal& hIm = pKernel->getHeadIm();
+		for(int j=0; j<partitions; ++j)
+		{
+			const int slot = (mHeadFDLIndex - j + fdlSize) % fdlSize;
+			MLFFTMultiplyAdd(mHeadFDLRe.getConstBuffer() + mHeadFDLRe.row(slot), mHeadFDLIm.getConstBuffer() + mHeadFDLIm.row(slot),
+				hRe.getConstBuffer() + hRe.row(j), hIm.getConstBuffer() + hIm.row(j), pAccRe, pAccIm, head);
+		}
+	}
+	mHeadFFT.inverse(pAccRe, pAccIm, mHeadOut.getBuffer());
+
+	std::copy(pWindow + head, pWindow + head*2, pWindow);
+	mHeadFDLIndex = (mHeadFDLIndex + 1) % fdlSize;
+}
+
+// compute the output of the tail partitions for one block of input.
+// called by the worker, or by process() for blocks the worker has not started.
+void MLConvolver::processTailBlock(int block)
+{
+	const int tail = kMLConvolverTailBlockSize;
+	const int fdlSize = mMaxTailPartitions;
+	const MLConvolverKernel* pKernel = mpKernel;
+	MLSample* pWindow = mTailWindow.getBuffer();
+	MLSample* pAccRe = mTailAccRe.getBuffer();
+	MLSample* pAccIm = mTailAccIm.getBuffer();
+	const int fdlIndex = block % fdlSize;
+
+	const MLSample* pPrev = mTailInput.getConstBuffer() + mTailInput.row((block - 1) & 3);
+	const MLSample* pCurrent = mTailInput.getConstBuffer() + mTailInput.row(block & 3);
+	std::copy(pPrev, pPrev + tail, pWindow);
+	std::copy(pCurrent, pCurrent + tail, pWindow + tail);
+	mTailFFT.forward(pWindow, mTailFDLRe.getBuffer() + mTailFDLRe.row(fdlIndex),
+		mTailFDLIm.getBuffer() + mTailFDLIm.row(fdlIndex));
+
+	mTailAccRe.clear();
+	mTailAccIm.clear();
+	const int partitions = pKernel ? min(pKernel->getTailPartitions(), fdlSize) : 0;
+	if (partitions > 0)
+	{
+		const MLSignal& hRe = pKernel->getTailRe();
+		const MLSignal& hIm = pKernel->getTailIm();
+		for(int j=0; j<min(partitions, block + 1); ++j)
+		{
+			const int slot = (fdlIndex - j + fdlSize) % fdlSize;
+			MLFFTMultiplyAdd(mTailFDLRe.getConstBuffer() + mTailFDLRe.row(slot), mTailFDLIm.getConstBuffer() + mTailFDLIm.row(slot),
+				hRe.getConstBuffer() + hRe.row(j), hIm.getConstBuffer() + hIm.row(j), pAccRe, pAccIm, tail);
+		}
+	}
+	mTailFFT.inverse(pAccRe, pAccIm, pWindow);
+
+	MLSample* pOut = mTailOutput.getBuffer() + mTailOutput.row(block & 1);
+	std::copy(pWindow + tail, pWindow + tail*2, pOut);
+}
@@ -0,0 +1,234 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#ifndef _ML_CONVOLVER_H
+#define _ML_CONVOLVER_H
+
+#include <vector>
+#include <pthread.h>
+
+#include "MLDSP.h"
+#include "MLSignal.h"
+#include "MLFFT.h"
+
+// the impulse response is split into three segments:
+// taps [0, head size) are applied directly in the time domain, for zero latency.
+// taps [head size, 2*tail block size) are applied in partitions of head size samples.
+// taps from 2*tail block size on are applied in partitions of tail block size samples,
+// on a worker thread.
+const int kMLConvolverHeadSize = 64;
+const int kMLConvolverTailBlockSize = 1024;
+const int kMLConvolverTailStart = kMLConvolverTailBlockSize*2;
+const int kMLConvolverHeadPartitions = (kMLConvolverTailStart - kMLConvolverHeadSize)/kMLConvolverHeadSize;
+const int kMLMaxImpulses = 16;
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolverKernel
+
+// an impulse response prepared for MLConvolver: the direct taps and the spectra
+// of all the partitions. Kernels are built once, off the audio thread, and are
+// read-only after that, so one kernel can be shared by any number of convolvers.
+
+class MLConvolverKernel
+{
+public:
+	MLConvolverKernel();
+	~MLConvolverKernel();
+
+	// build from an impulse response. returns false on bad input.
+	bool build(const MLSignal& ir);
+
+	int getLength() const { return mLength; }
+	int getHeadPartitions() const { return mHeadPartitions; }
+	int getTailPartitions() const { return mTailPartitions; }
+
+	// the direct taps, time-reversed.
+	const MLSample* getDirectTaps() const { return mDirect.getConstBuffer(); }
+
+	const MLSignal& getHeadRe() const { return mHeadRe; }
+	const MLSignal& getHeadIm() const { return mHeadIm; }
+	const MLSignal& getTailRe() const { return mTailRe; }
+	const MLSignal& getTailIm() const { return mTailIm; }
+
+private:
+	MLConvolverKernel (const MLConvolverKernel&); // unimplemented
+	const MLConvolverKernel& operator= (const MLConvolverKernel&); // unimplemented
+
+	void makePartitions(const MLSignal& ir, int start, int size, int partitions, MLSignal& re, MLSignal& im);
+
+	int mLength;
+	int mHeadPartitions;
+	int mTailPartitions;
+	MLSignal mDirect;
+
+	// partition spectra, one partition per row.
+	MLSignal mHeadRe, mHeadIm;
+	MLSignal mTailRe, mTailIm;
+};
+
+typedef std::tr1::shared_ptr<MLConvolverKernel> MLConvolverKernelPtr;
+
+// ----------------------------------------------------------------
+#pragma mark MLImpulseBank
+
+// singleton store of prepared impulse responses, shared by all convolve procs
+// in all voices. Impulses are referred to by index.
+//
+// setImpulse() builds the kernel and is called from outside the audio thread.
+// Kernels that are replaced are kept alive until releaseUnusedImpulses() is
+// called while no procs are running. It waits for the convolver worker to finish
+// any tail blocks, which may still be reading a replaced kernel, before freeing.
+
+class MLImpulseBank
+{
+public:
+	static MLImpulseBank &theBank()  { static MLImpulseBank b; return b; }
+
+	bool setImpulse(int index, const MLSignal& ir);
+
+	// get the current kernel at index, or 0 if none. Safe to call from process().
+	inline const MLConvolverKernel* getKernel(int index) const
+	{
+		return within(index, 0, kMLMaxImpulses) ? mKernelPtrs[index] : 0;
+	}
+
+	void releaseUnusedImpulses();
+
+private:
+	MLImpulseBank();
+	MLImpulseBank(const MLImpulseBank &); // Not implemented
+	MLImpulseBank & operator=(const MLImpulseBank &); // Not implemented
+	~MLImpulseBank();
+
+	MLConvolverKernelPtr mKernels[kMLMaxImpulses];
+	const MLConvolverKernel* volatile mKernelPtrs[kMLMaxImpulses];
+	std::vector<MLConvolverKernelPtr> mRetiredKernels;
+};
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolverWorker
+
+class MLConvolver;
+
+// one thread that computes the tail blocks of all the convolvers that use it. 
+// Blocks are handed over only through counters in each convolver, so the audio 
+// thread never locks or waits. The worker polls for blocks, which is often enough 
+// because each block has a whole block of time before its output is needed.
+
+class MLConvolverWorker
+{
+public:
+	static MLConvolverWorker &theWorker()  { static MLConvolverWorker w; return w; }
+	
+	void addConvolver(MLConvolver* pC);
+	void removeConvolver(MLConvolver* pC);
+	
+	// with the worker off, convolvers compute their tails in process(), so the 
+	// output does not depend on timing. For offline rendering.
+	void setEnabled(bool e) { mEnabled = e; }
+	
+	// wait until the worker has no tail blocks to compute. Not for the audio thread.
+	void waitUntilIdle();
+	
+	// keep the worker out of all convolvers while one is changed. Not for the audio thread.
+	void lock() { pthread_mutex_lock(&mMutex); }
+	void unlock() { pthread_mutex_unlock(&mMutex); }
+	
+private:
+	MLConvolverWorker();
+	MLConvolverWorker(const MLConvolverWorker &); // Not implemented
+	MLConvolverWorker & operator=(const MLConvolverWorker &); // Not implemented
+	~MLConvolverWorker();
+	
+	void stopThread();
+	void run();
+	friend void* MLConvolverWorkerThread(void* arg);
+	
+	std::vector<MLConvolver*> mConvolvers;
+	pthread_t mThread;
+	pthread_mutex_t mMutex;
+	volatile bool mRunning;
+	volatile bool mEnabled;
+	volatile int mIdlePasses;
+};
+
+// ----------------------------------------------------------------
+#pragma mark MLConvolver
+
+// zero-latency partitioned convolution with one kernel. process() can be called
+// with any number of frames.
+//
+// the head partitions are computed in process(). Each block of tail input is handed
+// to the shared worker when it is complete, and its output is not needed until one
+// whole tail block later, so the worker has a block of time to compute it. If the
+// worker has not started a block by then, process() computes it. If the worker is 
+// still computing it, the tail is left out of that block rather than waiting.
+
+class MLConvolver
+{
+public:
+	MLConvolver();
+	~MLConvolver();
+
+	// allocate for impulses of up to maxLength samples, and compute tails on the shared worker
+	// if useThread is true. Kernels longer than maxLength are truncated.
+	// returns false if out of memory.
+	bool resize(int maxLength, bool useThread = true);
+	void clear();
+
+	// set the kernel to use. 0 makes the output silent.
+	void setKernel(const MLConvolverKernel* pKernel) { mpKernel = pKernel; }
+
+	void process(const MLSample* x, MLSample* y, const int frames);
+
+private:
+	MLConvolver (const MLConvolver&); // unimplemented
+	const MLConvolver& operator= (const MLConvolver&); // unimplemented
+
+	void processHeadBlock(const MLConvolverKernel* pKernel);
+	void processTailBlock(int block);
+	void startTailBlock();
+	
+	// claim the next written tail block if no block is being computed. returns
+	// the block, or -1. Called by process() and by the worker.
+	int claimTailBlock();
+	void finishTailBlock(int block);
+	friend class MLConvolverWorker;
+
+	const MLConvolverKernel* volatile mpKernel;
+	int mMaxTailPartitions;
+
+	// head: overlap-save window of two blocks, output for the current block,
+	// and a delay line of input spectra.
+	MLFFT mHeadFFT;
+	MLSignal mHeadWindow;
+	MLSignal mHeadOut;
+	MLSignal mHeadFDLRe, mHeadFDLIm;
+	MLSignal mHeadAccRe, mHeadAccIm;
+	int mHeadPos;
+	int mHeadFDLIndex;
+
+	// tail: input blocks are written to a ring of four, so the worker can read the
+	// two it needs while the next block is written. results are written to a ring of two.
+	MLFFT mTailFFT;
+	MLSignal mTailInput;
+	MLSignal mTailOutput;
+	MLSignal mTailWindow;
+	MLSignal mTailFDLRe, mTailFDLIm;
+	MLSignal mTailAccRe, mTailAccIm;
+	int mTailPos;
+	int mTailBlock;
+
+	// blocks of tail input written by process(), claimed for computing by process() 
+	// or the worker, and done. Only one block is claimed and not done at a time.
+	volatile int mTailBlocksWritten;
+	volatile int mTailBlocksClaimed;
+	volatile int mTailBlocksDone;
+	bool mTailReady;
+	bool mTailInputFree;
+
+	bool mUseThread;
+};
+
+#endif // _ML_CONVOLVER_H
@@ -15,6 +15,96 @@
 // Utility functions
 // ----------------------------------------------------------------
 
+// ----------------------------------------------------------------
+// vector math
+// ----------------------------------------------------------------
+
+template <__m128 (*F)(__m128)>
+static void applyVector(const MLSample* x, MLSample* y, const int frames)
+{
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	for(n = 0; n < vFrames; n += kSSEVecSize)
+	{
+		_mm_storeu_ps(y + n, F(_mm_loadu_ps(x + n)));
+	}
+	if(n < frames)
+	{
+		float temp[kSSEVecSize] = {1.f, 1.f, 1.f, 1.f};
+		for(int i = n; i < frames; ++i)
+		{
+			temp[i - n] = x[i];
+		}
+		_mm_storeu_ps(temp, F(_mm_loadu_ps(temp)));
+		for(int i = n; i < frames; ++i)
+		{
+			y[i] = temp[i - n];
+		}
+	}
+}
+
+template <__m128 (*F)(__m128, __m128)>
+static void applyVector2(const MLSample* x1, const MLSample* x2, MLSample* y, const int frames)
+{
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	for(n = 0; n < vFrames; n += kSSEVecSize)
+	{
+		_mm_storeu_ps(y + n, F(_mm_loadu_ps(x1 + n), _mm_loadu_ps(x2 + n)));
+	}
+	if(n < frames)
+	{
+		float t1[kSSEVecSize] = {1.f, 1.f, 1.f, 1.f};
+		float t2[kSSEVecSize] = {1.f, 1.f, 1.f, 1.f};
+		for(int i = n; i < frames; ++i)
+		{
+			t1[i - n] = x1[i];
+			t2[i - n] = x2[i];
+		}
+		_mm_storeu_ps(t1, F(_mm_loadu_ps(t1), _mm_loadu_ps(t2)));
+		for(int i = n; i < frames; ++i)
+		{
+			y[i] = t1[i - n];
+		}
+	}
+}
+
+void MLExp2(const MLSample* x, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector<exp2Approx4>(x, y, frames);
+	else applyVector<exp2Precise4>(x, y, frames);
+}
+
+void MLLog2(const MLSample* x, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector<log2Approx4>(x, y, frames);
+	else applyVector<log2Precise4>(x, y, frames);
+}
+
+void MLPow(const MLSample* x, const MLSample* e, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector2<powApprox4>(x, e, y, frames);
+	else applyVector2<powPrecise4>(x, e, y, frames);
+}
+
+void MLSin(const MLSample* x, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector<sinApprox4>(x, y, frames);
+	else applyVector<sinPrecise4>(x, y, frames);
+}
+
+void MLCos(const MLSample* x, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector<cosApprox4>(x, y, frames);
+	else applyVector<cosPrecise4>(x, y, frames);
+}
+
+void MLTanh(const MLSample* x, MLSample* y, const int frames, eMLMathPrecision p)
+{
+	if(p == kMLMathFast) applyVector<tanhApprox4>(x, y, frames);
+	else applyVector<tanhPrecise4>(x, y, frames);
+}
+
 MLSample* alignToCacheLine(const MLSample* p)
 {
 	uintptr_t pM = (uintptr_t)p;
@@ -102,8 +192,13 @@ static uint32_t gMLRandomSeed = 0;
 // return single-precision floating point number on [-1, 1]
 float MLRand()
 {
-	gMLRandomSeed = gMLRandomSeed * 0x0019660D + 0x3C6EF35F;
-	uint32_t temp = (gMLRandomSeed >> 9) & 0x007FFFFF;
+	return MLRand(gMLRandomSeed);
+}
+
+float MLRand(uint32_t& state)
+{
+	state = state * 0x0019660D + 0x3C6EF35F;
+	uint32_t temp = (state >> 9) & 0x007FFFFF;
 	temp &= 0x007FFFFF;// DSPConstants.r2;
 	temp |= 0x3F800000; // DSPConstants.r1;
 		
@@ -5,6 +5,9 @@
 
 #include "MLDSPEngine.h"
 
+#include <algorithm>
+#include <climits>
+
 const char * kMLInputToSignalProcName("the_midi_inputs");
 const char * kMLHostPhasorProcName("the_host_phasor");
 const char * kMLPatcherProcName("voices/voice/patcher");
@@ -18,10 +21,15 @@ MLDSPEngine::MLDSPEngine() :
 	mBufferSize(0),
 	mGraphStatus(unknownErr),
 	mCompileStatus(unknownErr),
+	mDirectIO(false),
+	mFrameGranularity(1),
 	mSamplesToProcess(0),
 	mStatsCount(0),
 	mSampleCount(0),
-	mCPUTimeCount(0.)
+	mCPUTimeCount(0.),
+	mNextParamChange(0),
+	mpNextEvent(0),
+	mpEventsEnd(0)
 {
 #if defined(DEBUG) || defined(BETA) || (DEMO)
 	//mCollectStats = true;
@@ -50,14 +58,24 @@ MLProc::err MLDSPEngine::buildGraphAndInputs(juce::XmlDocument* pDoc, bool makeS
 		
 	}
 	
+	juce::ScopedPointer<juce::XmlElement> pRootElem (pDoc->getDocumentElement());
+	
 	// TODO refactor
 	if (makeMidiInput)
  	{
+		// the document can set the number of voices, up to kMLEngineMaxVoices.
+		int voices = kMLEngineDefaultVoices;
+		if (pRootElem)
+		{
+			voices = clamp(pRootElem->getIntAttribute("voices", voices), 1, kMLEngineMaxVoices);
+		}
+		
 		// make XML node describing MIDI to signal processor.
 		juce::ScopedPointer<juce::XmlElement> pElem (new juce::XmlElement("proc"));
 		pElem->setAttribute("class", "midi_to_signals");
 		pElem->setAttribute("name", juce::String(kMLInputToSignalProcName));
-		pElem->setAttribute("voices", (int)kMLEngineMaxVoices);			
+		pElem->setAttribute("voices", voices);			
+		pElem->setAttribute("max_voices", voices);			
 		
 		// build processor object.
 		MLProc::err bpe = buildProc(pElem);
@@ -94,8 +112,6 @@ MLProc::err MLDSPEngine::buildGraphAndInputs(juce::XmlDocument* pDoc, bool makeS
 		}
 	}
 	
-	juce::ScopedPointer<juce::XmlElement> pRootElem (pDoc->getDocumentElement());
-
 	if (pRootElem)
 	{	
 		makeRoot("root");
@@ -157,6 +173,17 @@ void MLDSPEngine::compileEngine()
 	// order procs and make connections
 	// also makes connected signals
 	compile();
+	mFrameGranularity = getFrameGranularity();
+	
+	// make room for one pending change to each published param.
+	const int params = getPublishedParams();
+	mParamQueue.resize(params);
+	mParamChanges.reserve(params);
+	mParamChanges.clear();
+	mNextParamChange = 0;
+	mParamSmoothers.resize(params);
+	mActiveParamSmoothers.reserve(params);
+	mActiveParamSmoothers.clear();
 	
 	if (e != OK)
 	{
@@ -213,17 +240,28 @@ MLProc::err MLDSPEngine::prepareEngine(double sr, int bufSize, int chunkSize)
 				e = MLProc::memErr; 
 				goto bail;
 			}
-			
-			// add samples to ringbuffers so processing in chunks is always possible.
-			MLSignal delay(chunkSize);
-			delay.clear();		
-			mOutputBuffers[i]->write(delay.getBuffer(), chunkSize);
+		}
+		
+		// use direct I/O if any host block can be processed in place. Otherwise
+		// buffer from the start, so the latency reported after prepareEngine() 
+		// does not change while running.
+		if (!mSilence.setDims(chunkSize))
+		{
+			e = MLProc::memErr; 
+			goto bail;
+		}
+		mSilence.clear();
+		mDirectIO = true;
+		if (mFrameGranularity > 1)
+		{
+			startBufferedIO();
 		}
 		
 		mSamplesToProcess = 0; // doesn't count delay
 		setSampleRate((MLSampleRate)sr);
 		setBufferSize(bufSize);
 		setVectorSize(chunkSize);
+		setupParamSmoothers();
 
 		// after setVectorSize, set midiToSignals input buffer size.
 		if (mpInputToSignalsProc)
@@ -284,6 +322,72 @@ void MLDSPEngine::setIOBuffers(const ClientIOMap& pMap)
     mIOMap = pMap;
 }
 
+// point the input signals at frames of the client input buffers, starting at
+// offset. If a client buffer is not aligned for SSE, or this is a partial vector 
+// that procs may read past the end of, the frames are copied instead.
+// an offset of -1 points the input signals back to their own data.
+void MLDSPEngine::readClientInputs(const int offset, const int frames)
+{
+	for(int i=0; i<mInputChans; ++i)
+	{
+		MLSignal& in = *mInputSignals[i];
+		if (offset < 0)
+		{
+			in.setExternalData(0);
+		}
+		else
+		{
+			const MLSample* pSrc = mIOMap.inputs[i] + offset;
+			if ((frames == mVectorSize) && (((uintptr_t)pSrc & (sizeof(__m128) - 1)) == 0))
+			{
+				in.setExternalData(const_cast<MLSample*>(pSrc));
+			}
+			else
+			{
+				in.setExternalData(0);
+				std::copy(pSrc, pSrc + frames, in.getBuffer());
+			}
+		}
+	}
+}
+
+// copy frames of the root outputs to the client output buffers at offset.
+void MLDSPEngine::writeClientOutputs(const int offset, const int frames)
+{
+	int outs = getNumOutputs();
+	for(int i=0; i < outs; ++i)
+	{
+		const MLSignal& out = getOutput(i+1);
+		MLSample* pDest = mIOMap.outputs[i] + offset;
+		if (out.isConstant())
+		{
+			std::fill(pDest, pDest + frames, out[0]);
+		}
+		else
+		{
+			std::copy(out.getConstBuffer(), out.getConstBuffer() + frames, pDest);
+		}
+	}
+}
+
+// switch from direct to buffered I/O, adding one granularity of latency. The output
+// ringbuffers start with that much silence so processing in chunks is always possible.
+void MLDSPEngine::startBufferedIO()
+{
+	int outs = getNumOutputs();
+	for(int i=0; i < outs; ++i)
+	{
+		mOutputBuffers[i]->clear();
+		mOutputBuffers[i]->write(mSilence.getBuffer(), mFrameGranularity);
+	}
+	for(int i=0; i<mInputChans; ++i)
+	{
+		mInputBuffers[i]->clear();
+	}
+	mSamplesToProcess = 0;
+	mDirectIO = false;
+}
+
 // read from client input buffers to input ringbuffers.
 void MLDSPEngine::writeInputBuffers(const int samples)
 {
@@ -565,6 +669,129 @@ MLProcList& MLDSPEngine::getPatcherList()
 	return mPatcherList;
 }
 
+// ----------------------------------------------------------------
+#pragma mark parameters
+
+void MLDSPEngine::queueParamChange(int index, MLParamValue val, int offset)
+{
+	MLPublishedParamPtr p = getParamPtr(index);
+	if (!p) return;
+	val = p->setValue(val);
+	
+	// before the engine is compiled there is no queue and nothing is running, 
+	// so the change can be made directly.
+	if (!mParamQueue.push(index, val, max(offset, 0)))
+	{
+		sendPublishedParam(index, val);
+	}
+}
+
+void MLDSPEngine::setPublishedParam(int index, MLParamValue val)
+{
+	MLProcContainer::setPublishedParam(index, val);
+	if (within(index, 0, (int)mParamSmoothers.size()))
+	{
+		mParamSmoothers[index].reset(getParamPtr(index)->getValue());
+	}
+}
+
+void MLDSPEngine::setupParamSmoothers()
+{
+	const int params = (int)mParamSmoothers.size();
+	for(int i=0; i<params; ++i)
+	{
+		MLPublishedParamPtr p = getParamPtr(i);
+		if (p)
+		{
+			mParamSmoothers[i].setPolicy(p->getSmoothing(), p->getSmoothTime(), getSampleRate());
+			mParamSmoothers[i].reset(p->getValue());
+		}
+	}
+	mActiveParamSmoothers.clear();
+}
+
+namespace
+{
+	bool paramChangeIsEarlier(const MLParamChange& a, const MLParamChange& b)
+	{
+		return a.offset < b.offset;
+	}
+}
+
+void MLDSPEngine::readParamChanges()
+{
+	// stop at the reserved size, so there is no allocation here. Any changes 
+	// left in the queue are read next block.
+	mParamChanges.clear();
+	const int capacity = (int)mParamChanges.capacity();
+	MLParamChange change;
+	while(((int)mParamChanges.size() < capacity) && mParamQueue.pop(change))
+	{
+		mParamChanges.push_back(change);
+	}
+	
+	// sort by offset in place. The list is short and mostly in order already.
+	const int changes = (int)mParamChanges.size();
+	for(int i=1; i<changes; ++i)
+	{
+		const MLParamChange c = mParamChanges[i];
+		int j = i;
+		while((j > 0) && paramChangeIsEarlier(c, mParamChanges[j - 1]))
+		{
+			mParamChanges[j] = mParamChanges[j - 1];
+			j--;
+		}
+		mParamChanges[j] = c;
+	}
+	mNextParamChange = 0;
+}
+
+// set the smoother targets for the changes before endOffset. Their offsets in the 
+// next vector are measured from startOffset.
+void MLDSPEngine::setParamTargets(const int startOffset, const int endOffset)
+{
+	const int changes = (int)mParamChanges.size();
+	const int smoothers = (int)mParamSmoothers.size();
+	while((mNextParamChange < changes) && (mParamChanges[mNextParamChange].offset < endOffset))
+	{
+		const MLParamChange& c = mParamChanges[mNextParamChange++];
+		if (c.index < smoothers)
+		{
+			MLParamSmoother& s = mParamSmoothers[c.index];
+			if (!s.isSmoothing())
+			{
+				// send the value as a plain param change, which procs such as 
+				// param_to_sig glide to in their own way.
+				s.reset(c.value);
+				sendPublishedParam(c.index, c.value);
+				continue;
+			}
+			if (!s.isActive())
+			{
+				mActiveParamSmoothers.push_back(c.index);
+			}
+			s.setTarget(c.value, max(c.offset - startOffset, 0));
+		}
+	}
+}
+
+void MLDSPEngine::sendParamRamps(const int frames)
+{
+	int active = 0;
+	const int n = (int)mActiveParamSmoothers.size();
+	for(int i=0; i<n; ++i)
+	{
+		const int index = mActiveParamSmoothers[i];
+		MLParamSmoother& s = mParamSmoothers[index];
+		sendPublishedParamRamp(index, s.nextRamp(frames));
+		if (s.isActive())
+		{
+			mActiveParamSmoothers[active++] = index;
+		}
+	}
+	mActiveParamSmoothers.resize(active);
+}
+
 // ----------------------------------------------------------------
 #pragma mark Process
 
@@ -573,16 +800,27 @@ void MLDSPEngine::setCollectStats(bool k)
 	mCollectStats = k;
 }
 
+void MLDSPEngine::setVoiceThreads(int threads)
+{
+	if (!mVoiceThreads.start(threads))
+	{
+		MLError() << "MLDSPEngine: couldn't start voice threads!\n";
+	}
+	setCopyThreads((mVoiceThreads.getThreads() > 1) ? &mVoiceThreads : 0);
+}
+
 // run one buffer of the compiled graph, processing signals from the global inputs (if any)
 // to the global outputs.  Processes sub-procs in chunks of our preferred vector size.
 //
+// if the frame granularity is one frame, as it is without resampling, vectors are read 
+// from and written to the client buffers directly, and the last vector may be partial. 
+// Otherwise I/O goes through the ring buffers, which add one granularity of latency.
+//
 void MLDSPEngine::processBlock(const int frames, const MLControlEventVector& events, const int64_t , const double secs, const double ppqPos, const double bpm, bool isPlaying)
 {
 	int sr = getSampleRate();
 	int processed = 0;
 	bool reportStats = false;
-	osc::int64 startTime = 0, endTime = 0;
-    MLControlEventVector::const_iterator firstEvent, lastEvent;
 		
 	//debug() << "new samples: " << frames << "\n";
 	
@@ -603,75 +841,123 @@ void MLDSPEngine::processBlock(const int frames, const MLControlEventVector& eve
 		}
 	}
 
-	writeInputBuffers(frames);
-	mSamplesToProcess += frames;
-
-	while(mSamplesToProcess >= mVectorSize)
+	readParamChanges();
+	startEvents(events);
+	
+	if (mDirectIO)
 	{
-		readInputBuffers(mVectorSize);
-
-		if (mpInputToSignalsProc)
+		for(processed = 0; processed < frames; processed += mVectorSize)
 		{
-            // advance iterators into sorted event vector to capture range of events
-            firstEvent = events.begin();
-            
-            for(firstEvent = events.begin(); (!(*firstEvent).isFree()) && ((*firstEvent).mTime < processed); firstEvent++){}
-            for(lastEvent = firstEvent; (!(*lastEvent).isFree()) && ((*lastEvent).mTime < processed + mVectorSize); lastEvent++){}
-
-			mpInputToSignalsProc->setEventTimeOffset(processed);
-			mpInputToSignalsProc->setEventRange(firstEvent, lastEvent);
+			const int chunk = min(frames - processed, mVectorSize);
+			readClientInputs(processed, chunk);
+			processVector(processed, chunk, (processed + chunk >= frames), reportStats);
+			writeClientOutputs(processed, chunk);
 		}
-        
-		if (reportStats)
+		readClientInputs(-1, 0);
+	}
+	else
+	{
+		writeInputBuffers(frames);
+		mSamplesToProcess += frames;
+
+		// process whole vectors, then any whole granularities left over.
+		while(mSamplesToProcess >= mFrameGranularity)
 		{
-			MLSignalStats stats;
-			collectStats(&stats);
-            
-			process(mVectorSize);  // MLProcContainer::process()
+			const int chunk = min(mSamplesToProcess - (mSamplesToProcess % mFrameGranularity), mVectorSize);
+			readInputBuffers(chunk);
+			processVector(processed, chunk, (mSamplesToProcess - chunk < mFrameGranularity), reportStats);
+			writeOutputBuffers(chunk);
+			processed += chunk;
+			mSamplesToProcess -= chunk;
+		}	
+		readOutputBuffers(frames);
+	}
+	
+	// changes past the last vector start at the beginning of the next one.
+	setParamTargets(INT_MAX, INT_MAX);
+}
+
+void MLDSPEngine::startEvents(const MLControlEventVector& events)
+{
+	mpNextEvent = mpEventsEnd = events.empty() ? 0 : &events[0];
+	const int size = (int)events.size();
+	for(int i=0; (i < size) && !events[i].isFree(); ++i)
+	{
+		mpEventsEnd++;
+	}
+}
+
+// take the events before endTime from the cursor.
+MLControlEventSpan MLDSPEngine::takeEvents(const int endTime)
+{
+	const MLControlEvent* pStart = mpNextEvent;
+	while((mpNextEvent != mpEventsEnd) && (mpNextEvent->mTime < endTime))
+	{
+		mpNextEvent++;
+	}
+	return MLControlEventSpan(pStart, mpNextEvent);
+}
+
+// process one vector of up to mVectorSize frames starting at the given offset into the 
+// current block. The last vector in the block takes all remaining events, so none are lost.
+void MLDSPEngine::processVector(const int offset, const int frames, const bool lastInBlock, bool& reportStats)
+{
+	osc::int64 startTime = 0, endTime = 0;
+	
+	setParamTargets(offset, offset + frames);
+	sendParamRamps(frames);
+
+	const MLControlEventSpan vectorEvents = takeEvents(lastInBlock ? INT_MAX : offset + frames);
+	if (mpInputToSignalsProc)
+	{
+		mpInputToSignalsProc->setEventTimeOffset(offset);
+		mpInputToSignalsProc->setEvents(vectorEvents);
+	}
 	
-			debug() << "\n";
-			debug() << "processed " << mSampleCount << " samples in " << mCPUTimeCount << " seconds,"
-				<< "vector size " << mVectorSize << ".\n";
-			double uSecsPerSample = mCPUTimeCount / (double)mSampleCount * 1000000.;
-			double maxuSecsPerSample = getInvSampleRate() * 1000000.;
-			double CPUFrac = uSecsPerSample / maxuSecsPerSample;
-			double percent = CPUFrac * 100.;
-			debug() << (int)(mCPUTimeCount / (double)mVectorSize * 1000000.) << " microseconds per sample (";
-			debug() << std::fixed;
-			debug() << std::setprecision(1);
-			debug() << percent << "\%)\n";
-			
-			// clear time and sample counters
-			mCPUTimeCount = 0.;
-			mSampleCount = 0;
-			
-			collectStats(0); // turn off stats collection
-			debug() << "\n";
-			stats.dump();
-			reportStats = false;
+	if (reportStats)
+	{
+		MLSignalStats stats;
+		collectStats(&stats);
+		
+		process(frames);  // MLProcContainer::process()
+
+		debug() << "\n";
+		debug() << "processed " << mSampleCount << " samples in " << mCPUTimeCount << " seconds,"
+			<< "vector size " << mVectorSize << ".\n";
+		double uSecsPerSample = mCPUTimeCount / (double)mSampleCount * 1000000.;
+		double maxuSecsPerSample = getInvSampleRate() * 1000000.;
+		double CPUFrac = uSecsPerSample / maxuSecsPerSample;
+		double percent = CPUFrac * 100.;
+		debug() << (int)(mCPUTimeCount / (double)mVectorSize * 1000000.) << " microseconds per sample (";
+		debug() << std::fixed;
+		debug() << std::setprecision(1);
+		debug() << percent << "\%)\n";
+		
+		// clear time and sample counters
+		mCPUTimeCount = 0.;
+		mSampleCount = 0;
+		
+		collectStats(0); // turn off stats collection
+		debug() << "\n";
+		stats.dump();
+		reportStats = false;
+	}
+	else
+	{
+		if (mCollectStats)
+		{
+			startTime = juce::Time::getHighResolutionTicks();
 		}
-		else
+		
+		process(frames);  // MLProcContainer::process()
+		
+		if (mCollectStats) 
 		{
-			if (mCollectStats)
-            {
-                startTime = juce::Time::getHighResolutionTicks();
-            }
-			
-			process(mVectorSize);  // MLProcContainer::process()
-			
-			if (mCollectStats) 
-			{
-				endTime = juce::Time::getHighResolutionTicks();
-				mCPUTimeCount += juce::Time::highResolutionTicksToSeconds (endTime - startTime);
-				mSampleCount += mVectorSize;
-			}
-		}		
-         
-        writeOutputBuffers(mVectorSize);
-		processed += mVectorSize;
-		mSamplesToProcess -= mVectorSize;
-	}	
-	readOutputBuffers(frames);
+			endTime = juce::Time::getHighResolutionTicks();
+			mCPUTimeCount += juce::Time::highResolutionTicksToSeconds (endTime - startTime);
+			mSampleCount += frames;
+		}
+	}		
 }
 
 
@@ -7,6 +7,7 @@
 #define ML_DSP_ENGINE_H
 
 #include "MLProcContainer.h"
+#include "MLMultProxy.h"
 #include "MLProcInputToSignals.h"
 #include "MLInputProtocols.h"
 #include "MLProcHostPhasor.h"
@@ -63,6 +64,10 @@ public:
 	// set external buffers for top level I/O with client
 	void setIOBuffers(const ClientIOMap& pMap);
 	
+	// latency added by the engine: 0 if the frame granularity is one frame, otherwise 
+	// one granularity. Without resampling this is always 0. Set by prepareEngine().
+	int getLatencySamples() { return mDirectIO ? 0 : mFrameGranularity; }
+	
 	// ----------------------------------------------------------------
 	// Housekeeping
 			
@@ -99,6 +104,17 @@ public:
 	
 	MLScale* getScale();
 	
+	// ----------------------------------------------------------------
+	// parameters
+	
+	// set the value of a published param right away and queue the change to 
+	// its procs, which is made by processBlock() at the given sample offset into 
+	// the next block, to the nearest vector. Can be called from any thread.
+	void queueParamChange(int index, MLParamValue val, int offset = 0);
+	
+	// set a published param immediately, without smoothing. Not for the audio thread.
+	void setPublishedParam(int index, MLParamValue val);
+	
 	// ----------------------------------------------------------------
 	// Patcher
 
@@ -111,6 +127,10 @@ public:
 
 	void setCollectStats(bool k);
 
+	// process the copies of the multiple containers on the given number of threads,
+	// from one pool shared by all of them. Not for use while processing.
+	void setVoiceThreads(int threads);
+
 	// run the compiled graph, processing signals from the global inputs (if any)
 	// to the global outputs. 
 	void processBlock(const int samples, const MLControlEventVector& events, const int64_t samplesPos, const double secs, const double position, const double bpm, bool isPlaying);
@@ -151,12 +171,49 @@ private:
 	err mGraphStatus;
 	err mCompileStatus;
 	
-	// keep track of buffered samples to process, not including one-vector delay.
+	// true if vectors are processed in place from the client buffers. Set by 
+	// prepareEngine() if the frame granularity is one frame.
+	bool mDirectIO;
+	int mFrameGranularity;
+	MLSignal mSilence;
+	
+	// keep track of buffered samples to process, not including the buffered I/O delay.
 	int mSamplesToProcess;
 	int mStatsCount;
 	int mSampleCount;
 	double mCPUTimeCount;
 		
+	// queued param changes. Each block they are read from the queue into 
+	// mParamChanges and sorted by offset. Before each vector, the changes in it 
+	// set the targets of the param smoothers, then each active smoother sends 
+	// one ramp to its param's procs.
+	MLParamChangeQueue mParamQueue;
+	std::vector<MLParamChange> mParamChanges;
+	int mNextParamChange;
+	std::vector<MLParamSmoother> mParamSmoothers;
+	std::vector<int> mActiveParamSmoothers;
+	
+	void setupParamSmoothers();
+	void readParamChanges();
+	void setParamTargets(const int startOffset, const int endOffset);
+	void sendParamRamps(const int frames);
+
+	// cursor into the current block's events, which are sorted by time and end at 
+	// the first free event or the end of the vector. Each vector takes the events before 
+	// its end, so the block's events are visited once no matter how many vectors there are.
+	const MLControlEvent* mpNextEvent;
+	const MLControlEvent* mpEventsEnd;
+	
+	// voice threads shared by all the multiple containers.
+	MLCopyThreads mVoiceThreads;
+	
+	void startEvents(const MLControlEventVector& events);
+	MLControlEventSpan takeEvents(const int endTime);
+
+	void processVector(const int offset, const int frames, const bool lastInBlock, bool& reportStats);
+	void readClientInputs(const int offset, const int frames);
+	void writeClientOutputs(const int offset, const int frames);
+	void startBufferedIO();
 	void writeInputBuffers(const int samples);
     void clearOutputBuffers();
 	void readInputBuffers(const int samples);
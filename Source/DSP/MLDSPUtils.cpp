@@ -217,6 +217,127 @@ const float MLSineOsc::kFlipOffset = kRootX*2.f;
 const float MLTriOsc::kIntDomain = powf(2.f, 32.f);
 const float MLTriOsc::kDomainScale = 4.f/kIntDomain;
 
+// ----------------------------------------------------------------
+#pragma mark MLNoiseGen
+
+// use splitmix64 to spread the seed over the generator state.
+void MLNoiseGen::seed(uint32_t s)
+{
+	uint64_t x = s;
+	for(int i=0; i<4; ++i)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		uint64_t z = x;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		mState[i] = z ^ (z >> 31);
+	}
+	mPink0 = mPink1 = mPink2 = 0.f;
+	mBrown = 0.f;
+}
+
+// one xorshift128+ step in each of the two 64-bit lanes.
+inline __m128i MLNoiseGen::nextBits(__m128i& s0, __m128i& s1)
+{
+	__m128i x = s0;
+	const __m128i y = s1;
+	s0 = y;
+	x = _mm_xor_si128(x, _mm_slli_epi64(x, 23));
+	x = _mm_xor_si128(x, _mm_srli_epi64(x, 17));
+	x = _mm_xor_si128(x, y);
+	x = _mm_xor_si128(x, _mm_srli_epi64(y, 26));
+	s1 = x;
+	return _mm_add_epi64(x, y);
+}
+
+// write uniform noise on [-1, 1), or if drawsPerSample is 4, the sum of four
+// uniform values scaled to unit variance.
+void MLNoiseGen::processUniform(MLSample* y, const int frames, const int drawsPerSample)
+{
+	__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState));
+	__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mState + 2));
+	
+	// make floats on [1, 2) from the high 23 bits of each 32-bit word, then map to [-1, 1).
+	const __m128i mantMask = _mm_set1_epi32(0x007FFFFF);
+	const __m128i one = _mm_set1_epi32(0x3F800000);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 three = _mm_set1_ps(3.f);
+	const __m128 gaussScale = _mm_set1_ps(sqrtf(0.75f));
+	
+	for(int t = 0; t < frames; t += kSSEVecSize)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for(int d = 0; d < drawsPerSample; ++d)
+		{
+			__m128i bits = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(nextBits(s0, s1), 9), mantMask), one);
+			sum = _mm_add_ps(sum, _mm_sub_ps(_mm_mul_ps(_mm_castsi128_ps(bits), two), three));
+		}
+		if(drawsPerSample > 1)
+		{
+			// the variance of a uniform value on [-1, 1] is 1/3.
+			sum = _mm_mul_ps(sum, gaussScale);
+		}
+		if(t + (int)kSSEVecSize <= frames)
+		{
+			_mm_storeu_ps(y + t, sum);
+		}
+		else
+		{
+			float temp[kSSEVecSize];
+			_mm_storeu_ps(temp, sum);
+			for(int i = t; i < frames; ++i)
+			{
+				y[i] = temp[i - t];
+			}
+		}
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mState), s0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mState + 2), s1);
+}
+
+void MLNoiseGen::process(MLSample* y, const int frames, eMLNoiseType type)
+{
+	switch(type)
+	{
+		case kMLNoiseUniform:
+		default:
+			processUniform(y, frames, 1);
+			break;
+		case kMLNoiseGaussian:
+			processUniform(y, frames, 4);
+			break;
+		case kMLNoisePink:
+		{
+			// Paul Kellet's economy pink filter, -3dB per octave within 0.5dB above 40Hz at 44.1kHz.
+			processUniform(y, frames, 1);
+			float b0 = mPink0, b1 = mPink1, b2 = mPink2;
+			for(int t = 0; t < frames; ++t)
+			{
+				const float w = y[t];
+				b0 = 0.99765f*b0 + w*0.0990460f;
+				b1 = 0.96300f*b1 + w*0.2965164f;
+				b2 = 0.57000f*b2 + w*1.0526913f;
+				y[t] = (b0 + b1 + b2 + w*0.1848f)*0.335f;
+			}
+			mPink0 = b0; mPink1 = b1; mPink2 = b2;
+			break;
+		}
+		case kMLNoiseBrown:
+		{
+			// leaky integrator, -6dB per octave above about 8Hz at 44.1kHz.
+			processUniform(y, frames, 1);
+			float b = mBrown;
+			for(int t = 0; t < frames; ++t)
+			{
+				b = 0.9989f*b + y[t]*0.0625f;
+				y[t] = b*0.75f;
+			}
+			mBrown = b;
+			break;
+		}
+	}
+}
+
 // ----------------------------------------------------------------
 #pragma mark MLLinearDelay
 
@@ -233,6 +354,405 @@ void MLSampleDelay::setDelay(float d)
     mDelayInSamples = (int)(d*(float)mSR);
 }
 
+// ----------------------------------------------------------------
+#pragma mark MLDelayBuffer
+
+// number of taps read by each FIR interpolation mode. Taps start (taps/2 - 1)
+// samples before the read position.
+static inline int getInterpolationTaps(int mode)
+{
+	switch(mode)
+	{
+		case kMLDelayInterpLinear:
+			return 2;
+		case kMLDelayInterpHermite:
+			return 4;
+		case kMLDelayInterpSinc:
+			return MLDelayBuffer::kSincTaps;
+		default:
+			return 1;
+	}
+}
+
+// y[n] = sum over k of w[k]*x[n + k], four outputs at a time.
+static void firRun(const MLSample* px, const float* w, const int taps, MLSample* py, const int frames)
+{
+	int n = 0;
+	for(; n + 3 < frames; n += kSSEVecSize)
+	{
+		__m128 acc = _mm_setzero_ps();
+		for(int k=0; k<taps; ++k)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(px + n + k)));
+		}
+		_mm_storeu_ps(py + n, acc);
+	}
+	for(; n < frames; ++n)
+	{
+		float acc = 0.f;
+		for(int k=0; k<taps; ++k)
+		{
+			acc += w[k]*px[n + k];
+		}
+		py[n] = acc;
+	}
+}
+
+// dot product of the sixteen sinc taps at px with one row of the sinc table.
+static inline MLSample sincDot(const MLSample* px, const float* w)
+{
+	__m128 acc = _mm_mul_ps(_mm_loadu_ps(px), _mm_loadu_ps(w));
+	acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(px + 4), _mm_loadu_ps(w + 4)));
+	acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(px + 8), _mm_loadu_ps(w + 8)));
+	acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(px + 12), _mm_loadu_ps(w + 12)));
+	float r[4];
+	_mm_storeu_ps(r, acc);
+	return r[0] + r[1] + r[2] + r[3];
+}
+
+static void getInterpolationWeights(int mode, float m, float* w)
+{
+	switch(mode)
+	{
+		case kMLDelayInterpLinear:
+			w[0] = 1.f - m;
+			w[1] = m;
+			break;
+		case kMLDelayInterpHermite:
+		{
+			float m2 = m*m;
+			float m3 = m2*m;
+			w[0] = -0.5f*m + m2 - 0.5f*m3;
+			w[1] = 1.f - 2.5f*m2 + 1.5f*m3;
+			w[2] = 0.5f*m + 2.f*m2 - 1.5f*m3;
+			w[3] = -0.5f*m2 + 0.5f*m3;
+			break;
+		}
+		default:
+			w[0] = 1.f;
+			break;
+	}
+}
+
+// table of Blackman-windowed sinc interpolators, one row of kSincTaps weights for each
+// fractional position. The extra row at the end makes lookups at m = 1 safe.
+const float* MLDelayBuffer::getSincTable()
+{
+	static std::vector<float> table;
+	if (table.empty())
+	{
+		const int half = kSincTaps/2;
+		table.resize((kSincPhases + 1)*kSincTaps);
+		for(int p=0; p<=kSincPhases; ++p)
+		{
+			float m = (float)p / (float)kSincPhases;
+			float* w = &table[p*kSincTaps];
+			float sum = 0.f;
+			for(int k=0; k<kSincTaps; ++k)
+			{
+				float x = (float)(k - (half - 1)) - m;
+				float s = (fabsf(x) < 1e-6f) ? 1.f : sinf(kMLPi*x) / (kMLPi*x);
+				float win = 0.42f + 0.5f*cosf(kMLPi*x/half) + 0.08f*cosf(kMLTwoPi*x/half);
+				w[k] = s*win;
+				sum += w[k];
+			}
+			for(int k=0; k<kSincTaps; ++k)
+			{
+				w[k] /= sum;
+			}
+		}
+	}
+	return &table[0];
+}
+
+bool MLDelayBuffer::resize(int samples)
+{
+	mLength = 1 << bitsToContain(max(samples, (int)kGuardSize));
+	mLengthMask = mLength - 1;
+	MLSample* pBuf = mBuffer.setDims(mLength + kGuardSize);
+	clear();
+	return (pBuf != 0);
+}
+
+void MLDelayBuffer::clear()
+{
+	mBuffer.clear();
+	mWriteIndex = 0;
+}
+
+void MLDelayBuffer::write(const MLSignal& x, const int frames)
+{
+	MLSample* pBuf = mBuffer.getBuffer();
+	const MLSample* px = x.getConstBuffer();
+	const bool constant = x.isConstant();
+	int n = 0;
+	while(n < frames)
+	{
+		const int count = min(frames - n, (int)(mLength - mWriteIndex));
+		MLSample* pDest = pBuf + mWriteIndex;
+		if(constant)
+		{
+			std::fill(pDest, pDest + count, px[0]);
+		}
+		else
+		{
+			std::copy(px + n, px + n + count, pDest);
+		}
+
+		// mirror the start of the buffer into the guard region.
+		if(mWriteIndex < (uintptr_t)kGuardSize)
+		{
+			const int end = min((int)mWriteIndex + count, (int)kGuardSize);
+			std::copy(pBuf + mWriteIndex, pBuf + end, pBuf + mLength + mWriteIndex);
+		}
+		mWriteIndex = (mWriteIndex + count) & mLengthMask;
+		n += count;
+	}
+}
+
+float MLDelayBuffer::getMinimumDelay(int mode)
+{
+	switch(mode)
+	{
+		case kMLDelayInterpLinear:
+			return 1.f;
+		case kMLDelayInterpAllpass:
+			return 0.5f;
+		case kMLDelayInterpHermite:
+			return 2.f;
+		case kMLDelayInterpSinc:
+			return (float)(kSincTaps/2);
+		default:
+			return 0.f;
+	}
+}
+
+void MLDelayBuffer::readConstant(MLSample* y, const int frames, const uintptr_t pos, const float delay,
+	const int mode, AllpassState& state) const
+{
+	const MLSample* pBuf = mBuffer.getConstBuffer();
+	if(mode == kMLDelayInterpAllpass)
+	{
+		// keep fractional part in [0.5, 1.5) to avoid the pole near -1.
+		int delayInt = (int)delay;
+		float d = delay - delayInt;
+		if (d < 0.5f)
+		{
+			d += 1.f;
+			delayInt -= 1;
+		}
+		const float alpha = (1.f - d) / (1.f + d);
+		uintptr_t readIndex = (pos - delayInt) & mLengthMask;
+		for(int n=0; n<frames; ++n)
+		{
+			const MLSample x = pBuf[readIndex];
+			const MLSample out = alpha*x + state.x1 - alpha*state.y1;
+			state.x1 = x;
+			state.y1 = out;
+			y[n] = out;
+			readIndex = (readIndex + 1) & mLengthMask;
+		}
+		return;
+	}
+
+	// for zero order reads, truncate the delay as the delay procs always have.
+	// otherwise read at (base + m) where m is in [0, 1).
+	int taps = getInterpolationTaps(mode);
+	int delayInt;
+	float m;
+	float weights[kSincTaps];
+	const float* w = weights;
+	if(mode == kMLDelayInterpNone)
+	{
+		delayInt = (int)delay;
+		m = 0.f;
+	}
+	else
+	{
+		delayInt = (int)ceilf(delay);
+		m = delayInt - delay;
+	}
+	if(mode == kMLDelayInterpSinc)
+	{
+		w = getSincTable() + (int)(m*kSincPhases + 0.5f)*kSincTaps;
+	}
+	else
+	{
+		getInterpolationWeights(mode, m, weights);
+	}
+
+	// read in at most two runs, split where the taps wrap around the end of the buffer.
+	const int tapOffset = (taps > 1) ? taps/2 - 1 : 0;
+	uintptr_t start = (pos - delayInt - tapOffset) & mLengthMask;
+	int n = 0;
+	while(n < frames)
+	{
+		const int count = min(frames - n, (int)(mLength - start));
+		if(taps == 1)
+		{
+			std::copy(pBuf + start, pBuf + start + count, y + n);
+		}
+		else
+		{
+			firRun(pBuf + start, w, taps, y + n, count);
+		}
+		start = (start + count) & mLengthMask;
+		n += count;
+	}
+}
+
+void MLDelayBuffer::gatherConstant(MLSample* const* ys, const float* gains, MLSample* sum, const int taps, 
+	const int frames, const uintptr_t pos, const float* delays, const int mode) const
+{
+	const MLSample* pBuf = mBuffer.getConstBuffer();
+	const int firTaps = getInterpolationTaps(mode);
+	const int tapOffset = (firTaps > 1) ? firTaps/2 - 1 : 0;
+	const int t = min(taps, (int)kMaxGatherTaps);
+
+	// weights and start index of each tap, as in readConstant().
+	float weights[kMaxGatherTaps][kSincTaps];
+	const float* w[kMaxGatherTaps];
+	uintptr_t start[kMaxGatherTaps];
+	for(int k=0; k<t; ++k)
+	{
+		int delayInt;
+		float m;
+		if(mode == kMLDelayInterpNone)
+		{
+			delayInt = (int)delays[k];
+			m = 0.f;
+		}
+		else
+		{
+			delayInt = (int)ceilf(delays[k]);
+			m = delayInt - delays[k];
+		}
+		if(mode == kMLDelayInterpSinc)
+		{
+			w[k] = getSincTable() + (int)(m*kSincPhases + 0.5f)*kSincTaps;
+		}
+		else
+		{
+			getInterpolationWeights(mode, m, weights[k]);
+			w[k] = weights[k];
+		}
+		start[k] = (pos - delayInt - tapOffset) & mLengthMask;
+	}
+
+	// read in runs where no tap wraps around the end of the buffer. 
+	int n = 0;
+	while(n < frames)
+	{
+		int count = frames - n;
+		for(int k=0; k<t; ++k)
+		{
+			count = min(count, (int)(mLength - start[k]));
+		}
+		const int end = n + count;
+		int i = n;
+		for(; i + 3 < end; i += kSSEVecSize)
+		{
+			__m128 vSum = _mm_setzero_ps();
+			for(int k=0; k<t; ++k)
+			{
+				const MLSample* px = pBuf + start[k] + (i - n);
+				__m128 acc = _mm_setzero_ps();
+				for(int j=0; j<firTaps; ++j)
+				{
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k][j]), _mm_loadu_ps(px + j)));
+				}
+				_mm_storeu_ps(ys[k] + i, acc);
+				vSum = _mm_add_ps(vSum, _mm_mul_ps(_mm_set1_ps(gains[k]), acc));
+			}
+			_mm_storeu_ps(sum + i, vSum);
+		}
+		for(; i < end; ++i)
+		{
+			float s = 0.f;
+			for(int k=0; k<t; ++k)
+			{
+				const MLSample* px = pBuf + start[k] + (i - n);
+				float acc = 0.f;
+				for(int j=0; j<firTaps; ++j)
+				{
+					acc += w[k][j]*px[j];
+				}
+				ys[k][i] = acc;
+				s += gains[k]*acc;
+			}
+			sum[i] = s;
+		}
+		for(int k=0; k<t; ++k)
+		{
+			start[k] = (start[k] + count) & mLengthMask;
+		}
+		n = end;
+	}
+}
+
+void MLDelayBuffer::readModulated(MLSample* y, const int frames, const uintptr_t pos, const MLSample* delays,
+	const int mode, AllpassState& state) const
+{
+	const MLSample* pBuf = mBuffer.getConstBuffer();
+	const float* pSincTable = getSincTable();
+	float w[4];
+	switch(mode)
+	{
+		case kMLDelayInterpNone:
+			for(int n=0; n<frames; ++n)
+			{
+				y[n] = pBuf[(pos + n - (int)delays[n]) & mLengthMask];
+			}
+			break;
+		case kMLDelayInterpAllpass:
+			for(int n=0; n<frames; ++n)
+			{
+				int delayInt = (int)delays[n];
+				float d = delays[n] - delayInt;
+				if (d < 0.5f)
+				{
+					d += 1.f;
+					delayInt -= 1;
+				}
+				const float alpha = (1.f - d) / (1.f + d);
+				const MLSample x = pBuf[(pos + n - delayInt) & mLengthMask];
+				const MLSample out = alpha*x + state.x1 - alpha*state.y1;
+				state.x1 = x;
+				state.y1 = out;
+				y[n] = out;
+			}
+			break;
+		case kMLDelayInterpLinear:
+			for(int n=0; n<frames; ++n)
+			{
+				const int delayInt = (int)ceilf(delays[n]);
+				const float m = delayInt - delays[n];
+				const MLSample* px = pBuf + ((pos + n - delayInt) & mLengthMask);
+				y[n] = lerp(px[0], px[1], m);
+			}
+			break;
+		case kMLDelayInterpHermite:
+			for(int n=0; n<frames; ++n)
+			{
+				const int delayInt = (int)ceilf(delays[n]);
+				const float m = delayInt - delays[n];
+				const MLSample* px = pBuf + ((pos + n - delayInt - 1) & mLengthMask);
+				getInterpolationWeights(mode, m, w);
+				y[n] = w[0]*px[0] + w[1]*px[1] + w[2]*px[2] + w[3]*px[3];
+			}
+			break;
+		case kMLDelayInterpSinc:
+			for(int n=0; n<frames; ++n)
+			{
+				const int delayInt = (int)ceilf(delays[n]);
+				const float m = delayInt - delays[n];
+				const MLSample* px = pBuf + ((pos + n - delayInt - (kSincTaps/2 - 1)) & mLengthMask);
+				y[n] = sincDot(px, pSincTable + (int)(m*kSincPhases + 0.5f)*kSincTaps);
+			}
+			break;
+	}
+}
+
 // ----------------------------------------------------------------
 #pragma mark MLLinearDelay
 
@@ -326,56 +846,64 @@ MLSample MLAllpassDelay::processSample(const MLSample x)
 
 static const float kMaxDelayLength = 1.0f;
 
-void MLFDN::resize(int n)
+MLFDN::MLFDN() :
+    mSize(0),
+    mVectors(0),
+    mMatrixType(kMLFDNHouseholder),
+    mLengthMask(0),
+    mWriteIndex(0),
+    mMinDelay(1),
+    mDelayTime(0),
+    mFeedbackAmp(0),
+    mDecayTime(0),
+    mFreqMul(0.925),
+    mSR(44100),
+    mInvSr(1.f/44100.f)
 {
-    mDelays.resize(n);
-    for(int i=0; i<n; ++i)
+    for(int i=0; i<kMaxLines; ++i)
     {
-        mDelays[i].setSampleRate(mSR);
-        mDelays[i].resize(kMaxDelayLength);
+        mDelayInSamples[i] = 1;
+        mGain[i] = 0.f;
+        mLopassK[i] = 1.f;
+        mLopassY1[i] = 0.f;
     }
-
-    mFilters.resize(n);
-    mDelayOutputs.setDims(n);
-    
-    // make Householder feedback matrix (default)
-    mMatrix.setDims(n, n);
-    mMatrix.setIdentity();
-    mMatrix.subtract(2.0f/(float)n);
-    
-    mSize = n;
 }
 
-void MLFDN::setIdentityMatrix()
+void MLFDN::resize(int n)
 {
-    mMatrix.setIdentity();
+    int size = 4;
+    while((size < n) && (size < kMaxLines))
+    {
+        size <<= 1;
+    }
+    mSize = size;
+    mVectors = size >> kMLSamplesPerSSEVectorBits;
+    
+    int length = 1 << bitsToContain((int)(kMaxDelayLength*mSR));
+    mBuffer.setDims(length, mSize);
+    mLengthMask = length - 1;
+    mFrames.setDims(kMaxBlockSize*mSize);
+    clear();
 }
 
 void MLFDN::clear()
 {
-    for(int i=0; i<mDelays.size(); ++i)
-    {
-        mDelays[i].clear();
-    }
-    
-    for(int i=0; i<mFilters.size(); ++i)
+    mBuffer.clear();
+    mFrames.clear();
+    mWriteIndex = 0;
+    for(int i=0; i<kMaxLines; ++i)
     {
-        mFilters[i].clear();
+        mLopassY1[i] = 0.f;
     }
-    mDelayOutputs.clear();
 }
 
 void MLFDN::setSampleRate(int sr)
 {
     mSR = sr;
     mInvSr = 1.0f / (float)sr;
-    // delays samples rates need to be set here so resize calculates correctly
-    for(int i=0; i<mSize; ++i)
+    if(mSize)
     {
-        mDelays[i].setSampleRate(sr);
-        mDelays[i].resize(kMaxDelayLength);
-        mDelays[i].clear();        
-        mFilters[i].setSampleRate(sr);
+        resize(mSize);
     }
 }
 
@@ -384,52 +912,205 @@ void MLFDN::setDelayLengths(float maxLength)
 {
     float t = clamp(maxLength, 0.f, kMaxDelayLength);
     mDelayTime = t;
-    //debug() << " MLFDN delays: \n ";
+    mMinDelay = (int)mLengthMask;
     for(int i=0; i<mSize; ++i)
     {
-        // clear delay and set to all feedforward, no feedback
-        mDelays[i].setSampleRate(mSR);
-        mDelays[i].setMixParams(0., 1., 0.);
-        mDelays[i].clear();
-        
-        //debug() << "    " << i << " : " << t << "\n";
-        mDelays[i].setModDelay(t);
+        int d = clamp((int)(t*(float)mSR), 1, (int)mLengthMask);
+        mDelayInSamples[i] = d;
+        mMinDelay = min(mMinDelay, d);
         t *= mFreqMul;
         
         float offset = mDelayTime*0.02f;
         t += offset;
     }
+    calcGains();
+}
+
+void MLFDN::setFeedbackAmp(float f)
+{
+    mFeedbackAmp = f;
+    mDecayTime = 0.f;
+    calcGains();
+}
+
+void MLFDN::setDecayTime(float t)
+{
+    mDecayTime = t;
+    calcGains();
+}
+
+// with a decay time set, each line gets the gain that makes it lose 60 dB
+// in that time, so longer lines have lower gains. Otherwise all lines get
+// the feedback amp.
+void MLFDN::calcGains()
+{
+    for(int i=0; i<mSize; ++i)
+    {
+        if(mDecayTime > 0.f)
+        {
+            mGain[i] = powf(10.f, -3.f*(float)mDelayInSamples[i]*mInvSr / mDecayTime);
+        }
+        else
+        {
+            mGain[i] = mFeedbackAmp;
+        }
+    }
 }
 
 void MLFDN::setLopass(float f)
 {
     for(int i=0; i<mSize; ++i)
     {
-        mFilters[i].setOnePole(f);
+        setLineLopass(i, f);
+    }
+}
+
+void MLFDN::setLineLopass(int line, float f)
+{
+    if(within(line, 0, (int)kMaxLines))
+    {
+        mLopassK[line] = 1.f - expf(-kMLTwoPi*f*mInvSr);
+    }
+}
+
+// mix one frame of line outputs in place.
+inline void MLFDN::mix(__m128* v)
+{
+    switch(mMatrixType)
+    {
+        case kMLFDNHouseholder:
+        {
+            __m128 sum = v[0];
+            for(int j=1; j<mVectors; ++j)
+            {
+                sum = _mm_add_ps(sum, v[j]);
+            }
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_mul_ps(sum, _mm_set1_ps(2.f/(float)mSize));
+            for(int j=0; j<mVectors; ++j)
+            {
+                v[j] = _mm_sub_ps(v[j], sum);
+            }
+            break;
+        }
+        case kMLFDNHadamard:
+        {
+            // butterflies within each vector, then between vectors.
+            const __m128 sign1 = _mm_setr_ps(1.f, -1.f, 1.f, -1.f);
+            const __m128 sign2 = _mm_setr_ps(1.f, 1.f, -1.f, -1.f);
+            for(int j=0; j<mVectors; ++j)
+            {
+                __m128 a = v[j];
+                a = _mm_add_ps(_mm_mul_ps(a, sign1), _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+                a = _mm_add_ps(_mm_mul_ps(a, sign2), _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+                v[j] = a;
+            }
+            for(int h=1; h<mVectors; h <<= 1)
+            {
+                for(int j=0; j<mVectors; j += h*2)
+                {
+                    for(int k=j; k<j + h; ++k)
+                    {
+                        __m128 a = v[k];
+                        __m128 b = v[k + h];
+                        v[k] = _mm_add_ps(a, b);
+                        v[k + h] = _mm_sub_ps(a, b);
+                    }
+                }
+            }
+            const __m128 scale = _mm_set1_ps(1.f/sqrtf((float)mSize));
+            for(int j=0; j<mVectors; ++j)
+            {
+                v[j] = _mm_mul_ps(v[j], scale);
+            }
+            break;
+        }
+        default:
+            break;
     }
 }
 
 MLSample MLFDN::processSample(const MLSample x)
 {
-    float outputSum = 0.f;    
-    for(int j=0; j<mSize; ++j)
+    MLSample y;
+    processBlock(&x, &y, 1);
+    return y;
+}
+
+void MLFDN::processBlock(const MLSample* x, MLSample* y, const int frames)
+{
+    if(!mSize) return;
+    const int blockSize = min(mMinDelay, (int)kMaxBlockSize);
+    for(int n=0; n<frames; n += blockSize)
+    {
+        processSubBlock(x + n, y + n, min(blockSize, frames - n));
+    }
+}
+
+void MLFDN::processSubBlock(const MLSample* x, MLSample* y, const int frames)
+{
+    MLSample* pBuf = mBuffer.getBuffer();
+    MLSample* pFrames = mFrames.getBuffer();
+    const int lines = mSize;
+    
+    // read line outputs into frames.
+    for(int i=0; i<lines; ++i)
     {
-        // input + feedback
-        float inputSum = x;
-        for(int i=0; i<mSize; ++i)
+        const MLSample* pLine = pBuf + mBuffer.row(i);
+        uintptr_t readIndex = mWriteIndex - mDelayInSamples[i];
+        for(int n=0; n<frames; ++n)
         {
-            inputSum += mDelayOutputs[i]*mMatrix(i, j);
+            pFrames[n*lines + i] = pLine[(readIndex + n) & mLengthMask];
         }
-                
-        // delays
-        mDelayOutputs[j] = mDelays[j].processSample(inputSum);        
-        mDelayOutputs[j] *= mFeedbackAmp;
+    }
+    
+    // gain, damping and mixing, four lines at a time.
+    __m128 gain[kMaxLines/kSSEVecSize], k[kMaxLines/kSSEVecSize], y1[kMaxLines/kSSEVecSize];
+    __m128 v[kMaxLines/kSSEVecSize];
+    for(int j=0; j<mVectors; ++j)
+    {
+        gain[j] = _mm_loadu_ps(mGain + j*kSSEVecSize);
+        k[j] = _mm_loadu_ps(mLopassK + j*kSSEVecSize);
+        y1[j] = _mm_loadu_ps(mLopassY1 + j*kSSEVecSize);
+    }
+    for(int n=0; n<frames; ++n)
+    {
+        MLSample* pFrame = pFrames + n*lines;
+        __m128 sum = _mm_setzero_ps();
+        for(int j=0; j<mVectors; ++j)
+        {
+            __m128 a = _mm_mul_ps(_mm_load_ps(pFrame + j*kSSEVecSize), gain[j]);
+            y1[j] = _mm_add_ps(y1[j], _mm_mul_ps(k[j], _mm_sub_ps(a, y1[j])));
+            v[j] = y1[j];
+            sum = _mm_add_ps(sum, v[j]);
+        }
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_store_ss(y + n, sum);
         
-        // filters
-        mDelayOutputs[j] = mFilters[j].processSample(mDelayOutputs[j]);        
-        outputSum += mDelayOutputs[j];
+        mix(v);
+        const __m128 in = _mm_set1_ps(x[n]);
+        for(int j=0; j<mVectors; ++j)
+        {
+            _mm_store_ps(pFrame + j*kSSEVecSize, _mm_add_ps(v[j], in));
+        }
+    }
+    for(int j=0; j<mVectors; ++j)
+    {
+        _mm_storeu_ps(mLopassY1 + j*kSSEVecSize, y1[j]);
+    }
+    
+    // write line inputs from frames.
+    for(int i=0; i<lines; ++i)
+    {
+        MLSample* pLine = pBuf + mBuffer.row(i);
+        for(int n=0; n<frames; ++n)
+        {
+            pLine[(mWriteIndex + n) & mLengthMask] = pFrames[n*lines + i];
+        }
     }
-    return outputSum;
+    mWriteIndex += frames;
 }
 
 // ----------------------------------------------------------------
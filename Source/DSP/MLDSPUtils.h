@@ -165,6 +165,43 @@ private:
     float mInvSrDomain;
 };
 
+// ----------------------------------------------------------------
+#pragma mark MLNoiseGen
+
+enum eMLNoiseType
+{
+	kMLNoiseUniform = 0,
+	kMLNoiseGaussian,
+	kMLNoisePink,
+	kMLNoiseBrown
+};
+
+// a noise generator with its own state, so that each instance makes an uncorrelated
+// stream that can be reproduced from its seed. Uniform noise comes from an xorshift128+ 
+// generator running in two 64-bit SIMD lanes, making four samples per step. 
+// Gaussian noise is the sum of four uniform values, scaled to unit variance. Pink and 
+// brown noise are filtered from uniform noise and have about the same RMS level.
+
+class MLNoiseGen
+{
+public:
+	MLNoiseGen() { seed(0); }
+	~MLNoiseGen(){}
+	
+	// set the generator state from a seed and clear the filters.
+	void seed(uint32_t s);
+	void process(MLSample* y, const int frames, eMLNoiseType type);
+	
+private:
+	inline __m128i nextBits(__m128i& s0, __m128i& s1);
+	void processUniform(MLSample* y, const int frames, const int drawsPerSample);
+	
+	// two 64-bit lanes of state. Kept unaligned here and loaded into registers per block.
+	uint64_t mState[4];
+	float mPink0, mPink1, mPink2;
+	float mBrown;
+};
+
 // ----------------------------------------------------------------
 #pragma mark MLSampleDelay
 // a simple delay in integer samples with no mixing.
@@ -204,6 +241,81 @@ private:
 	uintptr_t mLengthMask;
     int mDelayInSamples;
 };
+
+// ----------------------------------------------------------------
+#pragma mark MLDelayBuffer
+// a power-of-two ring buffer for delay lines, read with a choice of fractional
+// delay interpolators. A guard region after the end of the buffer mirrors its
+// start, so the taps of any interpolator can be read contiguously from one
+// masked start index.
+
+enum eMLDelayInterpolation
+{
+	kMLDelayInterpNone = 0,
+	kMLDelayInterpLinear,
+	kMLDelayInterpAllpass,
+	kMLDelayInterpHermite,
+	kMLDelayInterpSinc
+};
+
+class MLDelayBuffer
+{
+public:
+	static const int kGuardSize = 16;
+	static const int kSincTaps = 16;
+	static const int kSincPhases = 512;
+	static const int kMaxGatherTaps = 8;
+
+	// history for allpass interpolation. Each reader of the buffer keeps its own.
+	class AllpassState
+	{
+	public:
+		AllpassState() : x1(0.f), y1(0.f) {}
+		void clear() { x1 = y1 = 0.f; }
+		MLSample x1, y1;
+	};
+
+	MLDelayBuffer() : mLength(0), mLengthMask(0), mWriteIndex(0) {}
+	~MLDelayBuffer() {}
+
+	// resize to hold at least the given number of samples. return false if out of memory.
+	bool resize(int samples);
+	void clear();
+
+	// write frames samples of x at the write index and advance it.
+	void write(const MLSignal& x, const int frames);
+
+	inline uintptr_t getWriteIndex() const { return mWriteIndex; }
+	inline uintptr_t getLengthMask() const { return mLengthMask; }
+
+	// the smallest delay in samples that an interpolation mode can read
+	// without reaching samples that have not been written yet.
+	static float getMinimumDelay(int mode);
+
+	// read frames samples into y. Output sample n is read from (pos + n - delay),
+	// where pos is a write index and delay is in samples.
+	// readConstant() uses one delay for the whole vector, so the interpolation
+	// coefficients are computed once and taps are read as contiguous runs.
+	void readConstant(MLSample* y, const int frames, const uintptr_t pos, const float delay,
+		const int mode, AllpassState& state) const;
+	void readModulated(MLSample* y, const int frames, const uintptr_t pos, const MLSample* delays,
+		const int mode, AllpassState& state) const;
+
+	// read up to kMaxGatherTaps taps with constant delays in one pass over the buffer,
+	// writing each tap to ys[k] and the sum of the taps times their gains to sum.
+	// Not for allpass interpolation, which keeps state for each reader.
+	void gatherConstant(MLSample* const* ys, const float* gains, MLSample* sum, const int taps, 
+		const int frames, const uintptr_t pos, const float* delays, const int mode) const;
+
+private:
+	static const float* getSincTable();
+
+	MLSignal mBuffer;
+	int mLength;
+	uintptr_t mLengthMask;
+	uintptr_t mWriteIndex;
+};
+
 // ----------------------------------------------------------------
 #pragma mark MLLinearDelay
 // a delay with one fixed feedback tap and one linear interpolated
@@ -328,41 +440,79 @@ private:
 // ----------------------------------------------------------------
 #pragma mark MLFDN
 
-// A general Feedback Delay Network with N delay lines connected in an NxN matrix.
+// A Feedback Delay Network with 4, 8 or 16 delay lines. The lines are mixed each sample
+// by a structured matrix instead of a dense one: Hadamard, done as a fast Walsh-Hadamard
+// transform in log2(N) stages, or Householder, I - (2/N) times a matrix of ones. Each line
+// has its own gain and one-pole lowpass for damping. The line state is kept as arrays
+// over lines so that the mixing, gains and filters run four lines at a time.
+//
+// a sample written to a line can't be read again until the shortest delay has passed,
+// so processBlock() runs in sub-blocks no longer than the shortest delay, reading and
+// writing each line in contiguous runs.
+
+enum eMLFDNMatrix
+{
+	kMLFDNHouseholder = 0,
+	kMLFDNHadamard,
+	kMLFDNIdentity
+};
 
 class MLFDN
 {
 public:
-    MLFDN() :
-        mSR(44100),
-        mSize(0),
-        mFeedbackAmp(0),
-        mFreqMul(0.925)
-        {}
-	~MLFDN()
-        {}
-    
-    // set the number of delay lines.
+	static const int kMaxLines = 16;
+	static const int kMaxBlockSize = 64;
+
+    MLFDN();
+	~MLFDN() {}
+    
+    // set the number of delay lines. This is rounded up to 4, 8 or 16.
     void resize(int n);
-    void setIdentityMatrix();
+    int getSize() const { return mSize; }
+    void setMatrix(int type) { mMatrixType = type; }
+    void setIdentityMatrix() { setMatrix(kMLFDNIdentity); }
     void clear();
     void setSampleRate(int sr);
     void setFreqMul(float m) { mFreqMul = m; }
     void setDelayLengths(float maxLength);
-    void setFeedbackAmp(float f) { mFeedbackAmp = f; }
+    
+    // set the gain of all lines.
+    void setFeedbackAmp(float f);
+    
+    // set the gain of each line so that all lines decay by 60 dB in t seconds.
+    void setDecayTime(float t);
     void setLopass(float f);
+    void setLineLopass(int line, float f);
     MLSample processSample(const MLSample x);
+    void processBlock(const MLSample* x, MLSample* y, const int frames);
     
 private:
+    void processSubBlock(const MLSample* x, MLSample* y, const int frames);
+    inline void mix(__m128* v);
+    void calcGains();
+    
     int mSize;
-    //std::vector<MLAllpassDelay> mDelays;
-    std::vector<MLLinearDelay> mDelays;
-    std::vector<MLBiquad> mAllpasses;
-    std::vector<MLBiquad> mFilters;
-    MLSignal mMatrix;
-    MLSignal mDelayOutputs;
+    int mVectors;
+    int mMatrixType;
+    
+    // one row per delay line, all with the same power-of-two length.
+    MLSignal mBuffer;
+    uintptr_t mLengthMask;
+    uintptr_t mWriteIndex;
+    int mDelayInSamples[kMaxLines];
+    int mMinDelay;
+    
+    // per-line gains and filter state.
+    float mGain[kMaxLines];
+    float mLopassK[kMaxLines];
+    float mLopassY1[kMaxLines];
+    
+    // line outputs, then line inputs, for one sub-block, one frame of all lines per sample.
+    MLSignal mFrames;
+    
     float mDelayTime;
     float mFeedbackAmp;
+    float mDecayTime;
     float mFreqMul;
     int mSR;
     float mInvSr;
@@ -0,0 +1,224 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLFFT.h"
+
+// ----------------------------------------------------------------
+#pragma mark MLFFT
+
+MLFFT::MLFFT() :
+	mSize(0),
+	mHalf(0)
+{
+}
+
+MLFFT::~MLFFT()
+{
+}
+
+void MLFFT::resize(int n)
+{
+	int bits = ilog2(max(n, 8));
+	mSize = 1 << bits;
+	mHalf = mSize >> 1;
+	const int halfBits = bits - 1;
+
+	mBitReverse.resize(mHalf);
+	for(int i=0; i<mHalf; ++i)
+	{
+		int r = 0;
+		for(int b=0; b<halfBits; ++b)
+		{
+			r |= ((i >> b) & 1) << (halfBits - 1 - b);
+		}
+		mBitReverse[i] = r;
+	}
+
+	// twiddles for the complex transform: exp(-2 pi i k / (n/2)).
+	mTwiddleRe.setDims(mHalf);
+	mTwiddleIm.setDims(mHalf);
+	for(int k=0; k<mHalf; ++k)
+	{
+		double phi = -kMLTwoPi*(double)k/(double)mHalf;
+		mTwiddleRe[k] = cos(phi);
+		mTwiddleIm[k] = sin(phi);
+	}
+
+	// twiddles for splitting the real spectrum: exp(-2 pi i k / n).
+	mRealTwiddleRe.setDims(mHalf);
+	mRealTwiddleIm.setDims(mHalf);
+	for(int k=0; k<mHalf; ++k)
+	{
+		double phi = -kMLTwoPi*(double)k/(double)mSize;
+		mRealTwiddleRe[k] = cos(phi);
+		mRealTwiddleIm[k] = sin(phi);
+	}
+
+	mTempRe.setDims(mHalf);
+	mTempIm.setDims(mHalf);
+}
+
+// complex FFT of size n/2 in place, in split form.
+// after bit reversal, each radix-4 pass does the work of two radix-2 passes,
+// combining four transforms of size L into one of size 4L.
+void MLFFT::transform(MLSample* re, MLSample* im, bool inverse)
+{
+	const int m = mHalf;
+	const float sign = inverse ? -1.f : 1.f;
+	const MLSample* pTwRe = mTwiddleRe.getConstBuffer();
+	const MLSample* pTwIm = mTwiddleIm.getConstBuffer();
+
+	for(int i=0; i<m; ++i)
+	{
+		int j = mBitReverse[i];
+		if(j > i)
+		{
+			std::swap(re[i], re[j]);
+			std::swap(im[i], im[j]);
+		}
+	}
+
+	int L = 1;
+	if(ilog2(m) & 1)
+	{
+		for(int i=0; i<m; i += 2)
+		{
+			float ar = re[i], ai = im[i];
+			float br = re[i + 1], bi = im[i + 1];
+			re[i] = ar + br;
+			im[i] = ai + bi;
+			re[i + 1] = ar - br;
+			im[i + 1] = ai - bi;
+		}
+		L = 2;
+	}
+
+	for(; L < m; L <<= 2)
+	{
+		const int stride = m/(L*4);
+		for(int g=0; g<m; g += L*4)
+		{
+			for(int j=0; j<L; ++j)
+			{
+				const int i0 = g + j;
+				const int i1 = i0 + L;
+				const int i2 = i1 + L;
+				const int i3 = i2 + L;
+
+				// w1 = exp(-2 pi i j / 4L), w2 = w1^2
+				const float w1r = pTwRe[j*stride];
+				const float w1i = sign*pTwIm[j*stride];
+				const float w2r = pTwRe[2*j*stride];
+				const float w2i = sign*pTwIm[2*j*stride];
+
+				// first radix-2 pass
+				float tr = re[i1]*w2r - im[i1]*w2i;
+				float ti = re[i1]*w2i + im[i1]*w2r;
+				const float b0r = re[i0] + tr, b0i = im[i0] + ti;
+				const float b1r = re[i0] - tr, b1i = im[i0] - ti;
+				tr = re[i3]*w2r - im[i3]*w2i;
+				ti = re[i3]*w2i + im[i3]*w2r;
+				const float b2r = re[i2] + tr, b2i = im[i2] + ti;
+				const float b3r = re[i2] - tr, b3i = im[i2] - ti;
+
+				// second radix-2 pass. the twiddle for b3 is w1 times -i (forward) or i (inverse).
+				tr = b2r*w1r - b2i*w1i;
+				ti = b2r*w1i + b2i*w1r;
+				re[i0] = b0r + tr;
+				im[i0] = b0i + ti;
+				re[i2] = b0r - tr;
+				im[i2] = b0i - ti;
+				float ur = b3r*w1r - b3i*w1i;
+				float ui = b3r*w1i + b3i*w1r;
+				tr = sign*ui;
+				ti = -sign*ur;
+				re[i1] = b1r + tr;
+				im[i1] = b1i + ti;
+				re[i3] = b1r - tr;
+				im[i3] = b1i - ti;
+			}
+		}
+	}
+}
+
+void MLFFT::forward(const MLSample* x, MLSample* re, MLSample* im)
+{
+	const int m = mHalf;
+	MLSample* zr = mTempRe.getBuffer();
+	MLSample* zi = mTempIm.getBuffer();
+	for(int k=0; k<m; ++k)
+	{
+		zr[k] = x[2*k];
+		zi[k] = x[2*k + 1];
+	}
+	transform(zr, zi, false);
+
+	re[0] = zr[0] + zi[0];
+	im[0] = zr[0] - zi[0];
+	for(int k=1; k<m; ++k)
+	{
+		const int mk = m - k;
+		const float feR = 0.5f*(zr[k] + zr[mk]);
+		const float feI = 0.5f*(zi[k] - zi[mk]);
+		const float foR = 0.5f*(zi[k] + zi[mk]);
+		const float foI = -0.5f*(zr[k] - zr[mk]);
+		const float wr = mRealTwiddleRe[k];
+		const float wi = mRealTwiddleIm[k];
+		re[k] = feR + wr*foR - wi*foI;
+		im[k] = feI + wr*foI + wi*foR;
+	}
+}
+
+void MLFFT::inverse(const MLSample* re, const MLSample* im, MLSample* x)
+{
+	const int m = mHalf;
+	MLSample* zr = mTempRe.getBuffer();
+	MLSample* zi = mTempIm.getBuffer();
+
+	zr[0] = 0.5f*(re[0] + im[0]);
+	zi[0] = 0.5f*(re[0] - im[0]);
+	for(int k=1; k<m; ++k)
+	{
+		const int mk = m - k;
+		const float feR = 0.5f*(re[k] + re[mk]);
+		const float feI = 0.5f*(im[k] - im[mk]);
+		const float dR = 0.5f*(re[k] - re[mk]);
+		const float dI = 0.5f*(im[k] + im[mk]);
+		const float wr = mRealTwiddleRe[k];
+		const float wi = -mRealTwiddleIm[k];
+		const float foR = dR*wr - dI*wi;
+		const float foI = dR*wi + dI*wr;
+		zr[k] = feR - foI;
+		zi[k] = feI + foR;
+	}
+	transform(zr, zi, true);
+
+	const float scale = 1.f/(float)m;
+	for(int k=0; k<m; ++k)
+	{
+		x[2*k] = zr[k]*scale;
+		x[2*k + 1] = zi[k]*scale;
+	}
+}
+
+void MLFFTMultiplyAdd(const MLSample* aRe, const MLSample* aIm, const MLSample* bRe, const MLSample* bIm,
+	MLSample* accRe, MLSample* accIm, const int bins)
+{
+	// DC and Nyquist are packed into bin 0 and multiply separately.
+	const float dc = accRe[0] + aRe[0]*bRe[0];
+	const float nyquist = accIm[0] + aIm[0]*bIm[0];
+	for(int k=0; k<bins; k += kSSEVecSize)
+	{
+		__m128 ar = _mm_load_ps(aRe + k);
+		__m128 ai = _mm_load_ps(aIm + k);
+		__m128 br = _mm_load_ps(bRe + k);
+		__m128 bi = _mm_load_ps(bIm + k);
+		__m128 r = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+		__m128 i = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+		_mm_store_ps(accRe + k, _mm_add_ps(_mm_load_ps(accRe + k), r));
+		_mm_store_ps(accIm + k, _mm_add_ps(_mm_load_ps(accIm + k), i));
+	}
+	accRe[0] = dc;
+	accIm[0] = nyquist;
+}
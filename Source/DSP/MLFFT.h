@@ -0,0 +1,60 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#ifndef _ML_FFT_H
+#define _ML_FFT_H
+
+#include <vector>
+
+#include "MLDSP.h"
+#include "MLSignal.h"
+
+// ----------------------------------------------------------------
+#pragma mark MLFFT
+
+// a real FFT of power-of-two size n. The real input is transformed as a complex
+// sequence of n/2 points by a radix-4 FFT, with one radix-2 pass first if
+// needed, then split into the n/2 + 1 bins of the real spectrum.
+//
+// spectra are stored in split form: n/2 real parts in re and n/2 imaginary parts
+// in im. the DC and Nyquist bins are both real, so the Nyquist bin is stored
+// in im[0]. The forward transform is unscaled and the inverse is scaled by 1/n,
+// so inverse(forward(x)) = x.
+//
+// an MLFFT object has its own scratch space, so one object must not be used
+// from two threads at once.
+
+class MLFFT
+{
+public:
+	MLFFT();
+	~MLFFT();
+
+	// set size n, a power of two >= 8. Allocates memory, so don't call from process().
+	void resize(int n);
+	int getSize() const { return mSize; }
+
+	void forward(const MLSample* x, MLSample* re, MLSample* im);
+	void inverse(const MLSample* re, const MLSample* im, MLSample* x);
+
+private:
+	MLFFT (const MLFFT&); // unimplemented
+	const MLFFT& operator= (const MLFFT&); // unimplemented
+
+	void transform(MLSample* re, MLSample* im, bool inverse);
+
+	int mSize;
+	int mHalf;
+	std::vector<int> mBitReverse;
+	MLSignal mTwiddleRe, mTwiddleIm;
+	MLSignal mRealTwiddleRe, mRealTwiddleIm;
+	MLSignal mTempRe, mTempIm;
+};
+
+// multiply the spectra a and b and add the result to acc. all are in the packed
+// split form of MLFFT, with bins = n/2.
+void MLFFTMultiplyAdd(const MLSample* aRe, const MLSample* aIm, const MLSample* bRe, const MLSample* bIm,
+	MLSample* accRe, MLSample* accIm, const int bins);
+
+#endif // _ML_FFT_H
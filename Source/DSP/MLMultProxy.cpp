@@ -5,6 +5,8 @@
 
 #include "MLMultProxy.h"
 
+#include <sched.h>
+
 // ----------------------------------------------------------------
 #pragma mark MLMultProxy
 //
@@ -35,6 +37,7 @@ void MLMultProxy::setCopies(const int newSize)
 		if (newSize != oldSize)
 		{
 			mCopies.resize(newSize);
+			mCopyOutputs.resize(newSize);
             // initialize new copies
             MLSymbol className = mTemplate->getClassName();
             MLSymbol procName = mTemplate->getName();
@@ -157,12 +160,11 @@ void MLMultiProc::process(const int n)
 	for (int i=1; i <= outs; ++i)
 	{
 		// sum outputs of copies to our MLProc output.
-		MLSignal& out = MLProc::getOutput(i);
-		out.clear();
 		for(int j=0; j < mEnabledCopies; ++j)
 		{
-			out.add(mCopies[j]->getOutput(i));
+			mCopyOutputs[j] = &(mCopies[j]->getOutput(i));
 		}
+		MLProc::getOutput(i).setToSum(&mCopyOutputs[0], mEnabledCopies, n);
 	}
 }
 
@@ -246,6 +248,16 @@ void MLMultiProc::setParam(const MLSymbol p, MLParamValue v)
 	MLProc::setParam(p, v);
 }	
 
+void MLMultiProc::getParamSetters(const MLSymbol p, std::vector<MLParamSetter>& setters)
+{
+	const int copies = (int)mCopies.size();	
+	for(int i=0; i<copies; i++)
+	{
+		mCopies[i]->getParamSetters(p, setters);
+	}
+	MLProc::getParamSetters(p, setters);
+}
+
 int MLMultiProc::getInputIndex(const MLSymbol name)
 {
 	return mTemplate->getInputIndex(name);
@@ -300,6 +312,112 @@ void MLMultiProc::dumpProc(int indent)
 	}
 }
 
+// ----------------------------------------------------------------
+#pragma mark MLCopyThreads
+//
+
+void* MLCopyThreadsWorker(void* arg)
+{
+	MLCopyThreads::Worker* pWorker = static_cast<MLCopyThreads::Worker*>(arg);
+	pWorker->pThreads->runWorker(pWorker->index);
+	return 0;
+}
+
+MLCopyThreads::MLCopyThreads() :
+	mpOwner(0),
+	mThreadCount(1),
+	mFrames(0),
+	mGeneration(0),
+	mDone(0),
+	mRunning(false)
+{
+}
+
+MLCopyThreads::~MLCopyThreads()
+{
+	stop();
+}
+
+bool MLCopyThreads::start(int threads)
+{
+	stop();
+	if (threads <= 1) return true;
+	
+	mpOwner = 0;
+	mThreadCount = threads;
+	mGeneration = 0;
+	mDone = 0;
+	mRunning = true;
+	
+	// reserve so that the workers' addresses don't change as they are added.
+	mWorkers.reserve(threads - 1);
+	for(int i=1; i<threads; ++i)
+	{
+		Worker w;
+		w.pThreads = this;
+		w.index = i;
+		mWorkers.push_back(w);
+		if (pthread_create(&mWorkers.back().thread, 0, MLCopyThreadsWorker, &mWorkers.back()) != 0)
+		{
+			mWorkers.pop_back();
+			stop();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MLCopyThreads::stop()
+{
+	mRunning = false;
+	__sync_synchronize();
+	for(unsigned i=0; i<mWorkers.size(); ++i)
+	{
+		pthread_join(mWorkers[i].thread, 0);
+	}
+	mWorkers.clear();
+	mThreadCount = 1;
+}
+
+void MLCopyThreads::process(MLMultiContainer* pOwner, const int frames)
+{
+	const int threads = mThreadCount;
+	const int workers = threads - 1;
+	
+	// publish the work, then do our share of it.
+	mpOwner = pOwner;
+	mFrames = frames;
+	mDone = 0;
+	__sync_synchronize();
+	__sync_fetch_and_add(&mGeneration, 1);
+	pOwner->processCopies(0, threads, frames);
+	
+	while(mDone < workers)
+	{
+		sched_yield();
+	}
+	__sync_synchronize();
+}
+
+void MLCopyThreads::runWorker(int index)
+{
+	const int threads = mThreadCount;
+	int generation = 0;
+	while(true)
+	{
+		while((mGeneration == generation) && mRunning)
+		{
+			sched_yield();
+		}
+		if (!mRunning) break;
+		generation = mGeneration;
+		__sync_synchronize();
+		
+		mpOwner->processCopies(index, threads, mFrames);
+		__sync_fetch_and_add(&mDone, 1);
+	}
+}
+
 // ----------------------------------------------------------------
 #pragma mark MLMultiContainer
 //
@@ -312,7 +430,8 @@ namespace multiContainer
 	MLProcOutput<MLMultiContainer> outputs[] = {"*"};
 }
 
-MLMultiContainer::MLMultiContainer() //: theProcFactory(MLProcFactory::theFactory())
+MLMultiContainer::MLMultiContainer() : //theProcFactory(MLProcFactory::theFactory())
+	mpThreads(0)
 {
 }
 
@@ -376,40 +495,61 @@ void MLMultiContainer::collectStats(MLSignalStats* pStats)
 	}
 }
 
+void MLMultiContainer::processCopies(const int first, const int stride, const int frames)
+{
+	for (int i=first; i < mEnabledCopies; i += stride)
+	{
+		getCopyAsContainer(i)->process(frames);
+	}
+}
+
+// the copies get the threads, so nested multiples are not threaded.
+void MLMultiContainer::setCopyThreads(MLCopyThreads* pThreads)
+{
+	mpThreads = pThreads;
+}
+
+// all copies are the same, so the first can answer for them.
+int MLMultiContainer::getFrameGranularity()
+{
+	MLProcContainer* pCopy = mCopies.size() ? getCopyAsContainer(0) : 0;
+	return pCopy ? pCopy->getFrameGranularity() : 1;
+}
+
 void MLMultiContainer::process(const int n)
 {
 	const int outs = getNumOutputs();
 	
 	// for each copy, process.  
-	// TODO this can be dispatched to multiple threads.
-	for (int i=0; i < mEnabledCopies; ++i)
+	if (mpThreads && (mpThreads->getThreads() > 1))
 	{
-		getCopyAsContainer(i)->process(n);
+		mpThreads->process(this, n);
+	}
+	else
+	{
+		processCopies(0, 1, n);
 	}
     
 	// for each of our outputs,
 	for (int i=1; i <= outs; ++i)
 	{
-		// sum outputs of copies to our output.
-		MLSignal& y = getOutput(i);
-		y.clear();
-                
+		// sum outputs of copies to our output. the last copy's output may share
+		// a buffer with ours, which setToSum() allows for.
+		int copies = 0;
 		for(int j=0; j < mEnabledCopies; ++j)
 		{
-            // TODO rewrite to handle multiple outputs better.
-            // right now if the last copy is enabled, it shares a buffer with the
-            // parent and this add doubles the last value. the hack in place adds one more copy to prevent this. 
-            MLProcContainer* pCopy = getCopyAsContainer(j);
-            if(pCopy)
-            {
-                y.add(pCopy->getOutput(i));
-            }
-            else
-            {
-                MLError() << "MLMultiContainer: null copy in process()!\n";
-            }
- 		}
-    }
+			MLProcContainer* pCopy = getCopyAsContainer(j);
+			if(pCopy)
+			{
+				mCopyOutputs[copies++] = &(pCopy->getOutput(i));
+			}
+			else
+			{
+				MLError() << "MLMultiContainer: null copy in process()!\n";
+			}
+		}
+		getOutput(i).setToSum(&mCopyOutputs[0], copies, n);
+	}
 }
 
 // Setup internal buffers and data to prepare for processing any attached input signals.
@@ -490,6 +630,16 @@ void MLMultiContainer::setParam(const MLSymbol p, MLParamValue v)
 	MLProc::setParam(p, v);
 }	
 
+void MLMultiContainer::getParamSetters(const MLSymbol p, std::vector<MLParamSetter>& setters)
+{
+	const int copies = (int)mCopies.size();	
+	for(int i=0; i<copies; i++)
+	{
+		mCopies[i]->getParamSetters(p, setters);
+	}
+	MLProc::getParamSetters(p, setters);
+}
+
 int MLMultiContainer::getInputIndex(const MLSymbol name)
 {
 	return getCopyAsContainer(0)->getInputIndex(name);
@@ -779,6 +929,16 @@ void MLMultiContainer::routeParam(const MLPath & procAddress, const MLSymbol par
 	// MLProcContainer::setPublishedParam(index, val);
 }
 
+void MLMultiContainer::resolveParam(const MLPath & procAddress, const MLSymbol paramName, std::vector<MLParamSetter>& setters)
+{
+	// resolve param in containers
+	const int copies = (int)mCopies.size();	
+	for(int i=0; i<copies; i++)
+	{
+		getCopyAsContainer(i)->resolveParam(procAddress, paramName, setters);
+	}
+}
+
 void MLMultiContainer::compile()
 {
 	const int copies = (int)mCopies.size();
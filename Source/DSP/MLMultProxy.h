@@ -8,6 +8,10 @@
 
 #include "MLProcContainer.h"
 
+#include <pthread.h>
+
+class MLMultiContainer;
+
 class MLMultProxy
 {
 friend class MLProcMultiple;
@@ -33,6 +37,9 @@ protected:
     MLProcPtr mTemplate;
 	std::vector<MLProcPtr> mCopies;
 	int mEnabledCopies;
+
+	// outputs of the enabled copies, to sum in process().
+	std::vector<const MLSignal*> mCopyOutputs;
 };
 
 
@@ -54,6 +61,7 @@ public:
 	void clearInput(int i);	 
 	MLProc::err setInput(const int idx, const MLSignal& srcSig);	
 	void setParam(const MLSymbol p, MLParamValue v);	
+	void getParamSetters(const MLSymbol p, std::vector<MLParamSetter>& setters);
 	int getInputIndex(const MLSymbol name);
 	int getOutputIndex(const MLSymbol name);		
 	void createInput(const int idx);		
@@ -66,9 +74,61 @@ private:
 };
 
 
+// ----------------------------------------------------------------
+#pragma mark MLCopyThreads
+
+// worker threads that process the enabled copies of MLMultiContainers in parallel.
+// One pool is shared by all the multiples in an engine. The multiples are processed one 
+// after another, so the pool works on one multiple at a time. Copy i is always processed 
+// by thread (i % threads), the calling thread being thread 0, so the results do not depend 
+// on scheduling. Idle workers spin and yield instead of sleeping, so this is meant for 
+// offline rendering where all the cores are ours.
+
+class MLCopyThreads
+{
+public:
+	MLCopyThreads();
+	~MLCopyThreads();
+	
+	// start threads - 1 workers, stopping any running ones first.
+	// threads <= 1 just stops them. returns false if the workers could not be made.
+	bool start(int threads);
+	void stop();
+	int getThreads() const { return mThreadCount; }
+	
+	// process all enabled copies of the owner and return when they are done.
+	void process(MLMultiContainer* pOwner, const int frames);
+	
+private:
+	MLCopyThreads (const MLCopyThreads&); // unimplemented
+	const MLCopyThreads& operator= (const MLCopyThreads&); // unimplemented
+
+	struct Worker
+	{
+		MLCopyThreads* pThreads;
+		int index;
+		pthread_t thread;
+	};
+	
+	void runWorker(int index);
+	friend void* MLCopyThreadsWorker(void* arg);
+	
+	MLMultiContainer* volatile mpOwner;
+	std::vector<Worker> mWorkers;
+	int mThreadCount;
+	volatile int mFrames;
+	volatile int mGeneration;
+	volatile int mDone;
+	volatile bool mRunning;
+};
+
+// ----------------------------------------------------------------
+#pragma mark MLMultiContainer
+
 class MLMultiContainer : public MLProcContainer, public MLMultProxy
 {
 friend class MLDSPEngine;
+friend class MLCopyThreads;
 public:
 	MLMultiContainer();
 	~MLMultiContainer();
@@ -89,6 +149,8 @@ public:
 	void process(const int n);		
 	err prepareToProcess();	
 	void clear();
+	int getFrameGranularity();
+	void setCopyThreads(MLCopyThreads* pThreads);
 
 	// not in ContainerBase because this is a virtual method of MLProc.
 	bool isContainer(void) { return true; }
@@ -104,6 +166,7 @@ public:
 	//
 	MLProc::err setInput(const int idx, const MLSignal& srcSig);	
 	void setParam(const MLSymbol p, MLParamValue v);	
+	void getParamSetters(const MLSymbol p, std::vector<MLParamSetter>& setters);
 	//
 	int getInputIndex(const MLSymbol name);
 	int getOutputIndex(const MLSymbol name);		
@@ -138,11 +201,18 @@ public:
 	void addSetterToParam(MLPublishedParamPtr p, const MLPath & procName, const MLSymbol param);
 	void setPublishedParam(int index, MLParamValue val);
 	void routeParam(const MLPath & procAddress, const MLSymbol paramName, MLParamValue val);
+	void resolveParam(const MLPath & procAddress, const MLSymbol paramName, std::vector<MLParamSetter>& setters);
 	//
 	void compile();
 
 private:
 	MLProcInfo<MLMultiContainer> mInfo; //  unused except for errors
+	
+	// process the enabled copies from first on, stepping by stride.
+	void processCopies(const int first, const int stride, const int frames);
+	
+	// the engine's shared pool, or 0 to process the copies on the calling thread.
+	MLCopyThreads* mpThreads;
 
 
 };
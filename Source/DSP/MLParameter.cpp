@@ -18,6 +18,8 @@ MLPublishedParam::MLPublishedParam(const MLPath & procPath, const MLSymbol name,
 	mDefault = 0.f;
 	mZeroThreshold = 0.f - (MLParamValue)(2 << 16);
 	mGroupIndex = -1;
+	mSmoothing = kMLParamSmoothNone;
+	mSmoothTime = 0.f;
 	addAddress(procPath, name);
 }
 
@@ -165,6 +167,183 @@ MLParamValue MLPublishedParam::setValueAsLinearProportion (MLParamValue p)
 	return val;
 }
 
+// ----------------------------------------------------------------
+#pragma mark MLParamSmoother
+
+MLParamSmoother::MLParamSmoother() :
+	mSmoothing(kMLParamSmoothNone),
+	mRampFrames(0),
+	mPoleCoeff(0.f),
+	mValue(0.f),
+	mTarget(0.f),
+	mStep(0.f),
+	mRemaining(0),
+	mOffset(0),
+	mActive(false)
+{
+}
+
+MLParamSmoother::~MLParamSmoother()
+{
+}
+
+void MLParamSmoother::setPolicy(eMLParamSmoothing s, MLParamValue time, MLSampleRate sr)
+{
+	const int frames = (int)(time*sr);
+	mSmoothing = (frames > 0) ? s : kMLParamSmoothNone;
+	mRampFrames = max(frames, 1);
+	
+	// one-pole coefficient per sample for the time constant.
+	mPoleCoeff = expf(-1.f/(float)mRampFrames);
+	reset(mTarget);
+}
+
+void MLParamSmoother::reset(MLParamValue val)
+{
+	mValue = mTarget = val;
+	mStep = 0.f;
+	mRemaining = 0;
+	mOffset = 0;
+	mActive = false;
+}
+
+void MLParamSmoother::setTarget(MLParamValue val, int offset)
+{
+	mTarget = val;
+	mOffset = max(offset, 0);
+	if (mSmoothing == kMLParamSmoothLinear)
+	{
+		mStep = (mTarget - mValue)/(MLParamValue)mRampFrames;
+		mRemaining = mRampFrames;
+	}
+	mActive = true;
+}
+
+MLParamRamp MLParamSmoother::nextRamp(int frames)
+{
+	MLParamRamp r;
+	r.start = mValue;
+	r.offset = min(mOffset, frames - 1);
+	const int changeFrames = frames - r.offset;
+	mOffset = 0;
+	
+	switch(mSmoothing)
+	{
+		case kMLParamSmoothNone:
+		default:
+			mValue = mTarget;
+			r.step = mValue - r.start;
+			mActive = false;
+			break;
+		case kMLParamSmoothLinear:
+		{
+			const int n = min(mRemaining, changeFrames);
+			mRemaining -= n;
+			mValue = (mRemaining > 0) ? mValue + mStep*(MLParamValue)n : mTarget;
+			r.step = mStep;
+			mActive = (mRemaining > 0);
+			break;
+		}
+		case kMLParamSmoothOnePole:
+		{
+			// evaluate the filter once for the vector, and ramp linearly to the result.
+			mValue = mTarget + (mValue - mTarget)*powf(mPoleCoeff, (float)changeFrames);
+			const MLParamValue range = max(fabsf(mTarget), 1.f);
+			if (fabsf(mValue - mTarget) < range*1e-5f)
+			{
+				mValue = mTarget;
+				mActive = false;
+			}
+			r.step = (mValue - r.start)/(MLParamValue)changeFrames;
+			break;
+		}
+	}
+	r.end = mValue;
+	return r;
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLParamChangeQueue
+
+namespace
+{
+	inline uint64_t packChange(MLParamValue val, int offset)
+	{
+		union { MLParamValue f; uint32_t i; } v;
+		v.f = val;
+		return ((uint64_t)(uint32_t)offset << 32) | v.i;
+	}
+	
+	inline void unpackChange(uint64_t packed, MLParamValue& val, int& offset)
+	{
+		union { MLParamValue f; uint32_t i; } v;
+		v.i = (uint32_t)(packed & 0xFFFFFFFF);
+		val = v.f;
+		offset = (int)(uint32_t)(packed >> 32);
+	}
+}
+
+MLParamChangeQueue::MLParamChangeQueue() :
+	mSize(0),
+	mRingMask(0),
+	mWriteIndex(0),
+	mReadIndex(0)
+{
+}
+
+MLParamChangeQueue::~MLParamChangeQueue()
+{
+}
+
+void MLParamChangeQueue::resize(int size)
+{
+	mSize = max(size, 0);
+	int ringSize = 1 << bitsToContain(max(mSize, 1));
+	mPendingChanges.assign(mSize, 0);
+	mPendingFlags.assign(mSize, 0);
+	mRing.assign(ringSize, -1);
+	mRingMask = ringSize - 1;
+	mWriteIndex = 0;
+	mReadIndex = 0;
+	__sync_synchronize();
+}
+
+bool MLParamChangeQueue::push(int index, MLParamValue val, int offset)
+{
+	if (!within(index, 0, mSize)) return false;
+	
+	// store the new value, then queue the index unless it is already queued.
+	__sync_lock_test_and_set(&mPendingChanges[index], packChange(val, offset));
+	if (__sync_bool_compare_and_swap(&mPendingFlags[index], 0, 1))
+	{
+		const unsigned w = __sync_fetch_and_add(&mWriteIndex, 1);
+		__sync_synchronize();
+		mRing[w & mRingMask] = index;
+	}
+	return true;
+}
+
+bool MLParamChangeQueue::pop(MLParamChange& change)
+{
+	if (!mSize) return false;
+	
+	// a writer may have claimed the next slot but not yet written it. In that 
+	// case we stop, and the change is picked up on the next call.
+	volatile int* pSlot = &mRing[mReadIndex & mRingMask];
+	const int index = *pSlot;
+	if (index < 0) return false;
+	*pSlot = -1;
+	mReadIndex++;
+	
+	__sync_synchronize();
+	mPendingFlags[index] = 0;
+	__sync_synchronize();
+	const uint64_t packed = __sync_fetch_and_or(&mPendingChanges[index], 0);
+	change.index = index;
+	unpackChange(packed, change.value, change.offset);
+	return true;
+}
+
 // ----------------------------------------------------------------
 #pragma mark named parameter groups
 
@@ -9,6 +9,7 @@
 #include <vector>
 #include <list>
 #include <utility>
+#include <stdint.h>
 
 #include "MLDSP.h"
 #include "MLSymbol.h"
@@ -36,6 +37,13 @@ typedef enum
 	kJucePluginParam_ExpBipolar
 }	JucePluginParamWarpMode;
 
+typedef enum
+{
+	kMLParamSmoothNone,
+	kMLParamSmoothLinear,
+	kMLParamSmoothOnePole
+}	eMLParamSmoothing;
+
 // ----------------------------------------------------------------
 // a published param means: named parameter mParam of mProc is called mAlias.
 //
@@ -83,6 +91,12 @@ public:
 	void setGroupIndex(int g) { mGroupIndex = g; }
 
 	MLSymbol getAlias(void) { return mAlias; }
+	
+	// how changes are smoothed by the engine. time is the linear ramp time or
+	// one-pole time constant in seconds.
+	void setSmoothing(eMLParamSmoothing s, MLParamValue time) { mSmoothing = s; mSmoothTime = time; }
+	eMLParamSmoothing getSmoothing(void) const { return mSmoothing; }
+	MLParamValue getSmoothTime(void) const { return mSmoothTime; }
 				
 	typedef std::list<ParamAddress>::const_iterator AddressIterator;
 	AddressIterator beginAddress() { return mAddresses.begin(); }
@@ -104,10 +118,129 @@ private:
 	JucePluginParamUnit mUnit;
 	JucePluginParamWarpMode mWarpMode;
 	int mGroupIndex;	// -1 for none
+	eMLParamSmoothing mSmoothing;
+	MLParamValue mSmoothTime;
 };
 
 typedef std::tr1::shared_ptr<MLPublishedParam> MLPublishedParamPtr;
 
+// ----------------------------------------------------------------
+#pragma mark parameter ramps
+
+// a parameter's value over one vector, as given to procs by the engine. The value 
+// is start before sample offset. From offset on it moves by step each sample until 
+// it reaches end, which is the value at the end of the vector. A step change at 
+// offset has step = end - start.
+struct MLParamRamp
+{
+	MLParamValue start;
+	MLParamValue end;
+	MLParamValue step;
+	int offset;
+	
+	inline MLParamValue getValue(int n) const
+	{
+		if (n < offset) return start;
+		const MLParamValue v = start + step*(MLParamValue)(n - offset + 1);
+		return (step > 0.f) ? min(v, end) : max(v, end);
+	}
+	inline bool isConstant() const { return start == end; }
+};
+
+// smooths the changes to one published param, making one MLParamRamp per vector.
+class MLParamSmoother
+{
+public:
+	MLParamSmoother();
+	~MLParamSmoother();
+	
+	void setPolicy(eMLParamSmoothing s, MLParamValue time, MLSampleRate sr);
+	
+	// jump to val with no smoothing.
+	void reset(MLParamValue val);
+	
+	// start moving to val at sample offset in the next vector.
+	void setTarget(MLParamValue val, int offset);
+	
+	// true if the next vector has a change.
+	bool isActive() const { return mActive; }
+	
+	// true if changes are smoothed. Unsmoothed changes are not given as ramps, so 
+	// procs can handle them as they do any other param change.
+	bool isSmoothing() const { return mSmoothing != kMLParamSmoothNone; }
+	
+	// get the ramp for the next vector of the given size, and advance.
+	MLParamRamp nextRamp(int frames);
+	
+private:
+	eMLParamSmoothing mSmoothing;
+	int mRampFrames;
+	MLParamValue mPoleCoeff;
+	
+	MLParamValue mValue;
+	MLParamValue mTarget;
+	MLParamValue mStep;
+	int mRemaining;
+	int mOffset;
+	bool mActive;
+};
+
+// ----------------------------------------------------------------
+#pragma mark parameter change queue
+
+// a change to the published parameter with the given index, at a sample offset
+// from the start of the next processed block.
+struct MLParamChange
+{
+	int index;
+	MLParamValue value;
+	int offset;
+};
+
+// a bounded lock-free queue of parameter changes from any number of writer threads 
+// to one reader thread. Changes to the same parameter are coalesced: if a parameter 
+// changes again before the reader gets to it, only the latest value and offset are kept.
+// 
+// each parameter has a pending value and a flag. Only the writer that sets the flag
+// puts the parameter's index in the ring, so each index is in the ring at most once and
+// the ring can never overflow. The reader clears the flag before reading the value, so 
+// a write that happens during the read is either seen or queued again.
+
+class MLParamChangeQueue
+{
+public:
+	MLParamChangeQueue();
+	~MLParamChangeQueue();
+	
+	// allocate for parameters [0, size) and empty the queue. Not thread safe:
+	// call only while no other thread is using the queue.
+	void resize(int size);
+	int getSize() const { return mSize; }
+
+	// queue a change. returns false if the index is out of range. Can be called from
+	// any number of threads and never blocks.
+	bool push(int index, MLParamValue val, int offset = 0);
+	
+	// get the next change if there is one. Call only from the reader thread.
+	bool pop(MLParamChange& change);
+
+private:
+	MLParamChangeQueue (const MLParamChangeQueue&); // unimplemented
+	const MLParamChangeQueue& operator= (const MLParamChangeQueue&); // unimplemented
+
+	int mSize;
+	
+	// pending value and offset for each parameter, packed so they are written together.
+	std::vector<uint64_t> mPendingChanges;
+	std::vector<int> mPendingFlags;
+	
+	// indices of parameters with pending changes. -1 marks an empty slot.
+	std::vector<int> mRing;
+	unsigned mRingMask;
+	volatile unsigned mWriteIndex;
+	unsigned mReadIndex;
+};
+
 // ----------------------------------------------------------------
 #pragma mark named parameter groups
 
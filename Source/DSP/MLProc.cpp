@@ -189,6 +189,26 @@ void MLProc::setParam(const MLSymbol pname, MLParamValue f)
 	mParamsChanged = true;
 }
 
+void MLProc::setParamRamp(MLParamValue* pValue, const MLParamRamp& ramp)
+{
+	setParamValue(pValue, ramp.end);
+}
+
+void MLProc::getParamSetters(const MLSymbol pname, std::vector<MLParamSetter>& setters)
+{
+	MLParamSetter s;
+	s.pProc = this;
+	s.pValue = procInfo().getParamPtr(pname);
+	if (s.pValue)
+	{
+		setters.push_back(s);
+	}
+	else
+	{
+		debug() << "MLProc::getParamSetters: " << getName() << " has no parameter " << pname << "!\n";
+	}
+}
+
 int MLProc::getInputIndex(const MLSymbol name) 
 { 
 	// get index
@@ -361,6 +381,19 @@ MLSymbol MLProc::getNameWithCopyIndex()
     }
 }
 
+uint32_t MLProc::getInstanceSeed() const
+{
+	// FNV-1a hash of the name, mixed with the copy index.
+	const std::string& name = mName.getString();
+	uint32_t s = 2166136261U;
+	for(unsigned i=0; i<name.length(); ++i)
+	{
+		s = (s ^ (uint8_t)name[i]) * 16777619U;
+	}
+	s = (s ^ (uint32_t)mCopyIndex) * 16777619U;
+	return s;
+}
+
 void MLProc::dumpParams()
 {
 	MLSymbolMap& map = procInfo().getParamMap();
@@ -16,6 +16,7 @@
 #include "MLDSPContext.h"
 #include "MLSymbol.h"
 #include "MLSymbolMap.h"
+#include "MLParameter.h"
 
 #define CHECK_IO    0
 
@@ -52,6 +53,7 @@ public:
 	virtual ~MLProcInfoBase() {};	
 	virtual void setParam(const MLSymbol paramName, MLParamValue value) = 0;
 	virtual MLParamValue getParam(const MLSymbol paramName) = 0;
+	virtual MLParamValue* getParamPtr(const MLSymbol paramName) = 0;
 	virtual MLSymbolMap& getParamMap() const = 0;
 	virtual MLSymbolMap& getInputMap() const = 0;
 	virtual MLSymbolMap& getOutputMap() const = 0;
@@ -132,6 +134,18 @@ friend class MLProcFactory;
 		return *(mParams[paramName]);
 	}
 	
+	// get a pointer to the storage for the named parameter, or 0 if there is none.
+	// the pointer stays valid as long as no parameters are added to the class.
+	MLParamValue* getParamPtr(const MLSymbol paramName)
+	{
+		if (hasVariableParams())
+		{
+			getParam(paramName);
+		}
+		MLParamValue* p = mParams[paramName];
+		return (p != mParams.getNullElement()) ? p : 0;
+	}
+	
 	MLSymbolMap& getParamMap() const { return getClassParamMap(); } 
 	MLSymbolMap& getInputMap() const { return getClassInputMap(); } 
 	MLSymbolMap& getOutputMap() const { return getClassOutputMap(); } 
@@ -301,6 +315,17 @@ public:
 	}
 };
 
+class MLProc;
+
+// a parameter destination resolved ahead of time: a proc and a pointer to the
+// storage of one of its parameters. Containers make a table of these for each 
+// published parameter so that setting the parameter needs no lookups.
+struct MLParamSetter
+{
+	MLProc* pProc;
+	MLParamValue* pValue;
+};
+
 // an MLProc processes signals.  It contains Signals to receive its output.  
 // If the block size is small enough, the buffers in these Signals are 
 // internal to the MLProc object.  
@@ -418,6 +443,22 @@ public:
 	virtual MLParamValue getParam(const MLSymbol p);	
 	virtual void setParam(const MLSymbol p, MLParamValue v);	
 
+	// append the destinations that setParam(p) would write to. MLMultiProc and 
+	// MLMultiContainer add one setter for each copy.
+	virtual void getParamSetters(const MLSymbol p, std::vector<MLParamSetter>& setters);
+	
+	// set a parameter through a pointer from getParamSetters(), without lookup.
+	inline void setParamValue(MLParamValue* pValue, MLParamValue v)
+	{
+		*pValue = v;
+		mParamsChanged = true;
+	}
+	
+	// set a parameter that is changing over the next vector. By default the
+	// parameter is set to the value at the end of the ramp. Procs that can make 
+	// use of the whole ramp override this.
+	virtual void setParamRamp(MLParamValue* pValue, const MLParamRamp& ramp);
+
 	// MLProc returns the index to an entry in its proc map.
 	// MLProcContainer returns an index to a published input or output.
 	virtual int getInputIndex(const MLSymbol name);	
@@ -441,6 +482,10 @@ public:
 	const MLSymbol& getName() const { return mName; }
     int getCopyIndex() const { return mCopyIndex; }
     MLSymbol getNameWithCopyIndex();
+	
+	// a seed for random generators made from the name and copy index, so that
+	// each voice gets its own sequence, the same every run.
+	uint32_t getInstanceSeed() const;
 	void dumpParams();
 	virtual void dumpProc(int indent);
 
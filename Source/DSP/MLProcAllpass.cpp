@@ -33,6 +33,7 @@ private:
 	float mNoiseGain;
 	float mNoisePeriodSeconds;
 	float mOneOverNoiseDomain;
+	uint32_t mRandState;
 };
 
 
@@ -57,6 +58,7 @@ MLProcAllpass::MLProcAllpass()
 	mGain = 0.5f;
 	mNoiseGain = 0.f;
 	mNoiseIndex = 0;
+	mRandState = 0;
 }
 
 MLProcAllpass::~MLProcAllpass()
@@ -93,6 +95,7 @@ void MLProcAllpass::clear()
 {	
 	mX.clear();
 	mWriteIndex = 0;
+	mRandState = getInstanceSeed();
 }
 
 
@@ -155,7 +158,7 @@ void MLProcAllpass::process(const int frames)
 		xc4 = xc2 * xc2;
 		w = (1.f - xc2*p25 + xc4*0.015625f) * p25;
 		
-		noise = MLRand() * w;		
+		noise = MLRand(mRandState) * w;		
 		mNoiseIndex++;
 #endif		
 		
@@ -164,7 +167,7 @@ void MLProcAllpass::process(const int frames)
 		v = x[n] + mGain*fxn;
 
 		// TODO remove this, again mystery denormal workaround!
-		MLSample noiseHack = MLRand() * noiseAmp;
+		MLSample noiseHack = MLRand(mRandState) * noiseAmp;
 		v += noiseHack;
 
 #if DEMO
@@ -491,6 +491,12 @@ void MLProcContainer::compile()
         debug() << "NULL: " << &getNullOutput() << "\n";
         debug() << "\n";
     }
+	
+	// ----------------------------------------------------------------
+	// resolve published param addresses into setters.
+	// 
+	buildParamSetters();
+	
 	if (verbose)
 	{
 		// dump compile graph
@@ -745,6 +751,41 @@ void MLProcContainer::collectStats(MLSignalStats* pStats)
 #pragma mark -
 #pragma mark process
 
+int MLProcContainer::getFrameGranularity()
+{
+	// least common multiple of the subcontainers' granularities.
+	int g = 1;
+	for (std::list<MLProcPtr>::const_iterator it = mOpsList.begin(); it != mOpsList.end(); ++it)
+	{
+		MLProc* p = (*it).get();
+		if (p->isContainer())
+		{
+			MLRatio r(g, static_cast<MLProcContainer*>(p)->getFrameGranularity());
+			r.simplify();
+			g *= r.bottom;
+		}
+	}
+	
+	// our frames times our ratio must be a whole number of g frames.
+	const MLRatio myRatio = getResampleRatio();
+	if (myRatio.isZero()) return g;
+	MLRatio q(g * myRatio.bottom, myRatio.top);
+	q.simplify();
+	return q.top;
+}
+
+void MLProcContainer::setCopyThreads(MLCopyThreads* pThreads)
+{
+	for (std::list<MLProcPtr>::const_iterator it = mOpsList.begin(); it != mOpsList.end(); ++it)
+	{
+		MLProc* p = (*it).get();
+		if (p->isContainer())
+		{
+			static_cast<MLProcContainer*>(p)->setCopyThreads(pThreads);
+		}
+	}
+}
+
 // process signals.
 void MLProcContainer::process(const int extFrames)
 {
@@ -1623,12 +1664,14 @@ MLPublishedParamPtr MLProcContainer::publishParam(const MLPath & procPath, const
 	p = MLPublishedParamPtr(new MLPublishedParam(procPath, param, alias, (int)i));
 	mPublishedParams.push_back(p);	
 	mPublishedParamMap[alias] = p; 
+	mParamSetterStarts.clear();
 	return p;
 }
 
 void MLProcContainer::addSetterToParam(MLPublishedParamPtr p, const MLPath & procName, const MLSymbol paramName)
 {
 	p->addAddress(procName, paramName);
+	mParamSetterStarts.clear();
 }
 
 void MLProcContainer::setPublishedParam(int index, MLParamValue val)
@@ -1643,16 +1686,74 @@ void MLProcContainer::setPublishedParam(int index, MLParamValue val)
 //debug() << "in: " << val << "\n";			
 			val = p->setValue(val);
 //debug() << "out: " << val << "\n";			
+			sendPublishedParam(index, val);
+		}
+	}
+}
+
+void MLProcContainer::sendPublishedParam(int index, MLParamValue val)
+{
+	if (index + 1 < (int)mParamSetterStarts.size())
+	{
+		// set params through the setters made by compile().
+		const int end = mParamSetterStarts[index + 1];
+		for(int i = mParamSetterStarts[index]; i < end; ++i)
+		{
+			const MLParamSetter& s = mParamSetters[i];
+			s.pProc->setParamValue(s.pValue, val);
+		}
+	}
+	else if (within(index, 0, (int)mPublishedParams.size()))
+	{
+		MLPublishedParamPtr p = mPublishedParams[index];
+		if (p)
+		{
 			for(MLPublishedParam::AddressIterator it = p->beginAddress(); it != p->endAddress(); ++it)
 			{		
 				// set param at address.
-//debug() << "setting param #" << index << ", " << it->paramName << " of " << it->procAddress << " to " << val << "\n";	
 				routeParam(it->procAddress, it->paramName, val);			
 			}
 		}
 	}
 }
 
+void MLProcContainer::sendPublishedParamRamp(int index, const MLParamRamp& ramp)
+{
+	if (index + 1 < (int)mParamSetterStarts.size())
+	{
+		const int end = mParamSetterStarts[index + 1];
+		for(int i = mParamSetterStarts[index]; i < end; ++i)
+		{
+			const MLParamSetter& s = mParamSetters[i];
+			s.pProc->setParamRamp(s.pValue, ramp);
+		}
+	}
+	else
+	{
+		sendPublishedParam(index, ramp.end);
+	}
+}
+
+void MLProcContainer::buildParamSetters()
+{
+	const int size = (int)mPublishedParams.size();
+	mParamSetters.clear();
+	mParamSetterStarts.resize(size + 1);
+	for(int i=0; i<size; ++i)
+	{
+		mParamSetterStarts[i] = (int)mParamSetters.size();
+		MLPublishedParamPtr p = mPublishedParams[i];
+		if (p)
+		{
+			for(MLPublishedParam::AddressIterator it = p->beginAddress(); it != p->endAddress(); ++it)
+			{		
+				resolveParam(it->procAddress, it->paramName, mParamSetters);			
+			}
+		}
+	}
+	mParamSetterStarts[size] = (int)mParamSetters.size();
+}
+
 MLParamValue MLProcContainer::getParam(const MLSymbol alias)
 {
 	MLParamValue r = 0.f;
@@ -1728,6 +1829,45 @@ void MLProcContainer::routeParam(const MLPath & procAddress, const MLSymbol para
 	}
 }
 
+void MLProcContainer::resolveParam(const MLPath & procAddress, const MLSymbol paramName, std::vector<MLParamSetter>& setters)
+{
+	const MLSymbol head = procAddress.head();
+	const MLPath tail = procAddress.tail();
+	
+	MLSymbolProcMapT::iterator it = mProcMap.find(head);
+	if (it != mProcMap.end())
+	{
+		MLProcPtr headProc = it->second;	
+		if (!tail.empty())
+		{
+			if (headProc->isContainer())  
+			{
+				MLProcContainer& headContainer = static_cast<MLProcContainer&>(*headProc);
+				headContainer.resolveParam(tail, paramName, setters);
+			}
+			else
+			{
+				debug() << "ack, head proc in param address is not container!\n";
+			}		
+		}
+		else
+		{
+			headProc->getParamSetters(paramName, setters);
+		}
+	}
+	else 
+	{
+		if (head == MLSymbol("this"))
+		{
+			getParamSetters(paramName, setters);
+		}
+		else
+		{
+			debug() << "MLProcContainer::resolveParam: proc " << head << " not found in container " << getName() << "!\n";
+		}
+	}
+}
+
 // ----------------------------------------------------------------
 #pragma mark engine params
 
@@ -2084,6 +2224,21 @@ void MLProcContainer::setPublishedParamAttrs(MLPublishedParamPtr p, juce::XmlEle
 			p->setDefault((MLParamValue)child->getDoubleAttribute("value", 0.f));
 		}
 	
+		else if(child->hasTagName("smooth"))
+		{
+			// <smooth type="linear" time="0.02"/>. type is none, linear or onepole.
+			const juce::String typeStr = child->getStringAttribute("type", "linear");
+			eMLParamSmoothing type = kMLParamSmoothNone;
+			if (typeStr == "linear")
+			{
+				type = kMLParamSmoothLinear;
+			}
+			else if (typeStr == "onepole")
+			{
+				type = kMLParamSmoothOnePole;
+			}
+			p->setSmoothing(type, (MLParamValue)child->getDoubleAttribute("time", 0.02));
+		}
 		else if(child->hasTagName("alsosets"))
 		{
 			addSetterToParam(p, stringToPath(child->getStringAttribute("proc")), 
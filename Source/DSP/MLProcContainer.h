@@ -21,6 +21,7 @@
 #include "JuceHeader.h"
 
 class MLProcRingBuffer;
+class MLCopyThreads;
 
 class MLPublishedInput
 {
@@ -164,6 +165,7 @@ public:
 	virtual void addSetterToParam(MLPublishedParamPtr p, const MLPath & procName, const MLSymbol param) = 0;
 	virtual void setPublishedParam(int index, MLParamValue val) = 0;
 	virtual void routeParam(const MLPath & procAddress, const MLSymbol paramName, MLParamValue val) = 0;
+	virtual void resolveParam(const MLPath & procAddress, const MLSymbol paramName, std::vector<MLParamSetter>& setters) = 0;
 	//	
 	virtual void makeRoot(const MLSymbol name) = 0;
 	virtual bool isRoot() const = 0;
@@ -235,6 +237,16 @@ public:
 	virtual void process(const int samples);
 	virtual err prepareToProcess();
 	
+	// the smallest number of frames that process() can be called with. Any multiple
+	// of this can be processed. Containers that resample need whole input periods 
+	// of their ratio, and this is combined with the needs of their subcontainers.
+	virtual int getFrameGranularity();
+	
+	// process the copies of each multiple container in this one on the given pool,
+	// or on the calling thread if it is 0. Nested multiples stay on their parent's 
+	// thread. Not for use while processing.
+	virtual void setCopyThreads(MLCopyThreads* pThreads);
+	
 	void clear();	// clear buffers, DSP history
 	void clearInput(const int idx);
 	MLProc::err setInput(const int idx, const MLSignal& sig);
@@ -286,6 +298,10 @@ public:
 	virtual void setPublishedParam(int index, MLParamValue val);
 	virtual void routeParam(const MLPath & procAddress, const MLSymbol paramName, MLParamValue val);
 	
+	// append the setters for the param at procAddress, relative to this container.
+	// this follows the same path as routeParam() but stops short of setting anything.
+	virtual void resolveParam(const MLPath & procAddress, const MLSymbol paramName, std::vector<MLParamSetter>& setters);
+	
 	// return ptr to name where stored in map.
 	MLSymbol getTargetPropertyName(int index);
 	MLPublishedParamPtr getParamPtr(int index);
@@ -313,6 +329,13 @@ public:
 protected:
 	virtual err buildProc(juce::XmlElement* parent);
 	
+	// set the procs at the addresses of published param index to val, without 
+	// changing the value stored in the published param. 
+	void sendPublishedParam(int index, MLParamValue val);
+	
+	// send a ramp for the next vector to the procs at the addresses of published param index.
+	void sendPublishedParamRamp(int index, const MLParamRamp& ramp);
+	
 	// count number of param elements in document.
 	// this is used to return param info to host before graph is built. 
 	int countPublishedParamsInDoc(juce::XmlElement* pElem);	
@@ -328,6 +351,9 @@ private:
 	// private doc building mathods
 	void setPublishedParamAttrs(MLPublishedParamPtr p, juce::XmlElement* pelem);
 	
+	// resolve the addresses of all published params into mParamSetters.
+	void buildParamSetters();
+	
 	// dump all MLProc subclasses registered at static init time
 	void printClassRegistry(void){ theProcFactory.printRegistry(); }
 
@@ -350,6 +376,12 @@ protected:
 	MLPublishedParamMapT mPublishedParamMap;
 	// vector of published params, for speedy access by integer	
 	std::vector<MLPublishedParamPtr> mPublishedParams;	
+	
+	// setters for all published params, made by compile(). The setters for 
+	// param i are [mParamSetterStarts[i], mParamSetterStarts[i + 1]). If params
+	// are published after compile(), this is empty and routeParam() is used.
+	std::vector<MLParamSetter> mParamSetters;
+	std::vector<int> mParamSetterStarts;
 			
 	// map to published inputs by name
 	MLPublishedInputMapT mPublishedInputMap;	
@@ -0,0 +1,105 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLConvolver.h"
+
+// ----------------------------------------------------------------
+// class definition
+
+// convolution with an impulse response from the shared MLImpulseBank, with no latency.
+// impulse: index of the impulse in the bank.
+// length: the longest impulse in seconds that can be used. Longer impulses are truncated.
+
+class MLProcConvolve : public MLProc
+{
+public:
+	 MLProcConvolve();
+	~MLProcConvolve();
+
+	err resize();
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcConvolve> mInfo;
+	void doParams();
+
+	MLConvolver mConvolver;
+	MLSignal mConstantInput;
+	int mImpulseIndex;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcConvolve> classReg("convolve");
+	ML_UNUSED MLProcParam<MLProcConvolve> params[] = { "impulse", "length" };
+	ML_UNUSED MLProcInput<MLProcConvolve> inputs[] = { "in" };
+	ML_UNUSED MLProcOutput<MLProcConvolve> outputs[] = { "out" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcConvolve::MLProcConvolve() :
+	mImpulseIndex(0)
+{
+	setParam("impulse", 0);
+	setParam("length", 4.f);
+}
+
+MLProcConvolve::~MLProcConvolve()
+{
+}
+
+MLProc::err MLProcConvolve::resize()
+{
+	MLProc::err e = OK;
+	const float sr = getContextSampleRate();
+	if (!mConvolver.resize((int)(getParam("length") * sr)))
+	{
+		e = memErr;
+	}
+	if (!mConstantInput.setDims(getContextVectorSize()))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcConvolve::clear()
+{
+	mConvolver.clear();
+}
+
+void MLProcConvolve::doParams()
+{
+	static const MLSymbol impulseSym("impulse");
+	mImpulseIndex = (int)getParam(impulseSym);
+	mParamsChanged = false;
+}
+
+void MLProcConvolve::process(const int frames)
+{
+	const MLSignal& x = getInput(1);
+	MLSignal& y = getOutput();
+
+	if (mParamsChanged) doParams();
+
+	// the bank may have a new impulse at our index, so check every time.
+	mConvolver.setKernel(MLImpulseBank::theBank().getKernel(mImpulseIndex));
+
+	const MLSample* px = x.getConstBuffer();
+	if (x.isConstant())
+	{
+		mConstantInput.fill(x[0]);
+		px = mConstantInput.getConstBuffer();
+	}
+	mConvolver.process(px, y.getBuffer(), frames);
+	y.setConstant(false);
+}
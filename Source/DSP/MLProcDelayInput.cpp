@@ -39,12 +39,7 @@ MLProc::err MLProcDelayInput::resize()
 {	
 	MLProc::err e = OK;
 	const float sr = getContextSampleRate();
-	int lenBits = bitsToContain((int)(getParam("length") * sr));
-	int length = 1 << lenBits;
-	mLengthMask = length - 1;
-	
-	MLSample* pBuf = mBuffer.setDims(length);
-	if (!pBuf)
+	if (!mBuffer.resize((int)(getParam("length") * sr)))
 	{
 		e = memErr;
 	}
@@ -55,7 +50,6 @@ MLProc::err MLProcDelayInput::resize()
 void MLProcDelayInput::clear() 
 {	
 	mBuffer.clear();
-	mWriteIndex = 0;
 }
 
 void MLProcDelayInput::process(const int frames)
@@ -63,11 +57,6 @@ void MLProcDelayInput::process(const int frames)
 	const MLSignal& x = getInput(1);
 	
 	// write input to delay line
-	for (int n=0; n<frames; ++n)
-	{
-		mWriteIndex &= mLengthMask;
-		mBuffer[mWriteIndex] = x[n];
-		mWriteIndex++;
-	}		
+	mBuffer.write(x, frames);
 }
 
@@ -7,6 +7,7 @@
 #define ML_PROC_DELAY_INPUT_H
 
 #include "MLProc.h"
+#include "MLDSPUtils.h"
 #include "pa_ringbuffer.h"
 #include <vector>
 
@@ -26,11 +27,9 @@ public:
 	
 	int read(MLSample* pOut, int samples);
 	int readToOutputSignal(const int samples);
-	MLSignal& getBuffer() {return mBuffer;}
+	MLDelayBuffer& getBuffer() {return mBuffer;}
 	
-	MLSignal mBuffer;
-	uintptr_t mWriteIndex;
-	uintptr_t mLengthMask;
+	MLDelayBuffer mBuffer;
 
 	MLProcInfoBase& procInfo() { return mInfo; }
 private:
@@ -29,8 +29,10 @@ private:
 	MLProcDelayInput* mpDelayInputProc;
 	uintptr_t mReadIndex;
 	int mVectorDelay;
-	uintptr_t mLengthMask;
-
+	int mInterpolation;
+	float mMinDelay;
+	MLSignal mDelays;
+	MLDelayBuffer::AllpassState mAllpassState;
 };
 
 
@@ -42,7 +44,8 @@ namespace
 	MLProcRegistryEntry<MLProcDelayOutput> classReg("delay_output");
 	
 	// backwards param can be calculated by compiler TODO
-	ML_UNUSED MLProcParam<MLProcDelayOutput> params[] = {"order", "backwards"};	
+	// interpolation: 0 = none, 1 = linear, 2 = allpass, 3 = hermite, 4 = windowed sinc
+	ML_UNUSED MLProcParam<MLProcDelayOutput> params[] = {"order", "backwards", "interpolation"};	
 	ML_UNUSED MLProcInput<MLProcDelayOutput> inputs[] = {"delay_time"}; 
 	ML_UNUSED MLProcOutput<MLProcDelayOutput> outputs[] = {"out"};
 }
@@ -54,9 +57,12 @@ MLProcDelayOutput::MLProcDelayOutput()
 {
 	setParam("order", 0);
 	setParam("backwards", 0);
+	setParam("interpolation", 0);
 	mpDelayInputProc = 0;
 	mReadIndex = 0;
-	mLengthMask = 0;
+	mVectorDelay = 0;
+	mInterpolation = kMLDelayInterpNone;
+	mMinDelay = 0.f;
 }
 
 MLProcDelayOutput::~MLProcDelayOutput()
@@ -65,13 +71,17 @@ MLProcDelayOutput::~MLProcDelayOutput()
 
 void MLProcDelayOutput::clear() 
 {	
-//	mBuffer.clear();
 	mReadIndex = 0;
+	mAllpassState.clear();
 }
 
 MLProc::err MLProcDelayOutput::resize() 
 {
 	err e = OK;
+	if (!mDelays.setDims(getContextVectorSize()))
+	{
+		e = memErr;
+	}
 	doParams();
 	return e;
 }
@@ -95,15 +105,6 @@ void MLProcDelayOutput::doParams()
 	{
 //debug() << "MLProcDelayOutput " << getName() << " doParams found delay proc " << delayName << "!\n";
 		mpDelayInputProc = static_cast<MLProcDelayInput*>(&(*myInputProc));
-		
-		if(mpDelayInputProc)
-		{
-			// must be power of two size
-			MLSignal& buffer = mpDelayInputProc->getBuffer();
-			mLengthMask = buffer.getWidth() - 1;
-			
-//debug() << "MLProcDelayOutput::doParams found buffer, length mask " << std::hex << mLengthMask << std::dec << "\n";
-		}
 	}
 	else
 	{
@@ -119,6 +120,10 @@ void MLProcDelayOutput::doParams()
 		mVectorDelay = 0;
 	}
 //debug() << "MLProcDelayOutput: vector delay " << 	mVectorDelay << "\n";
+
+	mInterpolation = clamp((int)getParam("interpolation"), (int)kMLDelayInterpNone, (int)kMLDelayInterpSinc);
+	mMinDelay = mVectorDelay + MLDelayBuffer::getMinimumDelay(mInterpolation);
+	mAllpassState.clear();
 		
 	mParamsChanged = false;
 }
@@ -128,60 +133,42 @@ void MLProcDelayOutput::process(const int frames)
 {
 	const MLSignal& delayTime = getInput(1);
 	MLSignal& y = getOutput();
-
-	int delayInt;
 	const float sr = getContextSampleRate();
-	MLSample delay;
-	
-	int delayedIndex;
 
 	if (mParamsChanged) doParams();
 	
 	if(mpDelayInputProc)
 	{
-		MLSignal& buffer = mpDelayInputProc->getBuffer();
+		const MLDelayBuffer& buffer = mpDelayInputProc->getBuffer();
+		y.setConstant(false);
+		
+		// get delay time in samples.  
+		// if no signal is attached, 0. should result 
+		// and we get the minimum delay.
 		if (delayTime.isConstant())
 		{
-			delay = delayTime[0] * sr - mVectorDelay;
-			if (delay < mVectorDelay) delay = mVectorDelay;
-			delayInt = (int)(delay);
-			
-			for (int n=0; n<frames; ++n)
-			{
-				delayedIndex = mReadIndex - delayInt;
-				delayedIndex &= mLengthMask;
-				y[n] = buffer[delayedIndex];
-				mReadIndex++;
-			}
+			MLSample delay = max(delayTime[0] * sr - mVectorDelay, mMinDelay);
+			buffer.readConstant(y.getBuffer(), frames, mReadIndex, delay, mInterpolation, mAllpassState);
 		}
 		else
 		{
-			for (int n=0; n<frames; ++n)
-			{		
-				// read
-				// zero order (integer delay)
-				
-				// get delay time.  
-				// if no signal is attached, 0. should result 
-				// and we get a single-vector delay.
-				delay = delayTime[n] * sr - mVectorDelay;
-				if (delay < mVectorDelay) delay = mVectorDelay;
-				
-				delayInt = (int)(delay);
-				
-				delayedIndex = mReadIndex - delayInt;
-				delayedIndex &= mLengthMask;
-				y[n] = buffer[delayedIndex];
-				mReadIndex++;
+			const MLSample* pt = delayTime.getConstBuffer();
+			MLSample* pd = mDelays.getBuffer();
+			const __m128 vSr = _mm_set1_ps(sr);
+			const __m128 vOffset = _mm_set1_ps((float)mVectorDelay);
+			const __m128 vMin = _mm_set1_ps(mMinDelay);
+			int n = 0;
+			for (; n + 3 < frames; n += kSSEVecSize)
+			{
+				__m128 d = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(pt + n), vSr), vOffset);
+				_mm_storeu_ps(pd + n, _mm_max_ps(d, vMin));
 			}
+			for (; n < frames; ++n)
+			{
+				pd[n] = max(pt[n] * sr - mVectorDelay, mMinDelay);
+			}
+			buffer.readModulated(y.getBuffer(), frames, mReadIndex, pd, mInterpolation, mAllpassState);
 		}
+		mReadIndex += frames;
 	}
-
-	// linear interp:
-	//y[n] = frac*x[m+1] + (1-frac)*x[m]
-	
-	// allpass interp:
-	// y[n] = x[m+1] + (1-frac)*x[m] - (1-frac)*y[n-1] 
-	
 }
-	   
\ No newline at end of file
@@ -65,7 +65,7 @@ void MLProcDivide::process(const int frames)
 	const MLSample* px2 = x2.getConstBuffer();
 	MLSample* py1 = y1.getBuffer();
 	
-	int c = frames >> kMLSamplesPerSSEVectorBits;
+	int c = SSEVectorsToCover(frames);
 	__m128 vx1, vx2, vr; 	
 
 	switch(mode)
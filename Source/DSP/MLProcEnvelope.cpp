@@ -21,6 +21,8 @@ public:
 private:
 	MLProcInfo<MLProcEnvelope> mInfo;
 	void calcCoeffs(void);
+	void calcSegmentCoeffs(float delay, float attack, float decay, float sustain, float release, float repeat, float invSr);
+	bool canHold(const MLSignal& gate, const MLSignal& sustain, const MLSignal& repeat, const int samples);
 		
 	MLSample mEnvThresh;	// coeffs
 	MLSample mDelayCounter, mDelayCounterStep, mDelayStep;
@@ -67,6 +69,38 @@ void MLProcEnvelope::calcCoeffs(void)
 	mParamsChanged = false;
 }
 
+// get step sizes for each segment from the time inputs.
+void MLProcEnvelope::calcSegmentCoeffs(float delay, float attack, float decay, float sustain, float release, float repeat, float invSr)
+{
+	float attackIn = clamp(attack - 0.0001f, 0.f, 20.f);
+	mSustain = sustain;
+	mDelayStep = invSr / max(delay, kMinSegTime); 
+	mRepeatStep = (repeat == 0.f) ? 0.f : invSr / max(repeat, kMinSegTime);
+	mCAttack =  kMLTwoPi * invSr / max(attackIn, kMinSegTime);
+	mCDecay = kMLTwoPi * invSr / max(decay, kMinSegTime);
+	mCRelease = kMLTwoPi * invSr / max(release, kMinSegTime);
+}
+
+// return true if the envelope is idle or sustaining and nothing can happen in the
+// next block: the gate is constant on the same side of the threshold, and no
+// delay or repeat counter can finish.
+bool MLProcEnvelope::canHold(const MLSignal& gate, const MLSignal& sustain, const MLSignal& repeat, const int samples)
+{
+	const float inputThresh = 0.001f;
+	if ((mState != stateOff) && (mState != stateSustain)) return false;
+	if (mpEnvCoeff != &mCNull) return false;
+	if (mDelayCounterStep != 0.f) return false;
+	if (!gate.isConstant()) return false;
+	if ((gate[0] > inputThresh) != (mGate1 > inputThresh)) return false;
+	if (!repeat.isConstant()) return false;
+	if (mRepeatStep > 0.f)
+	{
+		if (!sustain.isConstant()) return false;
+		if ((mSustain < 0.05f) && (mRepeatCounter + mRepeatStep*samples > 1.0f)) return false;
+	}
+	return true;
+}
+
 void MLProcEnvelope::clear()
 {
 	// debug() << "MLProcEnvelope::clear()\n";
@@ -101,28 +135,30 @@ void MLProcEnvelope::process(const int samples)
 	// input change thresholds for state changes
 	const float inputThresh = 0.001f;
 
+	// get coefficients once per vector if all the time inputs are constant.
+	const bool constantTimes = delay.isConstant() && attack.isConstant() && decay.isConstant() 
+		&& sustain.isConstant() && release.isConstant() && repeat.isConstant();
+	calcSegmentCoeffs(delay[0], attack[0], decay[0], sustain[0], release[0], repeat[0], invSr);
+
+	// when idle or sustaining with nothing to change, output a constant.
+	if (canHold(gate, sustain, repeat, samples))
+	{
+		mRepeatCounter += mRepeatStep*samples;
+		mGate1 = gate[0];
+		mY1 = mEnv;
+		y.setToConstant(mEnv * mMult * 2.f);
+		return;
+	}
+
 	for (int n=0; n<samples; ++n)
 	{
         float bias = 0.05f;
         float dxdt, gIn, velIn;
         bool upTrig, downTrig, crossedThresh, delayCounterDone, doRepeat;
         
-        // TEMP
-        float attackIn = attack[n] - 0.0001f;
-        attackIn = clamp(attackIn, 0.f, 20.f);
-		
-		// TODO make constant coefficient vectors for constant input parameter signals.
-		// TODO mark/write output signal as constant when we know it is.		
-		// get step sizes(divide approx. will be just fine)
-		// SSE here works on a single instance
+		if (!constantTimes)
 		{
-			mSustain = sustain[n];
-			mDelayStep = invSr / max(delay[n], kMinSegTime); 
-			mRepeatStep = (repeat[n] == 0.f) ? 0.f : invSr / max(repeat[n], kMinSegTime);
-			mCAttack =  kMLTwoPi * invSr / max(attackIn, kMinSegTime);
-			mCDecay = kMLTwoPi * invSr / max(decay[n], kMinSegTime);
-//			mCSustain = kMLTwoPi * invSr / ();
-			mCRelease = kMLTwoPi * invSr / max(release[n], kMinSegTime);
+			calcSegmentCoeffs(delay[n], attack[n], decay[n], sustain[n], release[n], repeat[n], invSr);
 		}
 		
 		// process gate input
@@ -226,6 +262,7 @@ void MLProcEnvelope::process(const int samples)
 		mEnv = clamp(mEnv, 0.f, 1.f); // could be avoided by careful attention to overshoots > 1 and < 0		
 		y[n] = mEnv * mMult * 2.f;
 	}
+	y.setConstant(false);
 	
 	/*
 	mT += samples;
@@ -49,7 +49,7 @@ MLProcExp2::~MLProcExp2()
 }
 
 // calculate 2^n for each input sample.
-// 
+// precise: if on, use the precise tier of the vector math functions, otherwise the fast tier.
 void MLProcExp2::process(const int frames)
 {
 	static const MLSymbol preciseSym("precise");
@@ -68,31 +68,7 @@ void MLProcExp2::process(const int frames)
 	}
 	else
 	{		
-		if(mPrecise) // scalar code
-		{
-			for (int n=0; n<frames; ++n)
-			{
-				y1[n] = pow(2.f, x1[n]);
-			}
-		}
-		else 
-		{
-			y1.setConstant(false);
-			const MLSample* px1 = x1.getConstBuffer();
-			MLSample* py1 = y1.getBuffer();
-				
-			int c = frames >> kMLSamplesPerSSEVectorBits;
-			__m128 vx1, vr; 	
-			
-			for (int n = 0; n < c; ++n)
-			{
-				vx1 = _mm_load_ps(px1);		
-				vr = exp2Approx4(vx1);
-				_mm_store_ps(py1, vr);
-				px1 += kSSEVecSize;
-				py1 += kSSEVecSize;
-			}
-		}
+		MLExp2(x1.getConstBuffer(), y1.getBuffer(), frames, mPrecise ? kMLMathPrecise : kMLMathFast);
+		y1.setConstant(false);
 	}
 }
-
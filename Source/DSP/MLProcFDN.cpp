@@ -0,0 +1,114 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLDSPUtils.h"
+
+// ----------------------------------------------------------------
+// class definition
+
+// a feedback delay network reverb using MLFDN.
+// lines: 4, 8 or 16. read only when the proc is resized.
+// matrix: 0 = Householder, 1 = Hadamard.
+// size: length of the longest delay line in seconds. Each following line is
+// shorter by the ratio freq_mul.
+// decay: time in seconds for the reverb to fall by 60 dB.
+// lopass: cutoff of the damping filter in each line, in Hz.
+
+class MLProcFDN : public MLProc
+{
+public:
+	 MLProcFDN();
+	~MLProcFDN();
+
+	err resize();
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcFDN> mInfo;
+	void calcCoeffs();
+
+	MLFDN mFDN;
+	MLSignal mConstantInput;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcFDN> classReg("fdn");
+	ML_UNUSED MLProcParam<MLProcFDN> params[] = { "lines", "matrix", "size", "freq_mul", "decay", "lopass" };
+	ML_UNUSED MLProcInput<MLProcFDN> inputs[] = { "in" };
+	ML_UNUSED MLProcOutput<MLProcFDN> outputs[] = { "out" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcFDN::MLProcFDN()
+{
+	setParam("lines", 8);
+	setParam("matrix", kMLFDNHouseholder);
+	setParam("size", 0.1f);
+	setParam("freq_mul", 0.925f);
+	setParam("decay", 2.f);
+	setParam("lopass", 8000.f);
+}
+
+MLProcFDN::~MLProcFDN()
+{
+}
+
+MLProc::err MLProcFDN::resize()
+{
+	MLProc::err e = OK;
+	mFDN.setSampleRate((int)getContextSampleRate());
+	mFDN.resize((int)getParam("lines"));
+	if (!mConstantInput.setDims(getContextVectorSize()))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcFDN::clear()
+{
+	mFDN.clear();
+}
+
+void MLProcFDN::calcCoeffs()
+{
+	static const MLSymbol matrixSym("matrix");
+	static const MLSymbol sizeSym("size");
+	static const MLSymbol freqMulSym("freq_mul");
+	static const MLSymbol decaySym("decay");
+	static const MLSymbol lopassSym("lopass");
+
+	mFDN.setMatrix((int)getParam(matrixSym));
+	mFDN.setFreqMul(getParam(freqMulSym));
+	mFDN.setDelayLengths(getParam(sizeSym));
+	mFDN.setDecayTime(max(getParam(decaySym), 0.01f));
+	mFDN.setLopass(clamp(getParam(lopassSym), 10.f, getContextSampleRate()*0.45f));
+	mParamsChanged = false;
+}
+
+void MLProcFDN::process(const int frames)
+{
+	const MLSignal& x = getInput(1);
+	MLSignal& y = getOutput();
+
+	if (mParamsChanged) calcCoeffs();
+
+	const MLSample* px = x.getConstBuffer();
+	if (x.isConstant())
+	{
+		mConstantInput.fill(x[0]);
+		px = mConstantInput.getConstBuffer();
+	}
+	mFDN.processBlock(px, y.getBuffer(), frames);
+	y.setConstant(false);
+}
@@ -44,19 +44,51 @@ MLProcFMBandwidth::~MLProcFMBandwidth()
 {
 }
 
+// estimate the bandwidth of an FM signal with carrier c, modulator m and index i
+// as c + m*(i + log(i + 1)), with the fast log2 from MLDSP.h.
+static inline __m128 fmBandwidth4(const __m128 vc, const __m128 vm, const __m128 vi)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 minArg = _mm_set1_ps(1e-20f);
+	const __m128 ln2 = _mm_set1_ps(0.693147181f);
+	const __m128 vLog = _mm_mul_ps(log2Approx4(_mm_max_ps(_mm_add_ps(vi, one), minArg)), ln2);
+	return _mm_add_ps(vc, _mm_mul_ps(vm, _mm_add_ps(vi, vLog)));
+}
+
+// every sample, including constant inputs, is computed by fmBandwidth4() so that
+// the output does not depend on the position of a sample in the vector.
+//
+// this uses the original formula. Earlier versions used the approximation 
+// c + m*(i + sqrt(i/2)/2), so patches made with them will sound slightly different.
 void MLProcFMBandwidth::process(const int frames)
 {
 	const MLSignal& c = getInput(1);
 	const MLSignal& m = getInput(2);
 	const MLSignal& i = getInput(3);
 	MLSignal& out = getOutput();
+	const bool kc = c.isConstant();
+	const bool km = m.isConstant();
+	const bool ki = i.isConstant();
 	
-	for (int n=0; n<frames; ++n)
+	if (kc && km && ki)
 	{
-        float fc = c[n];
-        float fm = m[n];
-        float fi = i[n];
-//		out[n] = c[n] + m[n]*(i[n] + log(i[n] + 1)); // original formula
-		out[n] = fc + fm*(fi + sqrtf(fi*0.5f)*0.5f); // approximation
+		float r[kSSEVecSize];
+		_mm_storeu_ps(r, fmBandwidth4(_mm_set1_ps(c[0]), _mm_set1_ps(m[0]), _mm_set1_ps(i[0])));
+		out.setToConstant(r[0]);
+		return;
 	}
-}
\ No newline at end of file
+	
+	const MLSample* pc = c.getConstBuffer();
+	const MLSample* pm = m.getConstBuffer();
+	const MLSample* pi = i.getConstBuffer();
+	MLSample* py = out.getBuffer();
+	const int vFrames = SSEVectorsToCover(frames)*kSSEVecSize;
+	for (int n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 vc = kc ? _mm_set1_ps(c[0]) : _mm_load_ps(pc + n);
+		const __m128 vm = km ? _mm_set1_ps(m[0]) : _mm_load_ps(pm + n);
+		const __m128 vi = ki ? _mm_set1_ps(i[0]) : _mm_load_ps(pi + n);
+		_mm_store_ps(py + n, fmBandwidth4(vc, vm, vi));
+	}
+	out.setConstant(false);
+}
@@ -4,7 +4,13 @@
 
 #include "MLProcInputToSignals.h"
 
-const int kMaxEvents = 32;
+// MIDI channels and keys are packed into one index for finding the voices playing a note.
+const int kNoteKeyNotes = 128;
+
+// MPE timbre controller, and the glide time that smooths high-rate MPE expression.
+const int kMPETimbreController = 74;
+const float kMPEGlideTime = 0.002f;
+
 const int kNumVoiceSignals = 9;
 const char * voiceSignalNames[kNumVoiceSignals] = 
 {
@@ -77,7 +83,11 @@ void MLVoice::clearState()
     mInstigatorID = 0;
     mChannel = 0;
 	mNote = 0.;
-    mAge = 0;
+	mState = -1;
+	mPrevVoice = -1;
+	mNextVoice = -1;
+	mKey = -1;
+	mNextKeyVoice = -1;
 	mStartX = 0.;
 	mStartY = 0.;
 	mPitch = 0.;
@@ -124,7 +134,7 @@ void MLVoice::zero()
 namespace
 {
 	MLProcRegistryEntry<MLProcInputToSignals> classReg("midi_to_signals");
-	ML_UNUSED MLProcParam<MLProcInputToSignals> params[8] = { "bufsize", "voices", "bend", "mod", "unison", "glide", "protocol", "data_rate" };
+	ML_UNUSED MLProcParam<MLProcInputToSignals> params[11] = { "bufsize", "voices", "max_voices", "bend", "mod", "unison", "glide", "protocol", "data_rate", "frame_interp", "mpe_bend" };
 	// no input signals.
 	ML_UNUSED MLProcOutput<MLProcInputToSignals> outputs[] = {"*"};	// variable outputs
 }	
@@ -136,19 +146,28 @@ MLProcInputToSignals::MLProcInputToSignals() :
 	mCurrentVoices(0),
 	mUnisonInputTouch(-1),
 	mSustain(false),
-    mFrameCounter(0)
+    mFrameCounter(0),
+	mPendingStart(0),
+	mPendingCount(0),
+	mSampleCounter(0.),
+	mFrameClockOffset(0.),
+	mFrameClockValid(false),
+	mFrameLatency(0),
+	mFrameInterp(true)
 {
 //	debug() << "MLProcInputToSignals constructor:\n";
       
 	setParam("voices", 0);	// default
+	setParam("max_voices", kMLEngineDefaultVoices);	// default
 	setParam("protocol", kInputProtocolMIDI);	// default
 	setParam("data_rate", 100);	// default
+	setParam("frame_interp", 1);	// default
+	setParam("mpe_bend", 48);	// default
 	
-	mVoiceRotateOffset = 0;
-	mNextEventIdx = 0;
     mEventTimeOffset = 0;
     
 	mPitchWheelSemitones = 7.f;
+	mMPEBendSemitones = 48.f;
 	mUnisonMode = false;
 	mRotateMode = true;
 	mEventCounter = 0;
@@ -157,8 +176,9 @@ MLProcInputToSignals::MLProcInputToSignals() :
 	temp = 0;
 	mOSCDataRate = 100;
     
-    mNoteEventsPlaying.resize(kMaxEvents);
-    mNoteEventsPending.resize(kMaxEvents);
+	mKeyVoices.resize(kMIDIChannels*kNoteKeyNotes);
+	resetVoiceLists();
+	mPendingFrames.resize(kFrameBufferSize);
 }
 
 MLProcInputToSignals::~MLProcInputToSignals()
@@ -176,10 +196,12 @@ void MLProcInputToSignals::setInputFrameBuffer(PaUtilRingBuffer* pBuf)
 void MLProcInputToSignals::clearChangeLists()
 {
 	// things per voice
-	for (int v=0; v<kMLEngineMaxVoices; ++v)
+	const int voices = (int)mVoices.size();
+	for (int v=0; v<voices; ++v)
 	{
 		mVoices[v].clearChanges();
 	}
+	mMasterPitchBend.clearChanges();
 }
 
 // set up output buffers
@@ -191,11 +213,16 @@ MLProc::err MLProcInputToSignals::resize()
 	//
 	int bufSize = (int)getParam("bufsize");
 	int vecSize = getContextVectorSize();
+	// make the most voices the graph was built for, so "voices" can change freely up to that.
+	const int voices = clamp((int)getParam("max_voices"), 0, kMLEngineMaxVoices);
+	mVoices.resize(voices);
     
+	// change lists are cleared after each vector, so they need room for at most one
+	// change per sample of a vector.
 	MLProc::err r;
-	for(int i=0; i<kMLEngineMaxVoices; ++i)
+	for(int i=0; i<voices; ++i)
 	{
-		r = mVoices[i].resize(bufSize);
+		r = mVoices[i].resize(vecSize);
 		if (!(r == OK))
         {
             MLError() << "MLProcInputToSignals: resize error!\n";
@@ -206,15 +233,18 @@ MLProc::err MLProcInputToSignals::resize()
 	// make signals that apply to all voices
 	mTempSignal.setDims(vecSize);
 	mChannelAfterTouchSignal.setDims(vecSize);
-	
-	if (!mLatestFrame.setDims(kFrameWidth, kFrameHeight))
+	mMasterBendSignal.setDims(vecSize);
+	if (mMasterPitchBend.setDims(vecSize) != OK)
 	{
-		return MLProc::memErr;
+		re = memErr;
 	}
+	
+	// timed touch frames are played one host buffer after they are received.
+	mFrameLatency = bufSize;
    	
 	// make outputs
 	//
-	for(int i=1; i <= kMLEngineMaxVoices * kNumVoiceSignals; ++i)
+	for(int i=1; i <= voices * kNumVoiceSignals; ++i)
 	{
 		if (!outputIsValid(i))
 		{
@@ -224,7 +254,7 @@ MLProc::err MLProcInputToSignals::resize()
 
 	// do voice params
 	//
-	for(int i=0; i<kMLEngineMaxVoices; ++i)
+	for(int i=0; i<voices; ++i)
 	{
         if((i*kNumVoiceSignals + 1) < getNumOutputs())
         {
@@ -238,6 +268,9 @@ MLProc::err MLProcInputToSignals::resize()
 	}
 
 	clearChangeLists();
+	
+	// count the voices again in doParams().
+	mParamsChanged = true;
 	return re;
 }
 
@@ -274,7 +307,8 @@ int MLProcInputToSignals::getOutputIndex(const MLSymbol name)
 	
 	if (sig && voice)
 	{
-		if (voice <= mCurrentVoices)
+		// voices are made later in resize(), so check the param here.
+		if (voice <= clamp((int)getParam("max_voices"), 0, kMLEngineMaxVoices))
 		{
 			idx = (voice - 1)*kNumVoiceSignals + sig;
 		}
@@ -296,10 +330,12 @@ void MLProcInputToSignals::setup()
 
 void MLProcInputToSignals::doParams()
 {
-	int newVoices = (int)getParam("voices");
+	const int voices = (int)mVoices.size();
+	int newVoices = clamp((int)getParam("voices"), 0, voices);
     
     // TODO enable / disable voice containers here
 	mOSCDataRate = (int)getParam("data_rate");
+	mFrameInterp = (getParam("frame_interp") != 0.f);
 
 	int newProtocol = (int)getParam("protocol");	
 	if (newProtocol != mProtocol)
@@ -310,28 +346,45 @@ void MLProcInputToSignals::doParams()
 	switch(mProtocol)
 	{
 		case kInputProtocolOSC:	
-			for(int i=0; i<kMLEngineMaxVoices; ++i)
+		{
+			// with interpolation, each frame glides to its values over one frame period,
+			// arriving as the next frame starts. Otherwise values step at each frame.
+			const float frameGlide = mFrameInterp ? 1.f / (float)mOSCDataRate : 0.f;
+			for(int i=0; i<voices; ++i)
 			{				
 				// TODO fix names, amp and vel are really switched. 
 				// amp snaps to new velocity right away 
 				mVoices[i].mdGate.setGlideTime(0.0f);
 				mVoices[i].mdAmp.setGlideTime(0.0f);
-				mVoices[i].mdVel.setGlideTime(1.f / (float)mOSCDataRate);
-				mVoices[i].mdNotePressure.setGlideTime(1.f / (float)mOSCDataRate);
-				mVoices[i].mdChannelPressure.setGlideTime(1.f / (float)mOSCDataRate);
-				mVoices[i].mdMod.setGlideTime(1.f / (float)mOSCDataRate);
-				mVoices[i].mdMod2.setGlideTime(1.f / (float)mOSCDataRate);
-				mVoices[i].mdMod3.setGlideTime(1.f / (float)mOSCDataRate);
+				mVoices[i].mdVel.setGlideTime(frameGlide);
+				mVoices[i].mdNotePressure.setGlideTime(frameGlide);
+				mVoices[i].mdChannelPressure.setGlideTime(frameGlide);
+				mVoices[i].mdMod.setGlideTime(frameGlide);
+				mVoices[i].mdMod2.setGlideTime(frameGlide);
+				mVoices[i].mdMod3.setGlideTime(frameGlide);
 			}
-
 			break;
+		}
 		case kInputProtocolMIDI:	
-			for(int i=0; i<kMLEngineMaxVoices; ++i)
+			for(int i=0; i<voices; ++i)
 			{
 				mVoices[i].mdGate.setGlideTime(0.0f);
 				mVoices[i].mdAmp.setGlideTime(0.0f);
 			}
 			break;
+		case kInputProtocolMPE:	
+			for(int i=0; i<voices; ++i)
+			{
+				mVoices[i].mdGate.setGlideTime(0.0f);
+				mVoices[i].mdAmp.setGlideTime(0.0f);
+				mVoices[i].mdNotePressure.setGlideTime(kMPEGlideTime);
+				mVoices[i].mdChannelPressure.setGlideTime(kMPEGlideTime);
+				mVoices[i].mdMod.setGlideTime(kMPEGlideTime);
+				mVoices[i].mdMod2.setGlideTime(kMPEGlideTime);
+				mVoices[i].mdMod3.setGlideTime(kMPEGlideTime);
+			}
+			mMasterPitchBend.setGlideTime(kMPEGlideTime);
+			break;
 	}
 	
 	if (newVoices != mCurrentVoices)
@@ -342,6 +395,7 @@ void MLProcInputToSignals::doParams()
 	
 	// pitch wheel mult
 	mPitchWheelSemitones = getParam("bend");
+	mMPEBendSemitones = getParam("mpe_bend");
 	
 	// listen to controller number mod
 	mControllerNumber = (int)getParam("mod");
@@ -353,11 +407,13 @@ void MLProcInputToSignals::doParams()
 		clear();
 	}
 	
+	// per-note bend in MPE is expression, not portamento.
 	mGlide = getParam("glide");
-	for (int v=0; v<kMLEngineMaxVoices; ++v)
+	const float bendGlide = (mProtocol == kInputProtocolMPE) ? kMPEGlideTime : mGlide;
+	for (int v=0; v<voices; ++v)
 	{
 		mVoices[v].mdPitch.setGlideTime(mGlide);
-		mVoices[v].mdPitchBend.setGlideTime(mGlide);
+		mVoices[v].mdPitchBend.setGlideTime(bendGlide);
 	}
 		
 	mParamsChanged = false;
@@ -378,17 +434,12 @@ void MLProcInputToSignals::clear()
 	// debug() << "clearing MLProcInputToSignals: bufsize" << bufSize << ", vecSize " << vecSize << "\n";
 	
     clearChangeLists();
-	
-	for(int i=0; i<kMaxEvents; ++i)
-	{
-		mNoteEventsPlaying[i].clear();
-		mNoteEventsPending[i].clear();
-	}
 
 	int outs = getNumOutputs();
 	if (outs)
 	{
-		for (int v=0; v<kMLEngineMaxVoices; ++v)
+		const int voices = (int)mVoices.size();
+		for (int v=0; v<voices; ++v)
 		{
 			mVoices[v].clearState();
 			mVoices[v].clearChanges();
@@ -409,7 +460,14 @@ void MLProcInputToSignals::clear()
             }
 		}
 	}
+	resetVoiceLists();
+	mMasterPitchBend.zero();
 	mEventCounter = 0;
+	
+	mPendingStart = 0;
+	mPendingCount = 0;
+	mSampleCounter = 0.;
+	mFrameClockValid = false;
 }
 
 // order of signals:
@@ -432,10 +490,9 @@ void MLProcInputToSignals::setEventTimeOffset(int t)
     mEventTimeOffset = t;
 }
 
-void MLProcInputToSignals::setEventRange(MLControlEventVector::const_iterator start, MLControlEventVector::const_iterator end)
+void MLProcInputToSignals::setEvents(const MLControlEventSpan& events)
 {
-    mStartEvent = start;
-    mEndEvent = end;
+    mEvents = events;
 }
 #pragma mark -
 
@@ -451,7 +508,7 @@ void MLProcInputToSignals::process(const int frames)
 	{
 		for (int v=0; v<mCurrentVoices; ++v)
 		{
-			float drift = (kDriftConstants[v] * kDriftConstantsAmount) + (MLRand()*kDriftRandomAmount);
+			float drift = (kDriftConstants[v & 15] * kDriftConstantsAmount) + (MLRand()*kDriftRandomAmount);
 			mVoices[v].mdDrift.addChange(drift, 1);
 		}		
 		mDriftCounter = 0;
@@ -459,32 +516,25 @@ void MLProcInputToSignals::process(const int frames)
 	mDriftCounter += frames;
 #endif
     
-	// update age for each voice
-	for (int v=0; v<mCurrentVoices; ++v)
-	{
-		if(mVoices[v].mAge >= 0)
-		{
-			mVoices[v].mAge += frames;
-		}
-	}		
-
 	switch(mProtocol)
 	{
 		case kInputProtocolOSC:	
 			processOSC(frames);
 			break;
 		case kInputProtocolMIDI:	
-			processEvents();
+		case kInputProtocolMPE:	
+			processEvents(frames);
 			break;
 	}
     
     writeOutputSignals(frames);
     
+	mSampleCounter += frames;
     mFrameCounter += frames;
     if(mFrameCounter > sr)
     {
         mFrameCounter -= sr;
-    //    dumpEvents();
+    //    dumpVoiceLists();
     //    dumpVoices();
     //    dumpSignals();
     }
@@ -496,29 +546,93 @@ void MLProcInputToSignals::process(const int frames)
 
 void MLProcInputToSignals::processOSC(const int frames)
 {	
-	float x, y, z, note;
-	float dx, dy;
-	int avail = 0;
-	int framesRead = 0;
+	readTouchFrames(frames);
 	
-	// TODO this code only updates every signal vector.  Add sample-accurate
-	// reading from OSC.
+	// apply each pending frame that falls in this vector at its sample offset. 
+	// offsets never go backwards, so late frames are played in order as soon as possible.
+	const double vectorEnd = mSampleCounter + frames;
+	int prevTime = 0;
+	while(mPendingCount > 0)
+	{
+		const PendingFrame& p = mPendingFrames[mPendingStart];
+		if(p.sampleTime >= vectorEnd) break;
+		const int time = clamp((int)(p.sampleTime - mSampleCounter), prevTime, frames - 1);
+		processTouchFrame(p.frame, time);
+		prevTime = time;
+		mPendingStart = (mPendingStart + 1) & (kFrameBufferSize - 1);
+		mPendingCount--;
+	}
+}
 
-	// TEMP get most recent frame and apply to whole buffer			
-	// read from mpFrameBuf, which is being filled up by OSC listener thread
-    
-	if(mpFrameBuf)
+// read all available frames from mpFrameBuf, which is being filled up by the OSC 
+// listener thread, and give each a sample time.
+void MLProcInputToSignals::readTouchFrames(const int frames)
+{
+	if(!mpFrameBuf) return;
+	const int avail = (int)PaUtil_GetRingBufferReadAvailable(mpFrameBuf);
+	if(!avail) return;
+	
+	const long elementSize = mpFrameBuf->elementSizeBytes;
+	if((elementSize != sizeof(TouchFrame)) && (elementSize != sizeof(TouchFrame().data)))
 	{
-		avail = PaUtil_GetRingBufferReadAvailable(mpFrameBuf);
-		if (avail) do
+		MLError() << "MLProcInputToSignals: unknown touch frame size " << (int)elementSize << "!\n";
+		PaUtil_AdvanceRingBufferReadIndex(mpFrameBuf, avail);
+		return;
+	}
+	
+	// let the clock offset fall slowly, so that it can follow a listener clock 
+	// that runs slower than ours.
+	static const double kFrameClockDrift = 0.0001;
+	const double sr = getContextSampleRate();
+	mFrameClockOffset -= kFrameClockDrift*frames/sr;
+	
+	for(int i=0; i<avail; ++i)
+	{
+		// if the queue is full, drop the oldest frame.
+		if(mPendingCount == kFrameBufferSize)
+		{
+			mPendingStart = (mPendingStart + 1) & (kFrameBufferSize - 1);
+			mPendingCount--;
+		}
+		PendingFrame& p = mPendingFrames[(mPendingStart + mPendingCount) & (kFrameBufferSize - 1)];
+		mPendingCount++;
+		
+		if(elementSize == sizeof(TouchFrame))
+		{
+			PaUtil_ReadRingBuffer(mpFrameBuf, &p.frame, 1);
+		}
+		else
+		{
+			PaUtil_ReadRingBuffer(mpFrameBuf, p.frame.data, 1);
+			p.frame.time = 0.;
+		}
+		
+		if(p.frame.time > 0.)
+		{
+			// the frame that was read soonest after it was received sets the clock offset.
+			const double offset = p.frame.time - mSampleCounter/sr;
+			if(!mFrameClockValid || (offset > mFrameClockOffset))
+			{
+				mFrameClockOffset = offset;
+				mFrameClockValid = true;
+			}
+			p.sampleTime = (p.frame.time - mFrameClockOffset)*sr + mFrameLatency;
+		}
+		else
 		{
-			framesRead = PaUtil_ReadRingBuffer(mpFrameBuf, mLatestFrame.getBuffer(), 1);
-			avail = PaUtil_GetRingBufferReadAvailable(mpFrameBuf);
+			// spread untimed frames evenly over this vector.
+			p.sampleTime = mSampleCounter + (double)(i*frames)/(double)avail;
 		}
-		while (avail > 0);	
 	}
+}
 
-	// First turn touch frames into change lists, either in unison mode or not.
+void MLProcInputToSignals::processTouchFrame(const TouchFrame& f, const int time)
+{
+	float x, y, z, note;
+	float dx, dy;
+	const int touches = min(mCurrentVoices, (int)kFrameHeight);
+	
+	// turn the frame into changes at time, either in unison mode or not.
 	if (mUnisonMode)
 	{		
 		// unison mode:
@@ -533,12 +647,12 @@ void MLProcInputToSignals::processOSC(const int frames)
 		float udx = 0.;
 		float udy = 0.;
 		
-		for (int v=0; v<mCurrentVoices; ++v)
+		for (int v=0; v<touches; ++v)
 		{			
-			x = mLatestFrame(0, v);
-			y = mLatestFrame(1, v);
-			z = mLatestFrame(2, v);
-			note = mLatestFrame(3, v);
+			x = f.data[v][0];
+			y = f.data[v][1];
+			z = f.data[v][2];
+			note = f.data[v][3];
 
 			if (z > 0.f)
 			{
@@ -559,7 +673,7 @@ void MLProcInputToSignals::processOSC(const int frames)
 		// update unison input touch.
 		if(mUnisonInputTouch >= 0)
 		{
-			uz = mLatestFrame(2, mUnisonInputTouch);
+			uz = f.data[mUnisonInputTouch][2];
 			
 			// if touch is removed, fall back to touch with maximum z
 			if(uz <= 0.f)
@@ -568,9 +682,9 @@ void MLProcInputToSignals::processOSC(const int frames)
 				mUnisonInputTouch = -1;
 
 				float maxZ = 0;
-				for (int v=0; v<mCurrentVoices; ++v)
+				for (int v=0; v<touches; ++v)
 				{
-					float zz = mLatestFrame(2, v);
+					float zz = f.data[v][2];
 					if(zz > maxZ)
 					{
 						maxZ = zz;
@@ -583,9 +697,9 @@ void MLProcInputToSignals::processOSC(const int frames)
 			if(mUnisonInputTouch >= 0)
 			{
 				// unison continues				
-				ux = mLatestFrame(0, mUnisonInputTouch);
-				uy = mLatestFrame(1, mUnisonInputTouch);
-				note = mLatestFrame(3, mUnisonInputTouch);
+				ux = f.data[mUnisonInputTouch][0];
+				uy = f.data[mUnisonInputTouch][1];
+				note = f.data[mUnisonInputTouch][3];
 				upitch = noteToPitch(note);
 				udx = ux - mVoices[mUnisonInputTouch].mStartX;
 				udy = uy - mVoices[mUnisonInputTouch].mStartY;
@@ -594,28 +708,27 @@ void MLProcInputToSignals::processOSC(const int frames)
 		
 		for (int v=0; v<mCurrentVoices; ++v)
 		{			
-			const int frameTime = 1;
-			mVoices[v].mdPitch.addChange(upitch, frameTime);
-			mVoices[v].mdGate.addChange((int)(uz > 0.), frameTime);
-			mVoices[v].mdAmp.addChange(uz, frameTime);
-			mVoices[v].mdVel.addChange(uz, frameTime);
+			mVoices[v].mdPitch.addChange(upitch, time);
+			mVoices[v].mdGate.addChange((int)(uz > 0.), time);
+			mVoices[v].mdAmp.addChange(uz, time);
+			mVoices[v].mdVel.addChange(uz, time);
 			
-			mVoices[v].mdNotePressure.addChange(udx, frameTime);
-			mVoices[v].mdMod.addChange(udy, frameTime);
-			mVoices[v].mdMod2.addChange(ux*2.f - 1.f, frameTime);
-			mVoices[v].mdMod3.addChange(uy*2.f - 1.f, frameTime);		
+			mVoices[v].mdNotePressure.addChange(udx, time);
+			mVoices[v].mdMod.addChange(udy, time);
+			mVoices[v].mdMod2.addChange(ux*2.f - 1.f, time);
+			mVoices[v].mdMod3.addChange(uy*2.f - 1.f, time);		
 		}	
 		
 		mUnisonPitch1 = upitch;	
 	}
 	else 
 	{
-		for (int v=0; v<mCurrentVoices; ++v)
+		for (int v=0; v<touches; ++v)
 		{
-			x = mLatestFrame(0, v);
-			y = mLatestFrame(1, v);
-			z = mLatestFrame(2, v);
-			note = mLatestFrame(3, v);
+			x = f.data[v][0];
+			y = f.data[v][1];
+			z = f.data[v][2];
+			note = f.data[v][3];
 			dx = 0.;
 			dy = 0.;
 			
@@ -655,77 +768,33 @@ void MLProcInputToSignals::processOSC(const int frames)
 			mVoices[v].mZ1 = z;
 
 			// OSC: pitch vel(constant during hold) voice(touch) after(z) dx dy x y			
-			const int frameTime = 1;
-			mVoices[v].mdPitch.addChange(mVoices[v].mPitch, frameTime);
-			mVoices[v].mdGate.addChange((int)(z > 0.), frameTime);
-			mVoices[v].mdAmp.addChange(z, frameTime);
-			mVoices[v].mdVel.addChange(z, frameTime);
+			mVoices[v].mdPitch.addChange(mVoices[v].mPitch, time);
+			mVoices[v].mdGate.addChange((int)(z > 0.), time);
+			mVoices[v].mdAmp.addChange(z, time);
+			mVoices[v].mdVel.addChange(z, time);
 			
-			mVoices[v].mdNotePressure.addChange(dx, frameTime);
-			mVoices[v].mdMod.addChange(dy, frameTime);
-			mVoices[v].mdMod2.addChange(x*2.f - 1.f, frameTime);
-			mVoices[v].mdMod3.addChange(y*2.f - 1.f, frameTime);		
+			mVoices[v].mdNotePressure.addChange(dx, time);
+			mVoices[v].mdMod.addChange(dy, time);
+			mVoices[v].mdMod2.addChange(x*2.f - 1.f, time);
+			mVoices[v].mdMod3.addChange(y*2.f - 1.f, time);		
 		}	
-	}	
-	
-	// write change lists out to signals.
-	for (int v=0; v<kMLEngineMaxVoices; ++v)
-	{
-		// changes per voice
-		MLSignal& pitch = getOutput(v*kNumVoiceSignals + 1);
-		MLSignal& gate = getOutput(v*kNumVoiceSignals + 2);
-		MLSignal& amp = getOutput(v*kNumVoiceSignals + 3);
-		MLSignal& vel = getOutput(v*kNumVoiceSignals + 4);
-		// voice = 5
-		MLSignal& after = getOutput(v*kNumVoiceSignals + 6);
-		MLSignal& mod = getOutput(v*kNumVoiceSignals + 7);
-		MLSignal& mod2 = getOutput(v*kNumVoiceSignals + 8);
-		MLSignal& mod3 = getOutput(v*kNumVoiceSignals + 9);
-			
-		if (v < mCurrentVoices)
-		{
-			mVoices[v].mdPitch.writeToSignal(pitch, frames);
-
-#if INPUT_DRIFT
-			// write to common temp drift signal, we add one change manually so read offset is 0
-			mVoices[v].mdDrift.writeToSignal(mTempSignal, frames);
-			pitch.add(mTempSignal);
-#endif
-			mVoices[v].mdGate.writeToSignal(gate, frames);
-			mVoices[v].mdAmp.writeToSignal(amp, frames);
-			mVoices[v].mdVel.writeToSignal(vel, frames);
-			mVoices[v].mdNotePressure.writeToSignal(after, frames);
-			mVoices[v].mdMod.writeToSignal(mod, frames);
-			mVoices[v].mdMod2.writeToSignal(mod2, frames);
-			mVoices[v].mdMod3.writeToSignal(mod3, frames);
-		}
-		else
-		{
-			pitch.setToConstant(0.f);
-			gate.setToConstant(0.f);
-			amp.setToConstant(0.f);
-			vel.setToConstant(0.f); 
-			after.setToConstant(0.f); 
-			mod.setToConstant(0.f); 
-			mod2.setToConstant(0.f); 
-			mod3.setToConstant(0.f); 
-		}
 	}
 }
 
-
 // process control events to make change lists
 //
-void MLProcInputToSignals::processEvents()
+void MLProcInputToSignals::processEvents(const int frames)
 {
+    // events from before this vector that arrived late are applied at its start,
+    // and any past its end at its end.
     MLControlEvent e;
-    MLControlEventVector::const_iterator it;
-    for(it = mStartEvent; it != mEndEvent; it++)
+    for(const MLControlEvent* pEvent = mEvents.begin(); pEvent != mEvents.end(); ++pEvent)
     {
-        e = *it;
-        e.mTime -= mEventTimeOffset;
+        e = *pEvent;
+        e.mTime = clamp(e.mTime - mEventTimeOffset, 0, frames - 1);
         processEvent(e);
     }
+    mEvents = MLControlEventSpan();
 }
 
 // process one incoming event by making the appropriate changes in state and change lists.
@@ -740,16 +809,37 @@ void MLProcInputToSignals::processEvent(const MLControlEvent &event)
             doNoteOff(event);
             break;
         case MLControlEvent::eController:
-            doController(event);
+            if(mProtocol == kInputProtocolMPE)
+            {
+                doMPEController(event);
+            }
+            else
+            {
+                doController(event);
+            }
             break;
         case MLControlEvent::ePitchWheel:
-            doPitchWheel(event);
+            if(mProtocol == kInputProtocolMPE)
+            {
+                doMPEPitchWheel(event);
+            }
+            else
+            {
+                doPitchWheel(event);
+            }
             break;
         case MLControlEvent::eNotePressure:
             doNotePressure(event);
             break;
         case MLControlEvent::eChannelPressure:
-            doChannelPressure(event);
+            if(mProtocol == kInputProtocolMPE)
+            {
+                doMPEChannelPressure(event);
+            }
+            else
+            {
+                doChannelPressure(event);
+            }
             break;
         case MLControlEvent::eSustainPedal:
             doSustain(event);
@@ -762,21 +852,13 @@ void MLProcInputToSignals::processEvent(const MLControlEvent &event)
 
 void MLProcInputToSignals::doNoteOn(const MLControlEvent& event)
 {
-    int time = event.mTime;
-    int chan = event.mChannel;
-    float note = event.mValue1;
-    float vel = event.mValue2;
-    // debug() << "do note on " << note << " chan " << chan << " vel " << vel << " at time " << time << "\n";
-    
-    int eventIdx = mNoteEventsPlaying.findFreeEvent();
-    if(eventIdx < 0) return;
+    // debug() << "do note on " << event.mValue1 << " chan " << event.mChannel << " vel " << event.mValue2 << " at time " << event.mTime << "\n";
 	
     if(!mUnisonMode)
     {
         int v = findFreeVoice();
         if(v >= 0)
         {
-            mNoteEventsPlaying[eventIdx] = event;
             sendNoteToVoice(event, v);
         }
         else
@@ -789,6 +871,10 @@ void MLProcInputToSignals::doNoteOn(const MLControlEvent& event)
             }
             stealVoice(event, v);
         }
+        if(mProtocol == kInputProtocolMPE)
+        {
+            startMPENote(event, v);
+        }
     }
     else
     {
@@ -798,42 +884,25 @@ void MLProcInputToSignals::doNoteOn(const MLControlEvent& event)
 
 void MLProcInputToSignals::doNoteOff(const MLControlEvent& event)
 {
-    int time = event.mTime;
-    int id = event.mID;
-    float note = event.mValue1;
-    float vel = event.mValue2;
-    // debug() << "do note off " << note << " vel " << vel << " at time " << time << "\n";
+    // debug() << "do note off " << event.mValue1 << " vel " << event.mValue2 << " at time " << event.mTime << "\n";
     
 	if (!mUnisonMode) // single voice per event
 	{
-		for (int i=0; i<kMaxEvents; ++i)
+		// release each voice playing the key, or hand it to the sustain pedal.
+		const int key = getNoteKey(event);
+		int v;
+		while((v = mKeyVoices[key]) >= 0)
 		{
-			if(mNoteEventsPlaying[i].mID == id)
+			if(mSustain)
 			{
-                // clear from play list
-				mNoteEventsPlaying[i].clear();
-                if(mSustain)
-                {
-                    // move to sustain list
-                    int idx = mNoteEventsSustaining.findFreeEvent();
-                    if(idx >= 0)
-                    {
-                        mNoteEventsSustaining[idx] = event;
-                    }
-                }
+				removeVoiceFromKey(v);
+				moveVoice(v, kVoiceSustained);
 			}
-		}
-		if(!mSustain)
-        {
-            // clear any voices matching note ID
-			for(int v=0; v<mCurrentVoices; ++v)
+			else
 			{
-                if(mVoices[v].mInstigatorID == id)
-                {
-                    removeNoteFromVoice(event, v);
-                }
+				removeNoteFromVoice(event, v);
 			}
-        }
+		}
 	}
     
     /*
@@ -944,12 +1013,9 @@ void MLProcInputToSignals::doPitchWheel(const MLControlEvent& event)
 
 void MLProcInputToSignals::doNotePressure(const MLControlEvent& event)
 {
-	for (int i=0; i<mCurrentVoices; ++i)
+	for (int v = mKeyVoices[getNoteKey(event)]; v >= 0; v = mVoices[v].mNextKeyVoice)
 	{
-		if ((event.mChannel == mVoices[i].mChannel) && (event.mID == mVoices[i].mInstigatorID))
-		{
-			mVoices[i].mdNotePressure.addChange(event.mValue2, event.mTime);
-		}
+		mVoices[v].mdNotePressure.addChange(event.mValue2, event.mTime);
 	}
 }
 
@@ -969,30 +1035,107 @@ void MLProcInputToSignals::doSustain(const MLControlEvent& event)
     mSustain = (int)event.mValue1;
     if(!mSustain)
     {
-        // clear any events in the sustain list along with any voices they match
-		for (int i=0; i<kMaxEvents; ++i)
-		{
-            const MLControlEvent& e = mNoteEventsSustaining[i];
-			if(!e.isFree())
-			{
-				mNoteEventsSustaining[i].clear();
-                for(int v=0; v<mCurrentVoices; ++v)
-                {
-                    if(mVoices[v].mInstigatorID == e.mID)
-                    {
-                        removeNoteFromVoice(event, v);
-                    }
-                }
-            }
+        // release all the voices held by the pedal.
+        int v;
+        while((v = mVoiceLists[kVoiceSustained].head) >= 0)
+        {
+            removeNoteFromVoice(event, v);
         }
     }
 }
 
+#pragma mark MPE
+
+void MLProcInputToSignals::doMPEController(const MLControlEvent& event)
+{
+    const int time = event.mTime;
+	const int ctrl = (int)event.mValue1;
+	const float val = event.mValue2;
+	if (event.mChannel == kMPEMasterChannel)
+	{
+		// mod controllers on the master channel go to modb and modc of all voices.
+		if ((ctrl == mControllerNumber) || (ctrl == mControllerNumber + 1))
+		{
+			for (int v=0; v<mCurrentVoices; ++v)
+			{
+				MLChangeList& mod = (ctrl == mControllerNumber) ? mVoices[v].mdMod2 : mVoices[v].mdMod3;
+				mod.addChange(val, time);
+			}
+		}
+	}
+	else if (ctrl == kMPETimbreController)
+	{
+		// timbre goes to moda of the note's voice.
+		ChannelState& c = mChannels[event.mChannel & (kMIDIChannels - 1)];
+		c.timbre = val;
+		if (c.voice >= 0)
+		{
+			mVoices[c.voice].mdMod.addChange(val, time);
+		}
+	}
+}
+
+void MLProcInputToSignals::doMPEPitchWheel(const MLControlEvent& event)
+{
+	const float u = (event.mValue1 - 8192.f) / 8191.f;
+	if (event.mChannel == kMPEMasterChannel)
+	{
+		mMasterPitchBend.addChange(u * mPitchWheelSemitones / 12.f, event.mTime);
+	}
+	else
+	{
+		ChannelState& c = mChannels[event.mChannel & (kMIDIChannels - 1)];
+		c.bend = u * mMPEBendSemitones / 12.f;
+		if (c.voice >= 0)
+		{
+			mVoices[c.voice].mdPitchBend.addChange(c.bend, event.mTime);
+		}
+	}
+}
+
+void MLProcInputToSignals::doMPEChannelPressure(const MLControlEvent& event)
+{
+	if (event.mChannel == kMPEMasterChannel)
+	{
+		for (int v=0; v<mCurrentVoices; ++v)
+		{
+			mVoices[v].mdChannelPressure.addChange(event.mValue1, event.mTime);
+		}
+	}
+	else
+	{
+		ChannelState& c = mChannels[event.mChannel & (kMIDIChannels - 1)];
+		c.pressure = event.mValue1;
+		if (c.voice >= 0)
+		{
+			mVoices[c.voice].mdNotePressure.addChange(c.pressure, event.mTime);
+		}
+	}
+}
+
+// start voice v from the expression already sent on the note's channel.
+void MLProcInputToSignals::startMPENote(const MLControlEvent& event, int v)
+{
+    if(!within(v, 0, (int)mVoices.size())) return;
+	const ChannelState& c = mChannels[event.mChannel & (kMIDIChannels - 1)];
+	mVoices[v].mdPitchBend.addChange(c.bend, event.mTime);
+	mVoices[v].mdNotePressure.addChange(c.pressure, event.mTime);
+	mVoices[v].mdMod.addChange(c.timbre, event.mTime);
+}
+
 // process change lists to make output signals
 //
 void MLProcInputToSignals::writeOutputSignals(const int frames)
 {
-	for (int v=0; v<kMLEngineMaxVoices; ++v)
+	const bool mpe = (mProtocol == kInputProtocolMPE);
+	if (mpe)
+	{
+		mMasterPitchBend.writeToSignal(mMasterBendSignal, frames);
+		mMasterPitchBend.clearChanges();
+	}
+	
+	const int voices = (int)mVoices.size();
+	for (int v=0; v<voices; ++v)
 	{
 		// changes per voice
 		MLSignal& pitch = getOutput(v*kNumVoiceSignals + 1);
@@ -1010,6 +1153,10 @@ void MLProcInputToSignals::writeOutputSignals(const int frames)
 			mVoices[v].mdPitch.writeToSignal(pitch, frames);
 			mVoices[v].mdPitchBend.writeToSignal(mTempSignal, frames);
 			pitch.add(mTempSignal);
+			if (mpe)
+			{
+				pitch.add(mMasterBendSignal);
+			}
             
 #if INPUT_DRIFT
 			// write to common temp drift signal, we add one change manually so read offset is 0
@@ -1096,16 +1243,17 @@ MLSample MLProcInputToSignals::noteToPitch(float note)
 
 void MLProcInputToSignals::sendNoteToVoice(const MLControlEvent& e, int v)
 {
-    if(!within(v, 0, kMLEngineMaxVoices)) return;
+    if(!within(v, 0, (int)mVoices.size())) return;
 	float note = e.mValue1;
 	float vel = e.mValue2;
 	int time = e.mTime;
     
+    moveVoice(v, kVoiceActive);
+    addVoiceToKey(v, getNoteKey(e));
+    setVoiceChannel(v, e.mChannel);
     mVoices[v].mActive = true;
-    mVoices[v].mChannel = e.mChannel;
     mVoices[v].mInstigatorID = e.mID;
     mVoices[v].mNote = note;
-    mVoices[v].mAge = 0;
     mVoices[v].mdPitch.addChange(noteToPitch(note), time);
     mVoices[v].mdGate.addChange(1, time);
     mVoices[v].mdAmp.addChange(vel, time);
@@ -1114,13 +1262,14 @@ void MLProcInputToSignals::sendNoteToVoice(const MLControlEvent& e, int v)
 
 void MLProcInputToSignals::removeNoteFromVoice(const MLControlEvent& e, int v)
 {
-    if(!within(v, 0, kMLEngineMaxVoices)) return;
+    if(!within(v, 0, (int)mVoices.size())) return;
 	int time = e.mTime;
     
+    removeVoiceFromKey(v);
+    moveVoice(v, kVoiceFree);
     mVoices[v].mActive = false;
     mVoices[v].mInstigatorID = 0;
     mVoices[v].mNote = 0;
-    mVoices[v].mAge = 0;
     mVoices[v].mdGate.addChange(0.f, time);
     mVoices[v].mdAmp.addChange(0.f, time);
     // note: pitch and velocity are allowed to "ring out"
@@ -1128,15 +1277,18 @@ void MLProcInputToSignals::removeNoteFromVoice(const MLControlEvent& e, int v)
 
 void MLProcInputToSignals::stealVoice(const MLControlEvent& e, int v)
 {
-    if(!within(v, 0, kMLEngineMaxVoices)) return;
+    if(!within(v, 0, (int)mVoices.size())) return;
 	float note = e.mValue1;
 	float vel = e.mValue2;
 	int time = e.mTime;
     if (time == 0) time++; // in case where time = 0, make room for retrigger.
     
+    removeVoiceFromKey(v);
+    moveVoice(v, kVoiceActive);
+    addVoiceToKey(v, getNoteKey(e));
+    setVoiceChannel(v, e.mChannel);
     mVoices[v].mInstigatorID = e.mID;
     mVoices[v].mNote = note;
-    mVoices[v].mAge = 0;
     mVoices[v].mdPitch.addChange(noteToPitch(note), time);
     
     if (mRetrig)
@@ -1150,96 +1302,159 @@ void MLProcInputToSignals::stealVoice(const MLControlEvent& e, int v)
     mVoices[v].mdVel.addChange(vel, time);
 }
 
-// return index of free voice or voice to steal.
-// increments mVoiceRotateOffset.
-//
-int MLProcInputToSignals::findFreeVoice()
+#pragma mark voice lists
+
+// index into mKeyVoices for the channel and key of a note event.
+int MLProcInputToSignals::getNoteKey(const MLControlEvent& e)
 {
-	int r = -1;
-	for (int v = 0; v < mCurrentVoices; ++v)
+	return (e.mChannel & (kMIDIChannels - 1))*kNoteKeyNotes + (e.mID & (kNoteKeyNotes - 1));
+}
+
+// put the current voices in the free list in order, and all keys up and channels empty.
+void MLProcInputToSignals::resetVoiceLists()
+{
+	for(int i=0; i<kVoiceStates; ++i)
 	{
-		int vr;
-        if(mRotateMode)
-        {
-            vr = (v + mVoiceRotateOffset) % mCurrentVoices;
-        }
-        else
-        {
-            vr = v;
-        }
-		if (!mVoices[vr].mActive)
+		mVoiceLists[i].head = -1;
+		mVoiceLists[i].tail = -1;
+	}
+	std::fill(mKeyVoices.begin(), mKeyVoices.end(), -1);
+	for(int i=0; i<kMIDIChannels; ++i)
+	{
+		mChannels[i].voice = -1;
+		mChannels[i].bend = 0.f;
+		mChannels[i].pressure = 0.f;
+		mChannels[i].timbre = 0.f;
+	}
+	
+	const int voices = (int)mVoices.size();
+	for(int v=0; v<voices; ++v)
+	{
+		MLVoice& voice = mVoices[v];
+		voice.mState = -1;
+		voice.mKey = -1;
+		voice.mNextKeyVoice = -1;
+		if(v < mCurrentVoices)
 		{
-			r = vr;
-            mVoiceRotateOffset++;
-			break;
+			moveVoice(v, kVoiceFree);
 		}
 	}
-	return r;
 }
 
-// look for any voice not matching a key held down
-// (possible with sustain pedal on)
-int MLProcInputToSignals::findSustainedVoice()
+// move voice v from its list to the end of the list for state.
+void MLProcInputToSignals::moveVoice(int v, int state)
 {
-	int r = -1;
-	for (int v = 0; v < mCurrentVoices; ++v)
+	MLVoice& voice = mVoices[v];
+	if(voice.mState >= 0)
 	{
-		int vr;
-        if(mRotateMode)
-        {
-            vr = (v + mVoiceRotateOffset) % mCurrentVoices;
-        }
-        else
-        {
-            vr = v;
-        }
-		if (!mVoices[vr].mActive)
+		VoiceList& from = mVoiceLists[voice.mState];
+		if(voice.mPrevVoice >= 0)
+		{
+			mVoices[voice.mPrevVoice].mNextVoice = voice.mNextVoice;
+		}
+		else
+		{
+			from.head = voice.mNextVoice;
+		}
+		if(voice.mNextVoice >= 0)
+		{
+			mVoices[voice.mNextVoice].mPrevVoice = voice.mPrevVoice;
+		}
+		else
+		{
+			from.tail = voice.mPrevVoice;
+		}
+	}
+	
+	VoiceList& to = mVoiceLists[state];
+	voice.mPrevVoice = to.tail;
+	voice.mNextVoice = -1;
+	if(to.tail >= 0)
+	{
+		mVoices[to.tail].mNextVoice = v;
+	}
+	else
+	{
+		to.head = v;
+	}
+	to.tail = v;
+	voice.mState = state;
+}
+
+void MLProcInputToSignals::addVoiceToKey(int v, int key)
+{
+	mVoices[v].mKey = key;
+	mVoices[v].mNextKeyVoice = mKeyVoices[key];
+	mKeyVoices[key] = v;
+}
+
+// unlink voice v from the voices playing its key. Keys are rarely played by more 
+// than one voice at once, so this is short.
+void MLProcInputToSignals::removeVoiceFromKey(int v)
+{
+	const int key = mVoices[v].mKey;
+	if(key < 0) return;
+	int* pLink = &mKeyVoices[key];
+	while(*pLink >= 0)
+	{
+		if(*pLink == v)
 		{
-			r = vr;
-            mVoiceRotateOffset++;
+			*pLink = mVoices[v].mNextKeyVoice;
 			break;
 		}
+		pLink = &mVoices[*pLink].mNextKeyVoice;
 	}
-	return r;
+	mVoices[v].mKey = -1;
+	mVoices[v].mNextKeyVoice = -1;
+}
+
+// make v the voice for its new channel in the channel table. A released voice 
+// stays there until another note starts on its channel or v plays elsewhere.
+void MLProcInputToSignals::setVoiceChannel(int v, int chan)
+{
+	ChannelState& prev = mChannels[mVoices[v].mChannel & (kMIDIChannels - 1)];
+	if(prev.voice == v)
+	{
+		prev.voice = -1;
+	}
+	mVoices[v].mChannel = chan;
+	mChannels[chan & (kMIDIChannels - 1)].voice = v;
+}
+
+// return index of a free voice, or -1 if all are playing. In rotate mode this is 
+// the voice released longest ago, otherwise the one released most recently.
+//
+int MLProcInputToSignals::findFreeVoice()
+{
+	const VoiceList& freeVoices = mVoiceLists[kVoiceFree];
+	return mRotateMode ? freeVoices.head : freeVoices.tail;
+}
+
+// return the oldest voice whose key is up but is held by the sustain pedal,
+// or -1 if there are none.
+int MLProcInputToSignals::findSustainedVoice()
+{
+	return mVoiceLists[kVoiceSustained].head;
 }
 
+// return the oldest voice with a key held down, or -1 if there are none.
 int MLProcInputToSignals::findOldestVoice()
 {
-	int r = 0;
-    int maxAge = -1;
-    for (int v=0; v<mCurrentVoices; ++v)
-    {
-        int age = mVoices[v].mAge;
-        if (age > maxAge)
-        {
-            maxAge = age;
-            r = v;
-        }
-    }
-	return r;
+	return mVoiceLists[kVoiceActive].head;
 }
 
-void MLProcInputToSignals::dumpEvents()
+void MLProcInputToSignals::dumpVoiceLists()
 {
-	for (int i=0; i<kMaxEvents; ++i)
+	static const char* kVoiceStateNames[kVoiceStates] = { "free", "active", "sustained" };
+	for (int i=0; i<kVoiceStates; ++i)
 	{
-		MLControlEvent& event = mNoteEventsPlaying[i];
-		int type = event.mType;
-		switch(type)
+		debug() << kVoiceStateNames[i] << ":";
+		for (int v = mVoiceLists[i].head; v >= 0; v = mVoices[v].mNextVoice)
 		{
-		case MLControlEvent::eNull:
-			debug() << "-";
-			break;		
-		case MLControlEvent::eNoteOn:
-			debug() << "N";
-			break;		
-		default:
-			debug() << "?";
-			break;		
-			
+			debug() << " " << v;
 		}
+		debug() << "\n";
 	}
-	debug() << "\n";
 }
 
 void MLProcInputToSignals::dumpVoices()
@@ -17,6 +17,7 @@
 #include "pa_ringbuffer.h"
 
 #include <stdexcept>
+#include <vector>
 
 // a voice that can play.
 //
@@ -34,7 +35,14 @@ public:
     int mInstigatorID; // for matching event sources, could be MIDI key, or touch number.
     int mChannel;   
 	int mNote;
-	int mAge;	// time active, measured to the end of the current process buffer
+	
+	// allocator state, owned by MLProcInputToSignals: the list the voice is in, its 
+	// neighbors there, the key it is playing and the next voice playing the same key.
+	int mState;
+	int mPrevVoice;
+	int mNextVoice;
+	int mKey;
+	int mNextKeyVoice;
 	
 	// for continuous touch inputs (OSC)
 	float mStartX;
@@ -71,6 +79,18 @@ public:
 	static const int kFrameWidth = 4;
 	static const int kFrameHeight = 16;
 	static const int kFrameBufferSize = 128;
+	static const int kMIDIChannels = 16;
+	static const int kMPEMasterChannel = 1;
+	
+	// one frame of touch data, written to the frame ring buffer by an OSC listener.
+	// data holds x, y, z and note for each touch. time is when the listener got the 
+	// frame, in seconds on any clock that does not jump, or 0 if not known. Ring 
+	// buffers with elements of just the data, the older format, can also be read.
+	struct TouchFrame
+	{
+		double time;
+		float data[kFrameHeight][kFrameWidth];
+	};
 
     MLProcInputToSignals();
 	~MLProcInputToSignals();
@@ -84,7 +104,7 @@ public:
     
 	void clearChangeLists();
     void setEventTimeOffset(int t);
-    void setEventRange(MLControlEventVector::const_iterator start, MLControlEventVector::const_iterator end);
+    void setEvents(const MLControlEventSpan& events);
 	
  	void setup();
  	err resize();
@@ -96,7 +116,9 @@ public:
 
 private:
     void processOSC(const int n);
-	void processEvents();
+	void readTouchFrames(const int frames);
+	void processTouchFrame(const TouchFrame& f, const int time);
+	void processEvents(const int frames);
 	void writeOutputSignals(const int n);
 
     void processEvent(const MLControlEvent& event);
@@ -107,10 +129,42 @@ private:
 	void doNotePressure(const MLControlEvent& event);
 	void doChannelPressure(const MLControlEvent& event);
 	void doSustain(const MLControlEvent& event);
+	
+	// MPE: expression on a member channel goes to the voice playing on that channel,
+	// and on the master channel to all voices.
+	void doMPEController(const MLControlEvent& event);
+	void doMPEPitchWheel(const MLControlEvent& event);
+	void doMPEChannelPressure(const MLControlEvent& event);
+	void startMPENote(const MLControlEvent& event, int voiceIdx);
 
-	void dumpEvents();
+	void dumpVoiceLists();
 	void dumpVoices();
 	void dumpSignals();
+	
+	// voice allocation. Every voice is in one of three lists: free voices in the 
+	// order they were released, voices with keys held and voices held by the sustain 
+	// pedal, both in the order they were started. Voices playing each key are also 
+	// chained from mKeyVoices. All allocation decisions take constant time.
+	enum eVoiceState
+	{
+		kVoiceFree = 0,
+		kVoiceActive,
+		kVoiceSustained,
+		kVoiceStates
+	};
+	
+	struct VoiceList
+	{
+		int head;
+		int tail;
+	};
+	
+	static int getNoteKey(const MLControlEvent& e);
+	void resetVoiceLists();
+	void moveVoice(int v, int state);
+	void addVoiceToKey(int v, int key);
+	void removeVoiceFromKey(int v);
+	void setVoiceChannel(int v, int chan);
     
     int findFreeVoice();
     int findSustainedVoice();
@@ -123,21 +177,55 @@ private:
 	int mProtocol;
 	MLProcInfo<MLProcInputToSignals> mInfo;
 	PaUtilRingBuffer* mpFrameBuf;
-	MLSignal mLatestFrame;
     int mFrameCounter;
+	
+	// touch frames read from mpFrameBuf, each waiting for the vector that contains
+	// its sample time, in a ring of kFrameBufferSize.
+	struct PendingFrame
+	{
+		TouchFrame frame;
+		double sampleTime;
+	};
+	std::vector<PendingFrame> mPendingFrames;
+	int mPendingStart;
+	int mPendingCount;
+	
+	// samples processed since clear(). 
+	double mSampleCounter;
+	
+	// the latest (listener time - our time) seen for a frame, which maps timed frames 
+	// to our samples. Frames are played mFrameLatency samples after that, so that the 
+	// frames for a whole host block, read at its start, can be spread over the block.
+	double mFrameClockOffset;
+	bool mFrameClockValid;
+	int mFrameLatency;
+	bool mFrameInterp;
     
-    MLControlEventVector mNoteEventsPlaying;    // notes with keys held down and sounding
-    MLControlEventVector mNoteEventsSustaining; // notes still sounding because sustain pedal is held
-    MLControlEventVector mNoteEventsPending;    // notes stolen that may play again when voices are freed
-    
-	MLVoice mVoices[kMLEngineMaxVoices];
-
-	int mNextEventIdx;
-	int mVoiceRotateOffset;
+	// voices are made in resize() for the "max_voices" param, up to kMLEngineMaxVoices.
+	// the "voices" param sets how many of them play.
+	std::vector<MLVoice> mVoices;
+	VoiceList mVoiceLists[kVoiceStates];
+	std::vector<int> mKeyVoices;
+	
+	// for each MIDI channel, the voice last started on it and the latest MPE 
+	// expression on it. A note starts with the expression already sent on its channel.
+	struct ChannelState
+	{
+		int voice;
+		float bend;
+		float pressure;
+		float timbre;
+	};
+	ChannelState mChannels[kMIDIChannels];
+	
+	// pitch bend on the MPE master channel, added to every voice.
+	MLChangeList mMasterPitchBend;
+	MLSignal mMasterBendSignal;
+	float mMPEBendSemitones;
 	
     int mEventTimeOffset;
-    // the range of events [mStartEvent, mEndEvent) will control the next process() call.
-    MLControlEventVector::const_iterator mStartEvent, mEndEvent;
+    // the events that will control the next process() call.
+    MLControlEventSpan mEvents;
 		
 	int mControllerNumber;
 	int mCurrentVoices;
@@ -0,0 +1,299 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+
+const int kMLLevelDetectorChannels = 8;
+const int kMLTruePeakPhases = 4;
+const int kMLTruePeakTaps = 12;
+
+// ----------------------------------------------------------------
+// class definition
+
+// level detector for up to eight channels, for meters and dynamics. Each output is
+// updated once per vector and is a constant signal, so a meter does not need an 
+// audio-rate output. Levels are linear amplitudes.
+//
+// mode: 0 = RMS, 1 = peak, 2 = true peak.
+// time: RMS averaging time constant in seconds. 0.3 gives VU-like ballistics.
+// release: time in seconds for a peak reading to fall by 20dB. The default of 
+// 1.7 is the IEC 60268-10 type I PPM return time. Peaks rise instantly.
+//
+// true peak is the peak of the signal interpolated to four times the sample rate,
+// as in ITU-R BS.1770-4, using a 48-tap windowed-sinc interpolator.
+//
+// block statistics are computed four samples at a time, and the ballistics 
+// are run once per vector for each channel. Channels with constant zero input are skipped.
+
+class MLProcLevelDetector : public MLProc
+{
+public:
+	 MLProcLevelDetector();
+	~MLProcLevelDetector();
+
+	err resize();
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcLevelDetector> mInfo;
+	void calcCoeffs();
+	MLSample getMeanSquare(const MLSignal& x, const int frames);
+	MLSample getPeak(const MLSignal& x, const int frames);
+	MLSample getTruePeak(const MLSignal& x, const int channel, const int frames);
+
+	enum { kRMS = 0, kPeak, kTruePeak };
+	int mMode;
+	MLSample mRMSTime;
+	MLSample mRelease;
+	int mCoeffFrames;
+	MLSample mRMSCoeff;
+	MLSample mReleaseCoeff;
+
+	MLSample mLevel[kMLLevelDetectorChannels];
+	MLSample mTruePeakTaps[kMLTruePeakPhases][kMLTruePeakTaps];
+	
+	// input history for the true peak filter, one row per channel: 
+	// kMLTruePeakTaps - 1 past samples, then the current vector.
+	MLSignal mHistory;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcLevelDetector> classReg("level_detector");
+	ML_UNUSED MLProcParam<MLProcLevelDetector> params[] = { "mode", "time", "release" };
+	ML_UNUSED MLProcInput<MLProcLevelDetector> inputs[] = { 
+		"in1", "in2", "in3", "in4", "in5", "in6", "in7", "in8" };
+	ML_UNUSED MLProcOutput<MLProcLevelDetector> outputs[] = { 
+		"out1", "out2", "out3", "out4", "out5", "out6", "out7", "out8" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcLevelDetector::MLProcLevelDetector() :
+	mMode(kRMS),
+	mRMSTime(0.3f),
+	mRelease(1.7f),
+	mCoeffFrames(0),
+	mRMSCoeff(0.f),
+	mReleaseCoeff(0.f)
+{
+	setParam("mode", 0);
+	setParam("time", 0.3f);
+	setParam("release", 1.7f);
+	
+	// 4x interpolation filter: a Hann-windowed sinc with cutoff at the input Nyquist 
+	// frequency, split into four phases of 12 taps, each normalized to unity gain at DC.
+	const int taps = kMLTruePeakPhases*kMLTruePeakTaps;
+	const double center = (taps - 1)*0.5;
+	for(int p=0; p<kMLTruePeakPhases; ++p)
+	{
+		double sum = 0.;
+		for(int k=0; k<kMLTruePeakTaps; ++k)
+		{
+			const int m = k*kMLTruePeakPhases + p;
+			const double t = (m - center)/(double)kMLTruePeakPhases;
+			const double sinc = (fabs(t) < 1e-9) ? 1. : sin(kMLPi*t)/(kMLPi*t);
+			const double w = 0.5 - 0.5*cos(kMLTwoPi*(m + 0.5)/(double)taps);
+			mTruePeakTaps[p][k] = sinc*w;
+			sum += mTruePeakTaps[p][k];
+		}
+		for(int k=0; k<kMLTruePeakTaps; ++k)
+		{
+			mTruePeakTaps[p][k] /= sum;
+		}
+	}
+	clear();
+}
+
+MLProcLevelDetector::~MLProcLevelDetector()
+{
+}
+
+MLProc::err MLProcLevelDetector::resize()
+{
+	MLProc::err e = OK;
+	const int vecSize = getContextVectorSize();
+	if (!mHistory.setDims(vecSize + kMLTruePeakTaps + kSSEVecSize, kMLLevelDetectorChannels))
+	{
+		e = memErr;
+	}
+	mCoeffFrames = 0;
+	return e;
+}
+
+void MLProcLevelDetector::clear()
+{
+	for(int c=0; c<kMLLevelDetectorChannels; ++c)
+	{
+		mLevel[c] = 0.f;
+	}
+	mHistory.clear();
+}
+
+void MLProcLevelDetector::calcCoeffs()
+{
+	static const MLSymbol modeSym("mode");
+	static const MLSymbol timeSym("time");
+	static const MLSymbol releaseSym("release");
+	mMode = clamp((int)getParam(modeSym), (int)kRMS, (int)kTruePeak);
+	mRMSTime = max(getParam(timeSym), 0.001f);
+	mRelease = max(getParam(releaseSym), 0.001f);
+	mCoeffFrames = 0;
+	mParamsChanged = false;
+}
+
+MLSample MLProcLevelDetector::getMeanSquare(const MLSignal& x, const int frames)
+{
+	if (x.isConstant()) return x[0]*x[0];
+	const MLSample* px = x.getConstBuffer();
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	__m128 acc = _mm_setzero_ps();
+	int n;
+	for(n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 v = _mm_load_ps(px + n);
+		acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+	}
+	float sums[kSSEVecSize];
+	_mm_storeu_ps(sums, acc);
+	float sum = sums[0] + sums[1] + sums[2] + sums[3];
+	for(; n<frames; ++n)
+	{
+		sum += px[n]*px[n];
+	}
+	return sum/(float)frames;
+}
+
+MLSample MLProcLevelDetector::getPeak(const MLSignal& x, const int frames)
+{
+	if (x.isConstant()) return fabsf(x[0]);
+	const MLSample* px = x.getConstBuffer();
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	__m128 vMax = _mm_setzero_ps();
+	int n;
+	for(n=0; n<vFrames; n += kSSEVecSize)
+	{
+		vMax = _mm_max_ps(vMax, _mm_andnot_ps(signMask, _mm_load_ps(px + n)));
+	}
+	float m[kSSEVecSize];
+	_mm_storeu_ps(m, vMax);
+	float peak = max(max(m[0], m[1]), max(m[2], m[3]));
+	for(; n<frames; ++n)
+	{
+		peak = max(peak, fabsf(px[n]));
+	}
+	return peak;
+}
+
+MLSample MLProcLevelDetector::getTruePeak(const MLSignal& x, const int channel, const int frames)
+{
+	const int past = kMLTruePeakTaps - 1;
+	MLSample* ph = mHistory.getBuffer() + mHistory.row(channel);
+	
+	// append this vector to the history.
+	for(int n=0; n<frames; ++n)
+	{
+		ph[past + n] = x[n];
+	}
+	
+	// run each phase of the interpolator over the vector.
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	__m128 vMax = _mm_setzero_ps();
+	float peak = 0.f;
+	for(int p=0; p<kMLTruePeakPhases; ++p)
+	{
+		const MLSample* h = mTruePeakTaps[p];
+		int n;
+		for(n=0; n<vFrames; n += kSSEVecSize)
+		{
+			__m128 acc = _mm_setzero_ps();
+			for(int k=0; k<kMLTruePeakTaps; ++k)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[k]), _mm_loadu_ps(ph + n + k)));
+			}
+			vMax = _mm_max_ps(vMax, _mm_andnot_ps(signMask, acc));
+		}
+		for(; n<frames; ++n)
+		{
+			float acc = 0.f;
+			for(int k=0; k<kMLTruePeakTaps; ++k)
+			{
+				acc += h[k]*ph[n + k];
+			}
+			peak = max(peak, fabsf(acc));
+		}
+	}
+	float m[kSSEVecSize];
+	_mm_storeu_ps(m, vMax);
+	peak = max(peak, max(max(m[0], m[1]), max(m[2], m[3])));
+	
+	// keep the last samples for the next vector.
+	for(int k=0; k<past; ++k)
+	{
+		ph[k] = ph[frames + k];
+	}
+	return peak;
+}
+
+void MLProcLevelDetector::process(const int frames)
+{
+	if (mParamsChanged) calcCoeffs();
+	
+	// per-vector ballistics coefficients, recalculated if the vector size changes.
+	if (frames != mCoeffFrames)
+	{
+		const float dt = (float)frames*getContextInvSampleRate();
+		mRMSCoeff = expf(-dt/mRMSTime);
+		
+		// fall 20dB, a factor of 10, in mRelease seconds.
+		mReleaseCoeff = powf(10.f, -dt/mRelease);
+		mCoeffFrames = frames;
+	}
+	
+	for(int c=0; c<kMLLevelDetectorChannels; ++c)
+	{
+		const MLSignal& x = getInput(c + 1);
+		MLSignal& y = getOutput(c + 1);
+		const bool silent = x.isConstant() && (x[0] == 0.f);
+		MLSample& level = mLevel[c];
+		
+		switch(mMode)
+		{
+			case kRMS:
+			default:
+			{
+				// level holds the mean square.
+				const MLSample ms = silent ? 0.f : getMeanSquare(x, frames);
+				level = ms + (level - ms)*mRMSCoeff;
+				y.setToConstant(sqrtf(level));
+				break;
+			}
+			case kPeak:
+			case kTruePeak:
+			{
+				MLSample peak = 0.f;
+				if (mMode == kTruePeak)
+				{
+					peak = (silent && (level == 0.f)) ? 0.f : getTruePeak(x, c, frames);
+				}
+				else if (!silent)
+				{
+					peak = getPeak(x, frames);
+				}
+				level = max(peak, level*mReleaseCoeff);
+				if (level < 1e-10f) level = 0.f;
+				y.setToConstant(level);
+				break;
+			}
+		}
+	}
+}
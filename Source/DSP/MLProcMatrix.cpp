@@ -25,8 +25,16 @@ MLProcMatrix::MLProcMatrix()
 	setParam("in", 0.);
 	setParam("out", 0.);
     mInputs = mOutputs = 0;
+	mRoutes.reserve(kMLMatrixMaxIns*kMLMatrixMaxOuts);
 //	debug() << "MLProcMatrix constructor\n";
 	clearConnections();
+	for (int i=0; i <= kMLMatrixMaxIns; ++i)
+	{
+		for (int j=0; j <= kMLMatrixMaxOuts; ++j)
+		{
+			mCurrentGain[i][j] = 0.;
+		}
+	}
 }
 
 MLProcMatrix::~MLProcMatrix()
@@ -42,6 +50,7 @@ MLProc::err MLProcMatrix::resize()
 	const int outputs = min(kMLMatrixMaxOuts, getNumOutputs());
     mInputs = inputs;
     mOutputs = outputs;
+	mRoutesChanged = true;
 	return e;
 }
 
@@ -55,38 +64,45 @@ void MLProcMatrix::clearConnections()
 			mGain[i][j] = 0.;
 		}
 	}
+	mRoutesChanged = true;
 }
 
 // multiple connections are made here using connect method.
 void MLProcMatrix::connect(int a, int b)
 {
-	const int inputs = min(kMLMatrixMaxIns, getNumInputs());
-	const int outputs = min(kMLMatrixMaxOuts, getNumOutputs());
-	if ((a <= inputs) && (b <= outputs))
-	{
-		mGain[a][b] = 1.;
-	}
+	setGain(a, b, 1.f);
 }
 
 void MLProcMatrix::disconnect(int a, int b)
+{
+	setGain(a, b, 0.f);
+}
+
+// get a single connection.
+bool MLProcMatrix::getConnection(int a, int b)
+{
+	return (getGain(a, b) > 0.5f);
+}
+
+void MLProcMatrix::setGain(int a, int b, float g)
 {
 	const int inputs = min(kMLMatrixMaxIns, getNumInputs());
 	const int outputs = min(kMLMatrixMaxOuts, getNumOutputs());
 	if ((a <= inputs) && (b <= outputs))
 	{
-		mGain[a][b] = 0.;
+		mGain[a][b] = g;
+		mRoutesChanged = true;
 	}
 }
 
-// get a single connection.
-bool MLProcMatrix::getConnection(int a, int b)
+float MLProcMatrix::getGain(int a, int b)
 {
-	bool r = false;
+	float r = 0.f;
 	const int inputs = min(kMLMatrixMaxIns, getNumInputs());
 	const int outputs = min(kMLMatrixMaxOuts, getNumOutputs());
 	if ((a <= inputs) && (b <= outputs))
 	{
-		r = (mGain[a][b] > 0.5f);
+		r = mGain[a][b];
 	}
 	return r;
 }
@@ -122,6 +138,62 @@ void MLProcMatrix::calcCoeffs()
 	mParamsChanged = false;
 }
 
+// make the list of routes to process. A route stays in the list after it is
+// disconnected until its gain has faded to zero.
+void MLProcMatrix::buildRoutes()
+{
+	mRoutes.clear();
+	for (int j=1; j <= mOutputs; ++j)
+	{
+		for (int i=1; i <= mInputs; ++i)
+		{
+			if ((mGain[i][j] != 0.f) || (mCurrentGain[i][j] != 0.f))
+			{
+				Route r;
+				r.mIn = i;
+				r.mOut = j;
+				mRoutes.push_back(r);
+			}
+		}
+	}
+	mRoutesChanged = false;
+}
+
+// add x times a gain ramping linearly from g0 to g1 over the block to y,
+// or set y to it if first is true.
+static void routeSignal(const MLSignal& x, MLSample* py, const int frames, const float g0, const float g1, const bool first)
+{
+	const bool constantX = x.isConstant();
+	const bool ramp = (g0 != g1);
+	const float step = ramp ? (g1 - g0) / (float)frames : 0.f;
+	const MLSample* px = x.getConstBuffer();
+
+	__m128 vx = _mm_set1_ps(px[0]);
+	__m128 vg = ramp ? _mm_add_ps(_mm_set1_ps(g0), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(1.f, 2.f, 3.f, 4.f))) : _mm_set1_ps(g1);
+	const __m128 vStep = _mm_set1_ps(step*kSSEVecSize);
+	int n = 0;
+	for(; n + 3 < frames; n += kSSEVecSize)
+	{
+		if (!constantX)
+		{
+			vx = _mm_load_ps(px + n);
+		}
+		__m128 vy = _mm_mul_ps(vx, vg);
+		if (!first)
+		{
+			vy = _mm_add_ps(vy, _mm_load_ps(py + n));
+		}
+		_mm_store_ps(py + n, vy);
+		vg = _mm_add_ps(vg, vStep);
+	}
+	for(; n < frames; ++n)
+	{
+		const float g = ramp ? g0 + step*(float)(n + 1) : g1;
+		const float v = g*(constantX ? px[0] : px[n]);
+		py[n] = first ? v : py[n] + v;
+	}
+}
+
 void MLProcMatrix::process(const int frames)
 {
 	const int inputs = min(kMLMatrixMaxIns, getNumInputs());
@@ -135,27 +207,71 @@ void MLProcMatrix::process(const int frames)
 	{
 		calcCoeffs();
 	}
-    
-    
-	// TODO optimize, calc constants
+	if (mRoutesChanged)
+	{
+		buildRoutes();
+	}
 	
+	// gains that change are ramped linearly over one block.
+	// routes are sorted by output, so each output is visited once.
+	const int numRoutes = (int)mRoutes.size();
+	bool fadedOut = false;
+	int r = 0;
 	for (int j=1; j <= outputs; ++j)
 	{
 		MLSignal& y = getOutput(j);
-		y.clear();
-		for (int i=1; i <= inputs; ++i)
+		if ((r >= numRoutes) || (mRoutes[r].mOut != j))
+		{
+			y.setToConstant(0.f);
+			continue;
+		}
+		
+		// if all inputs to this output are constant and no gains are changing,
+		// the output is constant.
+		bool constantOut = true;
+		int end = r;
+		while((end < numRoutes) && (mRoutes[end].mOut == j))
 		{
-			const MLSignal& x = getInput(i);
-			if (mGain[i][j] > 0.)
+			const int i = mRoutes[end].mIn;
+			if (!getInput(i).isConstant() || (mGain[i][j] != mCurrentGain[i][j]))
 			{
-				for (int n=0; n < frames; ++n)
+				constantOut = false;
+			}
+			end++;
+		}
+		
+		if (constantOut)
+		{
+			MLSample sum = 0.f;
+			for(; r < end; ++r)
+			{
+				const int i = mRoutes[r].mIn;
+				sum += getInput(i)[0]*mGain[i][j];
+			}
+			y.setToConstant(sum);
+		}
+		else
+		{
+			y.setConstant(false);
+			MLSample* py = y.getBuffer();
+			for(bool first = true; r < end; ++r, first = false)
+			{
+				const int i = mRoutes[r].mIn;
+				const float g0 = mCurrentGain[i][j];
+				const float g1 = mGain[i][j];
+				routeSignal(getInput(i), py, frames, g0, g1, first);
+				mCurrentGain[i][j] = g1;
+				if ((g1 == 0.f) && (g0 != 0.f))
 				{
-					y[n] += x[n];
+					fadedOut = true;
 				}
 			}
 		}
 	}
+	
+	// drop routes that have finished fading out.
+	if (fadedOut)
+	{
+		mRoutesChanged = true;
+	}
 }
-
-
-
@@ -24,6 +24,10 @@ public:
 	void connect(int a, int b);
 	void disconnect(int a, int b);
 	bool getConnection(int a, int b);
+	
+	// set the gain from input a to output b. 0 disconnects.
+	void setGain(int a, int b, float g);
+	float getGain(int a, int b);
 
 	void clear(){};
 	void process(const int frames);		
@@ -31,8 +35,26 @@ public:
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
+	// one connection from an input to an output.
+	class Route
+	{
+	public:
+		int mIn;
+		int mOut;
+	};
+	
+	void buildRoutes();
+	
 	MLProcInfo<MLProcMatrix> mInfo;
+	
+	// target gains, and gains at the end of the last processed block.
 	MLSample mGain[kMLMatrixMaxIns + 1][kMLMatrixMaxOuts + 1];
+	MLSample mCurrentGain[kMLMatrixMaxIns + 1][kMLMatrixMaxOuts + 1];
+	
+	// the connections with nonzero target or current gains, sorted by output.
+	// rebuilt only when connections change.
+	std::vector<Route> mRoutes;
+	bool mRoutesChanged;
     int mInputs;
     int mOutputs;
     
@@ -0,0 +1,209 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLDSPUtils.h"
+
+const int kMLMultiPanMaxSources = 8;
+const int kMLMultiPanMaxSpeakers = 8;
+
+// ----------------------------------------------------------------
+// class definition
+
+// pans up to eight sources to a ring of 2 to 8 evenly spaced speakers in one pass,
+// so that voices can be spatialized without a pan and a sum per voice. 
+//
+// each source has an input and a position input, which is the angle around the 
+// listener as a fraction of a circle: 0 is front, 0.25 is right, 0.5 is behind. 
+// speakers: number of speakers in the ring. Speaker 1 is at the front left and 
+// the rest follow clockwise, so 2 speakers are left and right and 4 are front left, 
+// front right, rear right and rear left.
+//
+// gains come from pairwise 2D vector base amplitude panning (VBAP), normalized to 
+// equal power. For two speakers this is the equal-power stereo pan law.
+// Gains are computed once per vector from the last position value, and
+// ramped across the vector. Sources with constant zero input are not mixed.
+
+class MLProcMultiPan : public MLProc
+{
+public:
+	 MLProcMultiPan();
+	~MLProcMultiPan();
+
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcMultiPan> mInfo;
+	void calcCoeffs();
+	void getGains(MLSample pos, MLSample* pGains);
+
+	int mSpeakers;
+	MLSample mGains[kMLMultiPanMaxSources][kMLMultiPanMaxSpeakers];
+	MLSample mTargetGains[kMLMultiPanMaxSpeakers];
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcMultiPan> classReg("multi_pan");
+	ML_UNUSED MLProcParam<MLProcMultiPan> params[] = { "speakers" };
+	ML_UNUSED MLProcInput<MLProcMultiPan> inputs[] = { 
+		"in1", "in2", "in3", "in4", "in5", "in6", "in7", "in8",
+		"pos1", "pos2", "pos3", "pos4", "pos5", "pos6", "pos7", "pos8" };
+	ML_UNUSED MLProcOutput<MLProcMultiPan> outputs[] = { 
+		"out1", "out2", "out3", "out4", "out5", "out6", "out7", "out8" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcMultiPan::MLProcMultiPan() :
+	mSpeakers(4)
+{
+	setParam("speakers", 4);
+	clear();
+}
+
+MLProcMultiPan::~MLProcMultiPan()
+{
+}
+
+void MLProcMultiPan::clear()
+{
+	for(int s=0; s<kMLMultiPanMaxSources; ++s)
+	{
+		for(int k=0; k<kMLMultiPanMaxSpeakers; ++k)
+		{
+			mGains[s][k] = 0.f;
+		}
+	}
+}
+
+void MLProcMultiPan::calcCoeffs()
+{
+	static const MLSymbol speakersSym("speakers");
+	const int speakers = clamp((int)getParam(speakersSym), 2, kMLMultiPanMaxSpeakers);
+	if (speakers != mSpeakers)
+	{
+		mSpeakers = speakers;
+		clear();
+	}
+	mParamsChanged = false;
+}
+
+// get the gain of each speaker for a source at pos.
+void MLProcMultiPan::getGains(MLSample pos, MLSample* pGains)
+{
+	const int n = mSpeakers;
+	for(int k=0; k<n; ++k)
+	{
+		pGains[k] = 0.f;
+	}
+	
+	// find the pair of speakers around the source, and the fractional position between them.
+	// speaker k is at (k - 0.5)/n of a circle.
+	float u = pos + 0.5f/(float)n;
+	u -= floorf(u);
+	const float a = u*(float)n;
+	const int k1 = min((int)a, n - 1);
+	const int k2 = (k1 + 1 == n) ? 0 : k1 + 1;
+	const float f = a - (float)k1;
+	
+	float g1, g2;
+	if (n == 2)
+	{
+		g1 = cosf(f*kMLPi*0.5f);
+		g2 = sinf(f*kMLPi*0.5f);
+	}
+	else
+	{
+		// 2D VBAP between speakers an arc phi apart. the 1/sin(phi) factor
+		// is removed by the normalization.
+		const float phi = kMLTwoPi/(float)n;
+		g1 = sinf((1.f - f)*phi);
+		g2 = sinf(f*phi);
+		const float norm = 1.f/sqrtf(g1*g1 + g2*g2);
+		g1 *= norm;
+		g2 *= norm;
+	}
+	pGains[k1] = g1;
+	pGains[k2] = g2;
+}
+
+// add x times a gain ramping from g0 to g1 across the vector to y.
+static void addRamped(const MLSignal& x, MLSample* py, const MLSample g0, const MLSample g1, const int frames)
+{
+	const MLSample dg = (g1 - g0)/(float)frames;
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	const MLSample* px = x.getConstBuffer();
+	const bool kx = x.isConstant();
+	const __m128 vx0 = _mm_set1_ps(x[0]);
+	__m128 vg = _mm_add_ps(_mm_set1_ps(g0), _mm_mul_ps(_mm_set_ps(4.f, 3.f, 2.f, 1.f), _mm_set1_ps(dg)));
+	const __m128 vdg = _mm_set1_ps(dg*kSSEVecSize);
+	int n;
+	for(n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 vx = kx ? vx0 : _mm_load_ps(px + n);
+		_mm_store_ps(py + n, _mm_add_ps(_mm_load_ps(py + n), _mm_mul_ps(vx, vg)));
+		vg = _mm_add_ps(vg, vdg);
+	}
+	for(; n<frames; ++n)
+	{
+		py[n] += x[n]*(g0 + dg*(n + 1));
+	}
+}
+
+void MLProcMultiPan::process(const int frames)
+{
+	if (mParamsChanged) calcCoeffs();
+	
+	bool written[kMLMultiPanMaxSpeakers];
+	for(int k=0; k<kMLMultiPanMaxSpeakers; ++k)
+	{
+		written[k] = false;
+	}
+	
+	for(int s=0; s<kMLMultiPanMaxSources; ++s)
+	{
+		const MLSignal& x = getInput(s + 1);
+		const MLSignal& pos = getInput(s + 1 + kMLMultiPanMaxSources);
+		MLSample* pGains = mGains[s];
+		getGains(pos[frames - 1], mTargetGains);
+		
+		const bool silent = x.isConstant() && (x[0] == 0.f);
+		for(int k=0; k<mSpeakers; ++k)
+		{
+			const MLSample g0 = pGains[k];
+			const MLSample g1 = mTargetGains[k];
+			if (!silent && ((g0 != 0.f) || (g1 != 0.f)))
+			{
+				MLSignal& y = getOutput(k + 1);
+				if (!written[k])
+				{
+					y.clear();
+					written[k] = true;
+				}
+				addRamped(x, y.getBuffer(), g0, g1, frames);
+			}
+			pGains[k] = g1;
+		}
+	}
+	
+	for(int k=0; k<kMLMultiPanMaxSpeakers; ++k)
+	{
+		MLSignal& y = getOutput(k + 1);
+		if (written[k])
+		{
+			y.setConstant(false);
+		}
+		else
+		{
+			y.setToConstant(0.f);
+		}
+	}
+}
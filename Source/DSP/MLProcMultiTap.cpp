@@ -0,0 +1,234 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLDSPUtils.h"
+
+const int kMLMultiTapMaxTaps = 8;
+
+// ----------------------------------------------------------------
+// class definition
+
+// a delay line with up to eight read taps on one buffer. Each tap has a time input
+// and a gain param. Each tap is available on its own output, and "out" is the sum
+// of all taps times their gains. Taps with zero gain and nothing connected to
+// their outputs are not read.
+//
+// all taps use the same interpolation mode, which takes the same values
+// as the "interpolation" param of delay_output.
+
+class MLProcMultiTap : public MLProc
+{
+public:
+	 MLProcMultiTap();
+	~MLProcMultiTap();
+
+	err resize();
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcMultiTap> mInfo;
+	void calcCoeffs();
+
+	MLDelayBuffer mBuffer;
+	int mInterpolation;
+	float mMinDelay;
+	MLSample mGain[kMLMultiTapMaxTaps];
+	MLDelayBuffer::AllpassState mAllpassState[kMLMultiTapMaxTaps];
+
+	// per-vector scratch: tap output when the tap has no connected output, and delays in samples.
+	MLSignal mTapBuffer;
+	MLSignal mDelays;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcMultiTap> classReg("multitap_delay");
+	ML_UNUSED MLProcParam<MLProcMultiTap> params[] = { "length", "interpolation",
+		"gain1", "gain2", "gain3", "gain4", "gain5", "gain6", "gain7", "gain8" };
+	ML_UNUSED MLProcInput<MLProcMultiTap> inputs[] = { "in",
+		"time1", "time2", "time3", "time4", "time5", "time6", "time7", "time8" };
+	ML_UNUSED MLProcOutput<MLProcMultiTap> outputs[] = { "out",
+		"out1", "out2", "out3", "out4", "out5", "out6", "out7", "out8" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcMultiTap::MLProcMultiTap() :
+	mInterpolation(kMLDelayInterpNone),
+	mMinDelay(0.f)
+{
+	setParam("length", 1.f);
+	setParam("interpolation", 0);
+	for(int i=0; i<kMLMultiTapMaxTaps; ++i)
+	{
+		setParam(MLSymbol("gain").withFinalNumber(i + 1), 0.f);
+		mGain[i] = 0.f;
+	}
+}
+
+MLProcMultiTap::~MLProcMultiTap()
+{
+}
+
+MLProc::err MLProcMultiTap::resize()
+{
+	MLProc::err e = OK;
+	const float sr = getContextSampleRate();
+	const int vecSize = getContextVectorSize();
+	if (!mBuffer.resize((int)(getParam("length") * sr)))
+	{
+		e = memErr;
+	}
+	if (!mTapBuffer.setDims(vecSize) || !mDelays.setDims(vecSize))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcMultiTap::clear()
+{
+	mBuffer.clear();
+	for(int i=0; i<kMLMultiTapMaxTaps; ++i)
+	{
+		mAllpassState[i].clear();
+	}
+}
+
+void MLProcMultiTap::calcCoeffs()
+{
+	static const MLSymbol interpSym("interpolation");
+	static MLSymbol gainSyms[kMLMultiTapMaxTaps];
+	if (!gainSyms[0])
+	{
+		for(int i=0; i<kMLMultiTapMaxTaps; ++i)
+		{
+			gainSyms[i] = MLSymbol("gain").withFinalNumber(i + 1);
+		}
+	}
+
+	mInterpolation = clamp((int)getParam(interpSym), (int)kMLDelayInterpNone, (int)kMLDelayInterpSinc);
+	mMinDelay = MLDelayBuffer::getMinimumDelay(mInterpolation);
+	for(int i=0; i<kMLMultiTapMaxTaps; ++i)
+	{
+		mGain[i] = getParam(gainSyms[i]);
+	}
+	mParamsChanged = false;
+}
+
+void MLProcMultiTap::process(const int frames)
+{
+	const MLSignal& x = getInput(1);
+	MLSignal& y = getOutput(1);
+	const MLSignal& nullOutput = getContext()->getNullOutput();
+	const float sr = getContextSampleRate();
+
+	if (mParamsChanged) calcCoeffs();
+
+	const uintptr_t pos = mBuffer.getWriteIndex();
+	mBuffer.write(x, frames);
+
+	// find the taps to read, then sort them by delay so that the buffer
+	// is read in one pass from the most recent samples backwards.
+	int taps[kMLMultiTapMaxTaps];
+	int activeTaps = 0;
+	for(int i=0; i<kMLMultiTapMaxTaps; ++i)
+	{
+		const bool connected = (&getOutput(i + 2) != &nullOutput);
+		if (connected || (mGain[i] != 0.f))
+		{
+			const float t = getInput(i + 2)[0];
+			int j = activeTaps++;
+			while((j > 0) && (getInput(taps[j - 1] + 2)[0] > t))
+			{
+				taps[j] = taps[j - 1];
+				j--;
+			}
+			taps[j] = i;
+		}
+	}
+
+	y.setConstant(false);
+	MLSample* py = y.getBuffer();
+
+	// if every tap has a constant time, read them all and mix the sum in one pass.
+	bool allConstant = (mInterpolation != kMLDelayInterpAllpass);
+	for(int k=0; allConstant && (k<activeTaps); ++k)
+	{
+		allConstant = getInput(taps[k] + 2).isConstant();
+	}
+	if (allConstant)
+	{
+		MLSample* pTaps[kMLMultiTapMaxTaps];
+		float gains[kMLMultiTapMaxTaps];
+		float delays[kMLMultiTapMaxTaps];
+		for(int k=0; k<activeTaps; ++k)
+		{
+			const int i = taps[k];
+			MLSignal& tapOut = getOutput(i + 2);
+			const bool connected = (&tapOut != &nullOutput);
+			pTaps[k] = connected ? tapOut.getBuffer() : mTapBuffer.getBuffer();
+			if (connected)
+			{
+				tapOut.setConstant(false);
+			}
+			gains[k] = mGain[i];
+			delays[k] = max(getInput(i + 2)[0] * sr, mMinDelay);
+		}
+		mBuffer.gatherConstant(pTaps, gains, py, activeTaps, frames, pos, delays, mInterpolation);
+		return;
+	}
+
+	y.clear();
+	for(int k=0; k<activeTaps; ++k)
+	{
+		const int i = taps[k];
+		const MLSignal& time = getInput(i + 2);
+		MLSignal& tapOut = getOutput(i + 2);
+		const bool connected = (&tapOut != &nullOutput);
+		MLSample* pTap = connected ? tapOut.getBuffer() : mTapBuffer.getBuffer();
+
+		if (time.isConstant())
+		{
+			float delay = max(time[0] * sr, mMinDelay);
+			mBuffer.readConstant(pTap, frames, pos, delay, mInterpolation, mAllpassState[i]);
+		}
+		else
+		{
+			MLSample* pd = mDelays.getBuffer();
+			for(int n=0; n<frames; ++n)
+			{
+				pd[n] = max(time[n] * sr, mMinDelay);
+			}
+			mBuffer.readModulated(pTap, frames, pos, pd, mInterpolation, mAllpassState[i]);
+		}
+		if (connected)
+		{
+			tapOut.setConstant(false);
+		}
+
+		// mix into sum output
+		const float gain = mGain[i];
+		if (gain != 0.f)
+		{
+			const __m128 vGain = _mm_set1_ps(gain);
+			int n = 0;
+			for (; n + 3 < frames; n += kSSEVecSize)
+			{
+				_mm_store_ps(py + n, _mm_add_ps(_mm_load_ps(py + n), _mm_mul_ps(vGain, _mm_load_ps(pTap + n))));
+			}
+			for (; n < frames; ++n)
+			{
+				py[n] += gain*pTap[n];
+			}
+		}
+	}
+}
@@ -92,7 +92,7 @@ void MLProcMultiply::process(const int frames)
 	const bool k2 = mpX2->isConstant();
 	int constantMode = (k1 << 1) + k2;	
 
-	int c = frames >> kMLSamplesPerSSEVectorBits;
+	int c = SSEVectorsToCover(frames);
 	__m128 vx1, vx2, vr; 	
 
 	switch(constantMode)
@@ -150,7 +150,7 @@ void MLProcMultiplyAdd::process(const int frames)
 	const MLSample* pa1 = a1.getConstBuffer();
 	MLSample* pout = out.getBuffer();
 	__m128 vm1, vm2, va1, vr; 
-	int c = frames >> kMLSamplesPerSSEVectorBits;
+	int c = SSEVectorsToCover(frames);
 
 	const int mode = (km1 << 2) + (km2 << 1) + ka1;
 	
@@ -1,4 +1,3 @@
-
 // MadronaLib: a C++ framework for DSP applications.
 // Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
@@ -7,22 +6,35 @@
 #include <string>
 #include <math.h>
 #include "MLProc.h"
+#include "MLDSPUtils.h"
 
 // ----------------------------------------------------------------
 // class definition
 
+// type: 0 = uniform, 1 = Gaussian, 2 = pink, 3 = brown.
+// seed: if nonzero, the generator starts from this seed. Otherwise the seed is made 
+// from the proc's name and copy index, so each voice has its own stream and 
+// the output is the same each time the engine is run from a clear() .
+
 class MLProcNoise : public MLProc
 {
 public:
 	 MLProcNoise();
 	~MLProcNoise();
 	
-	void clear(){};
+	void clear();
 	void process(const int n);		
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
 	MLProcInfo<MLProcNoise> mInfo;
+	void doParams();
+	uint32_t getSeed();
+	
+	MLNoiseGen mGen;
+	eMLNoiseType mType;
+	MLSample mGain;
+	uint32_t mSeed;
 };
 
 
@@ -31,7 +43,7 @@ private:
 
 namespace{
 MLProcRegistryEntry<MLProcNoise> classReg("noise");
-ML_UNUSED MLProcParam<MLProcNoise> params[1] = { "gain" };
+ML_UNUSED MLProcParam<MLProcNoise> params[] = { "gain", "type", "seed" };
 //ML_UNUSED MLProcInput<MLProcNoise> inputs[] = {"gain"}; 
 ML_UNUSED MLProcOutput<MLProcNoise> outputs[] = {"out"};
 }	// namespace
@@ -39,25 +51,61 @@ ML_UNUSED MLProcOutput<MLProcNoise> outputs[] = {"out"};
 // ----------------------------------------------------------------
 // implementation
 
-MLProcNoise::MLProcNoise()
+MLProcNoise::MLProcNoise() :
+	mType(kMLNoiseUniform),
+	mGain(0.f),
+	mSeed(0)
 {
+	setParam("gain", 0.f);
+	setParam("type", 0);
+	setParam("seed", 0);
 }
 
 MLProcNoise::~MLProcNoise()
 {
 }
 
+uint32_t MLProcNoise::getSeed()
+{
+	static MLSymbol seedSym("seed");
+	uint32_t s = (uint32_t)getParam(seedSym);
+	return s ? s : getInstanceSeed();
+}
+
+void MLProcNoise::clear()
+{
+	mSeed = getSeed();
+	mGen.seed(mSeed);
+}
+
+void MLProcNoise::doParams()
+{
+	static MLSymbol gainSym("gain");
+	static MLSymbol typeSym("type");
+	mGain = getParam(gainSym);
+	mType = (eMLNoiseType)clamp((int)getParam(typeSym), (int)kMLNoiseUniform, (int)kMLNoiseBrown);
+	uint32_t s = getSeed();
+	if (s != mSeed)
+	{
+		mSeed = s;
+		mGen.seed(mSeed);
+	}
+	mParamsChanged = false;
+}
+
 void MLProcNoise::process(const int samples)
 {	
-	static MLSymbol gainSym("gain");
 	MLSignal& y = getOutput();
-	y.setConstant(false); // ?
-	MLSample gain = getParam(gainSym);
+	if (mParamsChanged) doParams();
 	
-	for (int n=0; n<samples; ++n)
+	MLSample* py = y.getBuffer();
+	mGen.process(py, samples, mType);
+	if (mGain != 1.f)
 	{
-		y[n] = MLRand() * gain;
+		for (int n=0; n<samples; ++n)
+		{
+			py[n] *= mGain;
+		}
 	}
+	y.setConstant(false);
 }
-
-
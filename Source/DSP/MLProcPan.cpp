@@ -1,5 +1,3 @@
-
-
 // MadronaLib: a C++ framework for DSP applications.
 // Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
@@ -10,20 +8,32 @@
 // ----------------------------------------------------------------
 // class definition
 
+// stereo panner. pan is on [-1, 1]. 
+// law: 0 = linear, 1 = equal power.
+//
+// the pan position is smoothed by a one-pole slew limiter. When pan is constant,
+// the slew is computed once per vector and the gains are ramped across the vector.
+
 class MLProcPan : public MLProc
 {
 public:
 	 MLProcPan();
 	~MLProcPan();
 
-	void clear(){};
+	err resize();
+	void clear();
 	void process(const int n);		
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
 	MLProcInfo<MLProcPan> mInfo;
 	void calcCoeffs(void);
-    MLBiquad mSlewLimiter;
+	inline void getGains(const MLSample pos, MLSample& gl, MLSample& gr);
+
+	bool mEqualPower;
+	MLSample mSlewCoeff;
+	MLSample mPos;
+	MLSignal mPosSignal;
 };
 
 // ----------------------------------------------------------------
@@ -32,51 +42,182 @@ private:
 namespace
 {
 	MLProcRegistryEntry<MLProcPan> classReg("pan");
-	// no parameters, all signals. 
+	ML_UNUSED MLProcParam<MLProcPan> params[] = { "law" };
 	ML_UNUSED MLProcInput<MLProcPan> inputs[] = {"in", "pan"}; 
 	ML_UNUSED MLProcOutput<MLProcPan> outputs[] = {"out_l", "out_r"};
 }
 
+static const float kPanSlewFrequency = 500.f;
+static const float kPanSlewEpsilon = 1e-5f;
+
 // ----------------------------------------------------------------
 // implementation
 
-MLProcPan::MLProcPan()
+MLProcPan::MLProcPan() :
+	mEqualPower(false),
+	mSlewCoeff(0.f),
+	mPos(0.f)
 {
+	setParam("law", 0);
 }
 
 MLProcPan::~MLProcPan()
 {
 }
 
+MLProc::err MLProcPan::resize()
+{
+	MLProc::err e = OK;
+	if (!mPosSignal.setDims(getContextVectorSize()))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcPan::clear()
+{
+	mPos = 0.f;
+}
+
 void MLProcPan::calcCoeffs(void) 
 {
-    int sr = getContextSampleRate();
-    mSlewLimiter.setSampleRate(sr);
-    mSlewLimiter.setOnePole(500);
-    
+	static const MLSymbol lawSym("law");
+	const float sr = getContextSampleRate();
+	mSlewCoeff = expf(-kMLTwoPi*kPanSlewFrequency/sr);
+	mEqualPower = getParam(lawSym) > 0.f;
 	mParamsChanged = false;
 }
 
+inline void MLProcPan::getGains(const MLSample pos, MLSample& gl, MLSample& gr)
+{
+	const MLSample p = clamp(pos*0.5f + 0.5f, 0.f, 1.f);
+	gl = 1.f - p;
+	gr = p;
+	if (mEqualPower)
+	{
+		gl = sqrtf(gl);
+		gr = sqrtf(gr);
+	}
+}
+
 void MLProcPan::process(const int samples)
 {	
 	const MLSignal& x = getInput(1);
 	const MLSignal& pan = getInput(2);
 	MLSignal& out1 = getOutput();
 	MLSignal& out2 = getOutput(2);
-	float in, p, pos;
-	const float half = 0.5f;
+	const MLSample* px = x.getConstBuffer();
+	MLSample* pl = out1.getBuffer();
+	MLSample* pr = out2.getBuffer();
+	const int vFrames = samples & ~(kSSEVecSize - 1);
+	int n;
     
-	// coeffs
 	if (mParamsChanged) calcCoeffs();
-	calcCoeffs();
     
-	for (int n=0; n<samples; ++n)
+	if (pan.isConstant())
+	{
+		// slew once for the whole vector.
+		const MLSample target = pan[0];
+		MLSample posEnd = target + (mPos - target)*powf(mSlewCoeff, (float)samples);
+		if (fabsf(posEnd - target) < kPanSlewEpsilon) 
+		{
+			posEnd = target;
+		}
+		MLSample gl0, gr0, gl1, gr1;
+		getGains(mPos, gl0, gr0);
+		getGains(posEnd, gl1, gr1);
+		mPos = posEnd;
+		
+		if ((gl0 == gl1) && (gr0 == gr1))
+		{
+			if (x.isConstant())
+			{
+				out1.setToConstant(x[0]*gl1);
+				out2.setToConstant(x[0]*gr1);
+				return;
+			}
+			const __m128 vl = _mm_set1_ps(gl1);
+			const __m128 vr = _mm_set1_ps(gr1);
+			for (n=0; n<vFrames; n += kSSEVecSize)
+			{
+				const __m128 vx = _mm_load_ps(px + n);
+				_mm_store_ps(pl + n, _mm_mul_ps(vx, vl));
+				_mm_store_ps(pr + n, _mm_mul_ps(vx, vr));
+			}
+			for (; n<samples; ++n)
+			{
+				pl[n] = px[n]*gl1;
+				pr[n] = px[n]*gr1;
+			}
+		}
+		else
+		{
+			// ramp the gains across the vector.
+			const MLSample dl = (gl1 - gl0)/(float)samples;
+			const MLSample dr = (gr1 - gr0)/(float)samples;
+			const __m128 vk = _mm_set_ps(4.f, 3.f, 2.f, 1.f);
+			__m128 vl = _mm_add_ps(_mm_set1_ps(gl0), _mm_mul_ps(vk, _mm_set1_ps(dl)));
+			__m128 vr = _mm_add_ps(_mm_set1_ps(gr0), _mm_mul_ps(vk, _mm_set1_ps(dr)));
+			const __m128 vdl = _mm_set1_ps(dl*kSSEVecSize);
+			const __m128 vdr = _mm_set1_ps(dr*kSSEVecSize);
+			const __m128 vx0 = _mm_set1_ps(x[0]);
+			const bool kx = x.isConstant();
+			for (n=0; n<vFrames; n += kSSEVecSize)
+			{
+				const __m128 vx = kx ? vx0 : _mm_load_ps(px + n);
+				_mm_store_ps(pl + n, _mm_mul_ps(vx, vl));
+				_mm_store_ps(pr + n, _mm_mul_ps(vx, vr));
+				vl = _mm_add_ps(vl, vdl);
+				vr = _mm_add_ps(vr, vdr);
+			}
+			for (; n<samples; ++n)
+			{
+				pl[n] = x[n]*(gl0 + dl*(n + 1));
+				pr[n] = x[n]*(gr0 + dr*(n + 1));
+			}
+		}
+	}
+	else
 	{
-		in = x[n];
-        pos = mSlewLimiter.processSample(pan[n]);
-		pos = pos * half + half;
-		p = in*pos;
-		out1[n] = in - p;
-		out2[n] = p;
+		// slew the pan signal, then apply the gains.
+		MLSample* pPos = mPosSignal.getBuffer();
+		const MLSample* pPan = pan.getConstBuffer();
+		const MLSample a = mSlewCoeff;
+		MLSample pos = mPos;
+		for (n=0; n<samples; ++n)
+		{
+			pos = pPan[n] + (pos - pPan[n])*a;
+			pPos[n] = pos;
+		}
+		mPos = pos;
+		
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		for (n=0; n<vFrames; n += kSSEVecSize)
+		{
+			__m128 vp = _mm_add_ps(_mm_mul_ps(_mm_load_ps(pPos + n), half), half);
+			vp = _mm_min_ps(_mm_max_ps(vp, zero), one);
+			__m128 vl = _mm_sub_ps(one, vp);
+			__m128 vr = vp;
+			if (mEqualPower)
+			{
+				vl = _mm_sqrt_ps(vl);
+				vr = _mm_sqrt_ps(vr);
+			}
+			const __m128 vx = x.isConstant() ? _mm_set1_ps(x[0]) : _mm_load_ps(px + n);
+			_mm_store_ps(pl + n, _mm_mul_ps(vx, vl));
+			_mm_store_ps(pr + n, _mm_mul_ps(vx, vr));
+		}
+		for (; n<samples; ++n)
+		{
+			MLSample gl, gr;
+			getGains(pPos[n], gl, gr);
+			pl[n] = x[n]*gl;
+			pr[n] = x[n]*gr;
+		}
 	}
+	out1.setConstant(false);
+	out2.setConstant(false);
 }
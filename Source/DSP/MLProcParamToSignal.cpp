@@ -9,6 +9,8 @@
 // ----------------------------------------------------------------
 // class definition
 
+// makes a signal from the "in" parameter. If the engine is smoothing the parameter, 
+// the ramp it sends each vector is written directly, and glide is not used. 
 
 class MLProcParamToSignal : public MLProc
 {
@@ -20,6 +22,7 @@ public:
 
 	void clear(){};
 	void process(const int n);		
+	void setParamRamp(MLParamValue* pValue, const MLParamRamp& ramp);
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
@@ -27,6 +30,10 @@ private:
 	MLChangeList mChangeList;
 	MLSample mVal;	
 	float mGlide;
+	
+	MLParamValue* mpInValue;
+	MLParamRamp mRamp;
+	bool mHasRamp;
 };
 
 
@@ -44,10 +51,14 @@ namespace
 // implementation
 
 
-MLProcParamToSignal::MLProcParamToSignal()
+MLProcParamToSignal::MLProcParamToSignal() :
+	mVal(0.f),
+	mGlide(0.f),
+	mHasRamp(false)
 {
 //	debug() << "MLProcParamToSignal constructor\n";
 	setParam("glide", 0.01f);
+	mpInValue = mInfo.getParamPtr("in");
 }
 
 
@@ -70,19 +81,54 @@ MLProc::err MLProcParamToSignal::resize()
 	return OK;
 }
 
+void MLProcParamToSignal::setParamRamp(MLParamValue* pValue, const MLParamRamp& ramp)
+{
+	MLProc::setParamRamp(pValue, ramp);
+	if (pValue == mpInValue)
+	{
+		mRamp = ramp;
+		mHasRamp = true;
+	}
+}
+
 void MLProcParamToSignal::process(const int frames)
 {
+	static const MLSymbol inSym("in");
+	static const MLSymbol glideSym("glide");
 	MLSignal& y = getOutput();
 	if (mParamsChanged)
 	{
-		mVal = getParam("in");
-		mChangeList.addChange(mVal, 0);
-		mGlide = getParam("glide");
+		mVal = getParam(inSym);
+		mGlide = getParam(glideSym);
 		mChangeList.setGlideTime(mGlide);
+		if (mHasRamp)
+		{
+			mChangeList.setValue(mVal);
+		}
+		else
+		{
+			mChangeList.addChange(mVal, 0);
+		}
 		mParamsChanged = false;
 	}
 	
-	if (mGlide == 0.f)
+	if (mHasRamp)
+	{
+		if (mRamp.isConstant())
+		{
+			y.setToConstant(mRamp.end);
+		}
+		else
+		{
+			for(int n=0; n<frames; ++n)
+			{
+				y[n] = mRamp.getValue(n);
+			}
+			y.setConstant(false);
+		}
+		mHasRamp = false;
+	}
+	else if (mGlide == 0.f)
 	{
 		y.setToConstant(mVal);
 	}
@@ -47,19 +47,50 @@ MLProcPow::~MLProcPow()
 }
 
 
+// powers of positive bases are computed four at a time with the vector math functions.
+// bases of zero or less fall back to powf(), so integer powers of negative numbers still work.
 void MLProcPow::process(const int frames)
 {
 	const MLSignal& base = getInput(1);
 	const MLSignal& exp = getInput(2);
 	MLSignal& out = getOutput();
 	
-	for (int n=0; n<frames; ++n)
+	const bool kb = base.isConstant();
+	const bool ke = exp.isConstant();
+	if (kb && ke)
 	{
-		out[n] = powf(base[n], exp[n]);
+		out.setToConstant(powf(base[0], exp[0]));
+		return;
 	}
+	
+	const MLSample* pb = base.getConstBuffer();
+	const MLSample* pe = exp.getConstBuffer();
+	MLSample* py = out.getBuffer();
+	const __m128 vb0 = _mm_set1_ps(base[0]);
+	const __m128 ve0 = _mm_set1_ps(exp[0]);
+	const __m128 zero = _mm_setzero_ps();
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	
+	for (n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 vb = kb ? vb0 : _mm_load_ps(pb + n);
+		const __m128 ve = ke ? ve0 : _mm_load_ps(pe + n);
+		_mm_store_ps(py + n, powPrecise4(vb, ve));
+		if (_mm_movemask_ps(_mm_cmple_ps(vb, zero)))
+		{
+			for (int i=n; i<n + (int)kSSEVecSize; ++i)
+			{
+				if (base[i] <= 0.f)
+				{
+					py[i] = powf(base[i], exp[i]);
+				}
+			}
+		}
+	}
+	for (; n<frames; ++n)
+	{
+		py[n] = powf(base[n], exp[n]);
+	}
+	out.setConstant(false);
 }
-
-
-
-
-
@@ -1,13 +1,23 @@
-
 // MadronaLib: a C++ framework for DSP applications.
 // Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
 #include "MLProc.h"
+#include "MLProcContainer.h"
+#include "MLProcInputToSignals.h"
+#include "MLDSPEngine.h"
+#include "MLScale.h"
 
 // ----------------------------------------------------------------
 // class definition
 
+// quantize a pitch signal in linear octave space to the nearest pitch in the 
+// engine's current scale, using the scale's quantize table. 
+//
+// on: if 0, the input is passed through.
+// hysteresis: how far the input must go past the midpoint between two scale 
+// pitches to change pitch, as a fraction of half the interval, from 0 to 0.9.
+// glide: time in seconds to glide linearly to each new pitch.
 
 class MLProcQuantize : public MLProc
 {
@@ -15,70 +25,214 @@ public:
 	MLProcQuantize();
 	~MLProcQuantize();
 	
-
-	void clear(){};
+	err resize();
+	void clear();
 	void process(const int frames);		
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
 	MLProcInfo<MLProcQuantize> mInfo;
+	void doParams();
+	inline int chooseIndex(const MLScaleQuantizeTable* t, const MLSample x);
+	inline void setIndex(const MLScaleQuantizeTable* t, const int i);
+	
+	// used if there is no engine scale to find.
+	MLScale mDefaultScale;
+	const MLScale* mpScale;
+	
+	bool mOn;
+	MLSample mHysteresis;
+	int mGlideSamples;
+	
+	int mIndex;
+	MLSample mValue;
+	MLSample mGlideStep;
+	int mGlideCounter;
+	
+	MLSignal mCells;
 };
 
-
 // ----------------------------------------------------------------
 // registry section
 
 namespace
 {
 	MLProcRegistryEntry<MLProcQuantize> classReg("quantize");
-	ML_UNUSED MLProcParam<MLProcQuantize> params[1] = { "on" };	
+	ML_UNUSED MLProcParam<MLProcQuantize> params[] = { "on", "hysteresis", "glide" };	
 	ML_UNUSED MLProcInput<MLProcQuantize> inputs[] = { "in" };	
 	ML_UNUSED MLProcOutput<MLProcQuantize> outputs[] = { "out" };
 }
 
-
 // ----------------------------------------------------------------
 // implementation
 
-
-MLProcQuantize::MLProcQuantize()
+MLProcQuantize::MLProcQuantize() :
+	mpScale(&mDefaultScale),
+	mOn(true),
+	mHysteresis(0.f),
+	mGlideSamples(0)
 {
 	setParam("on", 1);
-//	debug() << "MLProcQuantize constructor\n";
+	setParam("hysteresis", 0.f);
+	setParam("glide", 0.f);
+	clear();
 }
 
-
 MLProcQuantize::~MLProcQuantize()
 {
-//	debug() << "MLProcQuantize destructor\n";
+}
+
+// find the scale of the engine, through the input proc in the root container.
+MLProc::err MLProcQuantize::resize()
+{
+	MLProc::err e = OK;
+	mpScale = &mDefaultScale;
+	MLProcContainer* pContainer = static_cast<MLProcContainer*>(getContext());
+	while (pContainer && !pContainer->isRoot())
+	{
+		pContainer = static_cast<MLProcContainer*>(pContainer->getContext());
+	}
+	if (pContainer)
+	{
+		MLProcPtr pInputProc = pContainer->getProc(MLPath(kMLInputToSignalProcName));
+		if (pInputProc)
+		{
+			mpScale = static_cast<MLProcInputToSignals*>(&(*pInputProc))->getScale();
+		}
+	}
+	
+	// cell indices for one vector.
+	if (!mCells.setDims(getContextVectorSize()))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcQuantize::clear()
+{
+	mIndex = -1;
+	mValue = 0.f;
+	mGlideStep = 0.f;
+	mGlideCounter = 0;
+}
+
+void MLProcQuantize::doParams()
+{
+	static const MLSymbol onSym("on");
+	static const MLSymbol hystSym("hysteresis");
+	static const MLSymbol glideSym("glide");
+	mOn = getParam(onSym) != 0.f;
+	mHysteresis = clamp(getParam(hystSym), 0.f, 0.9f);
+	mGlideSamples = (int)(getParam(glideSym)*getContextSampleRate());
+	mParamsChanged = false;
+}
+
+// choose the scale pitch for input x, staying on the current pitch unless
+// x is far enough past the midpoint.
+inline int MLProcQuantize::chooseIndex(const MLScaleQuantizeTable* t, const MLSample x)
+{
+	const int i = t->getNearestIndex(x);
+	if ((mIndex < 0) || (i == mIndex) || (mHysteresis == 0.f)) return i;
+	const MLSample pNew = t->getPitch(i);
+	const MLSample pOld = t->getPitch(mIndex);
+	return (fabsf(x - pOld) - fabsf(x - pNew) > mHysteresis*fabsf(pNew - pOld)) ? i : mIndex;
+}
+
+// move to scale pitch i, starting a glide if needed.
+inline void MLProcQuantize::setIndex(const MLScaleQuantizeTable* t, const int i)
+{
+	if (i == mIndex) return;
+	const MLSample target = t->getPitch(i);
+	if ((mGlideSamples > 0) && (mIndex >= 0))
+	{
+		mGlideCounter = mGlideSamples;
+		mGlideStep = (target - mValue)/(float)mGlideSamples;
+	}
+	else
+	{
+		mGlideCounter = 0;
+		mValue = target;
+	}
+	mIndex = i;
 }
 
 void MLProcQuantize::process(const int frames)
 {
 	const MLSignal& x = getInput(1);
 	MLSignal& y = getOutput();
-	int x12;
 	
-	if (getParam("on"))
+	if (mParamsChanged) doParams();
+	
+	if (!mOn)
 	{
-		// quantize to 12-ET
-		// TODO load tuning tables
-		for (int n=0; n < frames; ++n)
+		if (x.isConstant())
+		{
+			y.setToConstant(x[0]);
+		}
+		else
 		{
-			MLSample in = x[n];
-			x12 = (float)in*12.f;
-			y[n] = (float)x12 / 12.f;
+			y.copy(x);
 		}
+		return;
 	}
-	else
+	
+	const MLScaleQuantizeTable* t = mpScale->getQuantizeTable();
+	
+	if (x.isConstant() && (mGlideCounter == 0))
 	{
-		for (int n=0; n < frames; ++n)
+		setIndex(t, chooseIndex(t, x[0]));
+		if (mGlideCounter == 0)
 		{
-			MLSample in = x[n];
-			y[n] = in;
+			y.setToConstant(mValue);
+			return;
 		}
 	}
+	
+	if (!x.isConstant() && (mHysteresis == 0.f) && (mGlideSamples == 0))
+	{
+		// find table cells four at a time, then finish each lookup.
+		const MLSample* px = x.getConstBuffer();
+		int32_t* pCells = reinterpret_cast<int32_t*>(mCells.getBuffer());
+		const __m128 vStart = _mm_set1_ps(t->getStart());
+		const __m128 vScale = _mm_set1_ps(t->getCellsPerOctave());
+		const __m128 vMax = _mm_set1_ps((float)(kMLQuantizeTableSize - 1));
+		const __m128 vZero = _mm_setzero_ps();
+		const int vFrames = frames & ~(kSSEVecSize - 1);
+		int n;
+		for (n=0; n<vFrames; n += kSSEVecSize)
+		{
+			__m128 c = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(px + n), vStart), vScale);
+			c = _mm_min_ps(_mm_max_ps(c, vZero), vMax);
+			_mm_store_si128(reinterpret_cast<__m128i*>(pCells + n), _mm_cvttps_epi32(c));
+		}
+		for (; n<frames; ++n)
+		{
+			pCells[n] = clamp((int)((px[n] - t->getStart())*t->getCellsPerOctave()), 0, kMLQuantizeTableSize - 1);
+		}
+		for (n=0; n<frames; ++n)
+		{
+			const int i = t->getNearestIndexInCell(pCells[n], px[n]);
+			y[n] = t->getPitch(i);
+			mIndex = i;
+		}
+		mValue = y[frames - 1];
+		y.setConstant(false);
+		return;
+	}
+	
+	for (int n=0; n<frames; ++n)
+	{
+		setIndex(t, chooseIndex(t, x[n]));
+		if (mGlideCounter > 0)
+		{
+			mValue += mGlideStep;
+			if (--mGlideCounter == 0)
+			{
+				mValue = t->getPitch(mIndex);
+			}
+		}
+		y[n] = mValue;
+	}
+	y.setConstant(false);
 }
-
-
-
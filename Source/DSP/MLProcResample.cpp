@@ -398,6 +398,7 @@ private:
 	int mUpOrder;
 	int mDownOrder;
 	float mx1; // prev input value
+	uint32_t mRandState;
 	HalfBandFilter* mFilters[4]; // for second order downsampling
 	MLSignal mUp; // temp buffer for resampling up then down.
 	
@@ -431,6 +432,7 @@ MLProcResample::MLProcResample()
 	int halfBandOrder = 8; // not the overall resampling order
 	int steep = 1;
 	mx1 = 0.f;
+	mRandState = 0;
 	for(int n=0; n<4; ++n)
 	{
 		mFilters[n] = 0;
@@ -479,6 +481,7 @@ MLProc::err MLProcResample::resize()
 void MLProcResample::clear()
 {
 	mx1 = 0.f;
+	mRandState = getInstanceSeed();
 	for(int n=0; n<4; ++n)
 	{
 		if (mFilters[n])
@@ -620,6 +623,7 @@ void MLProcResample::downsample0(MLSample* pSrc, MLSample* pDest, int inFrames,
 			{
 				pDest[m++] = pSrc[n];
 			}
+		break;
 		case 8:
 			for (int n=0; n < inFrames; n += 8)
 			{
@@ -645,6 +649,7 @@ void MLProcResample::downsample1(MLSample* pSrc, MLSample* pDest, int inFrames,
 			{
 				pDest[m++] = (pSrc[n] + pSrc[n+1] + pSrc[n+2] + pSrc[n+3]) * 0.25f ;
 			}
+		break;
 		case 8:
 			for (int n=0; n < inFrames; n += 8)
 			{
@@ -668,7 +673,7 @@ void MLProcResample::downsample2(MLSample* pSrc, MLSample* pDest, int inFrames,
 		case 2:
 			for (int n = 0; n < inFrames; n += 2)
 			{
-				MLSample sss = MLRand() * noiseAmp;
+				MLSample sss = MLRand(mRandState) * noiseAmp;
 				mFilters[0]->process(pSrc[n] + sss);
 				pDest[m++] = mFilters[0]->process(pSrc[n + 1] + sss);	
 			}
@@ -4,6 +4,7 @@
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
 #include "MLProc.h"
+#include <vector>
 
 // ----------------------------------------------------------------
 // class definition
@@ -15,13 +16,14 @@ public:
 	MLProcSum();
 	~MLProcSum();
 	
-
+	err resize();
 	void clear(){};
 	void process(const int frames);		
 	MLProcInfoBase& procInfo() { return mInfo; }
 
 private:
 	MLProcInfo<MLProcSum> mInfo;
+	std::vector<const MLSignal*> mInputs;
 };
 
 
@@ -52,24 +54,20 @@ MLProcSum::~MLProcSum()
 //	debug() << "MLProcSum destructor\n";
 }
 
+MLProc::err MLProcSum::resize()
+{
+	mInputs.resize(getNumInputs());
+	return OK;
+}
+
 void MLProcSum::process(const int frames)
 {
 	const int inputs = getNumInputs();
 	MLSignal& y = getOutput();
 
-	y.clear();
-	
-	// can optimize in many ways: for small numbers of inputs,
-	// loop unrolling, etc.
 	for (int i=1; i <= inputs; ++i)
 	{
-		const MLSignal& xi = getInput(i);
-		for (int n=0; n < frames; ++n)
-		{
-			y[n] += xi[n];
-		}
+		mInputs[i - 1] = &getInput(i);
 	}
+	y.setToSum(inputs ? &mInputs[0] : 0, inputs, frames);
 }
-
-
-
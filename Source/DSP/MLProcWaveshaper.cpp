@@ -0,0 +1,404 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLDSPUtils.h"
+
+// ----------------------------------------------------------------
+// class definition
+
+// a waveshaper with built-in antialiasing. 
+//
+// shape: 0 = tanh, 1 = cubic soft clip, 2 = sine fold, 3 = hard clip.
+// drive: gain applied before the shape.
+// oversample: 1, 2 or 4. The shape is run at this multiple of the sample rate
+// between MLUpsample2x and MLDownsample2x stages.
+// adaa: if on, use first-order antiderivative antialiasing, at the oversampled
+// rate if oversampling is on. This adds half a sample of delay. 
+//
+// a constant input makes a constant output without running the filters, once the
+// filters have settled to that input. Until then it is run through them, so there 
+// is no step when the input starts or stops changing.
+
+enum eMLWaveshape
+{
+	kMLShapeTanh = 0,
+	kMLShapeCubic,
+	kMLShapeFold,
+	kMLShapeHardClip
+};
+
+class MLProcWaveshaper : public MLProc
+{
+public:
+	 MLProcWaveshaper();
+	~MLProcWaveshaper();
+
+	err resize();
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcWaveshaper> mInfo;
+	void doParams();
+	void shapeVector(const MLSample* x, MLSample* y, const int frames);
+	void shapeVectorADAA(const MLSample* x, MLSample* y, const int frames);
+
+	int mShape;
+	int mOversample;
+	bool mADAA;
+	MLSample mDrive;
+
+	MLUpsample2x mUp1, mUp2;
+	MLDownsample2x mDown1, mDown2;
+	MLSignal mBuffer1, mBuffer2, mBuffer3;
+
+	// ADAA history and scratch space. Index 3 of each holds the last
+	// sample of the previous vector, and the vector starts at index 4.
+	MLSignal mADAAInput, mADAAIntegral;
+	MLSample mPrevX, mPrevF;
+
+	// true if the oversampling filters have settled to a constant input. 
+	bool mSettled;
+	MLSample mSettledInput, mSettledOutput;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcWaveshaper> classReg("waveshaper");
+	ML_UNUSED MLProcParam<MLProcWaveshaper> params[] = { "shape", "drive", "oversample", "adaa" };
+	ML_UNUSED MLProcInput<MLProcWaveshaper> inputs[] = { "in" };
+	ML_UNUSED MLProcOutput<MLProcWaveshaper> outputs[] = { "out" };
+}
+
+// ----------------------------------------------------------------
+// shapes and their antiderivatives
+
+static inline __m128 shape4(const __m128 x, const int shape)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 minusOne = _mm_set1_ps(-1.f);
+	switch(shape)
+	{
+		case kMLShapeTanh:
+		default:
+			return tanhPrecise4(x);
+		case kMLShapeCubic:
+		{
+			// 1.5x - 0.5x^3 on [-1, 1]
+			const __m128 c = _mm_min_ps(_mm_max_ps(x, minusOne), one);
+			return _mm_mul_ps(c, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(c, c))));
+		}
+		case kMLShapeFold:
+			return sinPrecise4(_mm_mul_ps(x, _mm_set1_ps(kMLPi*0.5f)));
+		case kMLShapeHardClip:
+			return _mm_min_ps(_mm_max_ps(x, minusOne), one);
+	}
+}
+
+static inline __m128 antiderivative4(const __m128 x, const int shape)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 ax = _mm_andnot_ps(signMask, x);
+	switch(shape)
+	{
+		case kMLShapeTanh:
+		default:
+		{
+			// log(cosh(x)) = |x| + log(1 + e^(-2|x|)) - log(2)
+			const __m128 t = exp2Precise4(_mm_mul_ps(ax, _mm_set1_ps(-2.88539008f)));
+			const __m128 l = _mm_mul_ps(log2Precise4(_mm_add_ps(one, t)), _mm_set1_ps(0.693147181f));
+			return _mm_sub_ps(_mm_add_ps(ax, l), _mm_set1_ps(0.693147181f));
+		}
+		case kMLShapeCubic:
+		{
+			// 0.75x^2 - 0.125x^4 inside [-1, 1], |x| - 0.375 outside
+			const __m128 x2 = _mm_mul_ps(x, x);
+			const __m128 inner = _mm_mul_ps(x2, _mm_sub_ps(_mm_set1_ps(0.75f), _mm_mul_ps(_mm_set1_ps(0.125f), x2)));
+			const __m128 outer = _mm_sub_ps(ax, _mm_set1_ps(0.375f));
+			const __m128 inside = _mm_cmple_ps(ax, one);
+			return _mm_or_ps(_mm_and_ps(inside, inner), _mm_andnot_ps(inside, outer));
+		}
+		case kMLShapeFold:
+			// -(2/pi)cos(pi x/2)
+			return _mm_mul_ps(cosPrecise4(_mm_mul_ps(x, _mm_set1_ps(kMLPi*0.5f))), _mm_set1_ps(-2.f/kMLPi));
+		case kMLShapeHardClip:
+		{
+			// x^2/2 inside [-1, 1], |x| - 0.5 outside
+			const __m128 inner = _mm_mul_ps(_mm_mul_ps(x, x), _mm_set1_ps(0.5f));
+			const __m128 outer = _mm_sub_ps(ax, _mm_set1_ps(0.5f));
+			const __m128 inside = _mm_cmple_ps(ax, one);
+			return _mm_or_ps(_mm_and_ps(inside, inner), _mm_andnot_ps(inside, outer));
+		}
+	}
+}
+
+static inline MLSample shape1(const MLSample x, const int shape)
+{
+	float r[kSSEVecSize];
+	_mm_storeu_ps(r, shape4(_mm_set1_ps(x), shape));
+	return r[0];
+}
+
+static inline MLSample antiderivative1(const MLSample x, const int shape)
+{
+	float r[kSSEVecSize];
+	_mm_storeu_ps(r, antiderivative4(_mm_set1_ps(x), shape));
+	return r[0];
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcWaveshaper::MLProcWaveshaper() :
+	mShape(kMLShapeTanh),
+	mOversample(1),
+	mADAA(false),
+	mDrive(1.f),
+	mPrevX(0.f),
+	mPrevF(0.f),
+	mSettled(false),
+	mSettledInput(0.f),
+	mSettledOutput(0.f)
+{
+	setParam("shape", 0);
+	setParam("drive", 1.f);
+	setParam("oversample", 2);
+	setParam("adaa", 0);
+}
+
+MLProcWaveshaper::~MLProcWaveshaper()
+{
+}
+
+MLProc::err MLProcWaveshaper::resize()
+{
+	MLProc::err e = OK;
+	const int vecSize = getContextVectorSize();
+	if (!mBuffer1.setDims(vecSize*4) || !mBuffer2.setDims(vecSize*4) || !mBuffer3.setDims(vecSize*4))
+	{
+		e = memErr;
+	}
+	if (!mADAAInput.setDims(vecSize*4 + kSSEVecSize) || !mADAAIntegral.setDims(vecSize*4 + kSSEVecSize))
+	{
+		e = memErr;
+	}
+	return e;
+}
+
+void MLProcWaveshaper::clear()
+{
+	mUp1.clear();
+	mUp2.clear();
+	mDown1.clear();
+	mDown2.clear();
+	mPrevX = 0.f;
+	mPrevF = antiderivative1(0.f, mShape);
+	mSettled = false;
+}
+
+void MLProcWaveshaper::doParams()
+{
+	static const MLSymbol shapeSym("shape");
+	static const MLSymbol driveSym("drive");
+	static const MLSymbol oversampleSym("oversample");
+	static const MLSymbol adaaSym("adaa");
+
+	const int shape = clamp((int)getParam(shapeSym), (int)kMLShapeTanh, (int)kMLShapeHardClip);
+	const int os = (int)getParam(oversampleSym);
+	const int oversample = (os >= 4) ? 4 : (os >= 2) ? 2 : 1;
+	const bool adaa = getParam(adaaSym) > 0.f;
+	mDrive = getParam(driveSym);
+	if ((shape != mShape) || (oversample != mOversample) || (adaa != mADAA))
+	{
+		mShape = shape;
+		mOversample = oversample;
+		mADAA = adaa;
+		clear();
+	}
+	mParamsChanged = false;
+}
+
+void MLProcWaveshaper::shapeVector(const MLSample* x, MLSample* y, const int frames)
+{
+	const int shape = mShape;
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	for (n=0; n<vFrames; n += kSSEVecSize)
+	{
+		_mm_store_ps(y + n, shape4(_mm_load_ps(x + n), shape));
+	}
+	for (; n<frames; ++n)
+	{
+		y[n] = shape1(x[n], shape);
+	}
+}
+
+// y[n] = (F(x[n]) - F(x[n-1])) / (x[n] - x[n-1]), or f at the midpoint if the 
+// difference is too small to divide by.
+void MLProcWaveshaper::shapeVectorADAA(const MLSample* x, MLSample* y, const int frames)
+{
+	const int shape = mShape;
+	MLSample* px = mADAAInput.getBuffer() + kSSEVecSize;
+	MLSample* pf = mADAAIntegral.getBuffer() + kSSEVecSize;
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	
+	px[-1] = mPrevX;
+	pf[-1] = mPrevF;
+	for (n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 vx = _mm_load_ps(x + n);
+		_mm_store_ps(px + n, vx);
+		_mm_store_ps(pf + n, antiderivative4(vx, shape));
+	}
+	for (; n<frames; ++n)
+	{
+		px[n] = x[n];
+		pf[n] = antiderivative1(x[n], shape);
+	}
+	
+	const __m128 eps = _mm_set1_ps(1e-3f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	for (n=0; n<vFrames; n += kSSEVecSize)
+	{
+		const __m128 x1 = _mm_load_ps(px + n);
+		const __m128 x0 = _mm_loadu_ps(px + n - 1);
+		const __m128 dx = _mm_sub_ps(x1, x0);
+		const __m128 small = _mm_cmplt_ps(_mm_andnot_ps(signMask, dx), eps);
+		const __m128 df = _mm_sub_ps(_mm_load_ps(pf + n), _mm_loadu_ps(pf + n - 1));
+		
+		// avoid dividing by a tiny dx in lanes that will use the midpoint.
+		const __m128 safeDx = _mm_or_ps(_mm_andnot_ps(small, dx), _mm_and_ps(small, _mm_set1_ps(1.f)));
+		const __m128 ratio = _mm_div_ps(df, safeDx);
+		__m128 r = _mm_andnot_ps(small, ratio);
+		if (_mm_movemask_ps(small))
+		{
+			const __m128 mid = shape4(_mm_mul_ps(_mm_add_ps(x0, x1), half), shape);
+			r = _mm_or_ps(r, _mm_and_ps(small, mid));
+		}
+		_mm_store_ps(y + n, r);
+	}
+	for (; n<frames; ++n)
+	{
+		const MLSample dx = px[n] - px[n - 1];
+		y[n] = (fabsf(dx) < 1e-3f) ? shape1((px[n] + px[n - 1])*0.5f, shape) : (pf[n] - pf[n - 1])/dx;
+	}
+	mPrevX = px[frames - 1];
+	mPrevF = pf[frames - 1];
+}
+
+void MLProcWaveshaper::process(const int frames)
+{
+	const MLSignal& x = getInput(1);
+	MLSignal& y = getOutput();
+
+	if (mParamsChanged) doParams();
+
+	const bool constantInput = x.isConstant();
+	const MLSample constantIn = x[0]*mDrive;
+	if (constantInput)
+	{
+		if (mOversample == 1)
+		{
+			y.setToConstant(shape1(constantIn, mShape));
+			mPrevX = constantIn;
+			mPrevF = antiderivative1(constantIn, mShape);
+			return;
+		}
+		if (mSettled && (constantIn == mSettledInput))
+		{
+			y.setToConstant(mSettledOutput);
+			return;
+		}
+	}
+	mSettled = false;
+	
+	// apply drive.
+	const MLSample* px = x.getConstBuffer();
+	MLSample* p1 = mBuffer1.getBuffer();
+	MLSample* p2 = mBuffer2.getBuffer();
+	MLSample* p3 = mBuffer3.getBuffer();
+	const __m128 vDrive = _mm_set1_ps(mDrive);
+	const int vFrames = frames & ~(kSSEVecSize - 1);
+	int n;
+	if (constantInput)
+	{
+		std::fill(p1, p1 + frames, constantIn);
+	}
+	else
+	{
+		for (n=0; n<vFrames; n += kSSEVecSize)
+		{
+			_mm_store_ps(p1 + n, _mm_mul_ps(_mm_load_ps(px + n), vDrive));
+		}
+		for (; n<frames; ++n)
+		{
+			p1[n] = px[n]*mDrive;
+		}
+	}
+
+	// upsample to the shaping rate. 
+	MLSample* py = y.getBuffer();
+	MLSample* pIn = p1;
+	MLSample* pOut = py;
+	if (mOversample >= 2)
+	{
+		mUp1.processVector(p1, p2, frames);
+		pIn = p2;
+		pOut = p3;
+	}
+	if (mOversample == 4)
+	{
+		mUp2.processVector(p2, p3, frames*2);
+		pIn = p3;
+		pOut = p2;
+	}
+	
+	const int shapeFrames = frames*mOversample;
+	if (mADAA)
+	{
+		shapeVectorADAA(pIn, pOut, shapeFrames);
+	}
+	else
+	{
+		shapeVector(pIn, pOut, shapeFrames);
+	}
+
+	// downsample back to our rate.
+	switch(mOversample)
+	{
+		case 1:
+		default:
+			break;
+		case 2:
+			mDown1.processVector(pOut, py, shapeFrames);
+			break;
+		case 4:
+			mDown2.processVector(pOut, p1, shapeFrames);
+			mDown1.processVector(p1, py, frames*2);
+			break;
+	}
+	y.setConstant(false);
+	
+	// with a constant input, the filters have settled once the output stops changing.
+	if (constantInput)
+	{
+		const MLSample last = py[frames - 1];
+		const MLSample tolerance = 1e-6f*max(fabsf(last), 1.f);
+		mSettled = true;
+		for (n=0; n<frames; ++n)
+		{
+			mSettled &= (fabsf(py[n] - last) < tolerance);
+		}
+		mSettledInput = constantIn;
+		mSettledOutput = last;
+	}
+}
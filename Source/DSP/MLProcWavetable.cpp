@@ -0,0 +1,185 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLProc.h"
+#include "MLWavetable.h"
+
+// ----------------------------------------------------------------
+// class definition
+
+// a table lookup oscillator. The table is read from the shared MLWavetableBank,
+// so any number of voices can play the same tables without copying them.
+// the mip level is chosen for each sample from the instantaneous frequency,
+// and the position input morphs between adjacent frames of the table.
+
+class MLProcWavetable : public MLProc
+{
+public:
+	 MLProcWavetable();
+	~MLProcWavetable();
+
+	void clear();
+	void process(const int n);
+	MLProcInfoBase& procInfo() { return mInfo; }
+
+private:
+	MLProcInfo<MLProcWavetable> mInfo;
+	void doParams();
+
+	// read one vector of four samples from the table into y.
+	inline __m128 readVector(const MLWavetable* pTable, const float* pPhase, const int* pLevel, const float* pPos);
+
+	int mTableIndex;
+	bool mCubic;
+	float mPhase;
+};
+
+// ----------------------------------------------------------------
+// registry section
+
+namespace
+{
+	MLProcRegistryEntry<MLProcWavetable> classReg("wavetable");
+	ML_UNUSED MLProcParam<MLProcWavetable> params[] = { "table", "interpolation" };
+	ML_UNUSED MLProcInput<MLProcWavetable> inputs[] = { "frequency", "position" };
+	ML_UNUSED MLProcOutput<MLProcWavetable> outputs[] = { "out" };
+}
+
+// ----------------------------------------------------------------
+// implementation
+
+MLProcWavetable::MLProcWavetable() :
+	mTableIndex(0),
+	mCubic(false),
+	mPhase(0.f)
+{
+	setParam("table", 0);
+	setParam("interpolation", 0);
+}
+
+MLProcWavetable::~MLProcWavetable()
+{
+}
+
+void MLProcWavetable::clear()
+{
+	mPhase = 0.f;
+}
+
+void MLProcWavetable::doParams()
+{
+	static const MLSymbol tableSym("table");
+	static const MLSymbol interpSym("interpolation");
+	mTableIndex = (int)getParam(tableSym);
+	mCubic = ((int)getParam(interpSym) > 0);
+	mParamsChanged = false;
+}
+
+// gather the table values around each of four phases, then interpolate
+// within each frame and between frames four samples at a time.
+inline __m128 MLProcWavetable::readVector(const MLWavetable* pTable, const float* pPhase, const int* pLevel, const float* pPos)
+{
+	const int lastFrame = pTable->getFrames() - 1;
+	float xm1[2][4], x0[2][4], x1[2][4], x2[2][4];
+	float m[4], mf[4];
+
+	for(int k=0; k<4; ++k)
+	{
+		const MLSignal& table = pTable->getLevel(pLevel[k]);
+		const int size = table.getWidth();
+		const int mask = size - 1;
+		float p = pPhase[k]*size;
+		int i = (int)p;
+		m[k] = p - i;
+
+		float f = clamp(pPos[k], 0.f, 1.f)*lastFrame;
+		int f0 = (int)f;
+		int f1 = min(f0 + 1, lastFrame);
+		mf[k] = f - f0;
+
+		const MLSample* pRow[2];
+		pRow[0] = table.getConstBuffer() + table.row(f0);
+		pRow[1] = table.getConstBuffer() + table.row(f1);
+		for(int r=0; r<2; ++r)
+		{
+			xm1[r][k] = pRow[r][(i - 1) & mask];
+			x0[r][k] = pRow[r][i & mask];
+			x1[r][k] = pRow[r][(i + 1) & mask];
+			x2[r][k] = pRow[r][(i + 2) & mask];
+		}
+	}
+
+	__m128 vm = _mm_loadu_ps(m);
+	__m128 v[2];
+	for(int r=0; r<2; ++r)
+	{
+		if(mCubic)
+		{
+			v[r] = herp4(_mm_loadu_ps(xm1[r]), _mm_loadu_ps(x0[r]), _mm_loadu_ps(x1[r]), _mm_loadu_ps(x2[r]), vm);
+		}
+		else
+		{
+			v[r] = lerp4(_mm_loadu_ps(x0[r]), _mm_loadu_ps(x1[r]), vm);
+		}
+	}
+	return lerp4(v[0], v[1], _mm_loadu_ps(mf));
+}
+
+void MLProcWavetable::process(const int frames)
+{
+	const MLSignal& freq = getInput(1);
+	const MLSignal& position = getInput(2);
+	MLSignal& y = getOutput();
+
+	if (mParamsChanged) doParams();
+
+	const MLWavetable* pTable = MLWavetableBank::theBank().getTable(mTableIndex);
+	if(!pTable)
+	{
+		y.setToConstant(0.f);
+		return;
+	}
+	y.setConstant(false);
+
+	const float invSr = getContextInvSampleRate();
+	const bool constantFreq = freq.isConstant();
+	int constantLevel = pTable->getLevelForIncrement(freq[0]*invSr);
+
+	float phase[4], pos[4];
+	int level[4];
+	MLSample* py = y.getBuffer();
+	for (int n=0; n<frames; n += kSSEVecSize)
+	{
+		const int lanes = min((int)kSSEVecSize, frames - n);
+		for(int k=0; k<4; ++k)
+		{
+			if(k < lanes)
+			{
+				float inc = freq[n + k]*invSr;
+				mPhase += inc;
+				mPhase -= floorf(mPhase);
+				level[k] = constantFreq ? constantLevel : pTable->getLevelForIncrement(inc);
+				pos[k] = position[n + k];
+			}
+			else
+			{
+				level[k] = level[0];
+				pos[k] = pos[0];
+			}
+			phase[k] = mPhase;
+		}
+
+		__m128 vy = readVector(pTable, phase, level, pos);
+		if(lanes == kSSEVecSize)
+		{
+			_mm_store_ps(py + n, vy);
+		}
+		else
+		{
+			float tail[4];
+			_mm_storeu_ps(tail, vy);
+			std::copy(tail, tail + lanes, py + n);
+		}
+	}
+}
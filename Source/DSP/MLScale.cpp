@@ -5,13 +5,72 @@
 
 #include "MLScale.h"
 
-MLScale::MLScale()
+// ----------------------------------------------------------------
+#pragma mark MLScaleQuantizeTable
+
+MLScaleQuantizeTable::MLScaleQuantizeTable() :
+	mStart(0.f),
+	mCellsPerOctave(1.f)
+{
+	for(int i=0; i<kMLNumRatios; ++i)
+	{
+		mPitches[i] = mMidpoints[i] = 0.f;
+	}
+	for(int c=0; c<kMLQuantizeTableSize; ++c)
+	{
+		mCells[c] = 0;
+	}
+}
+
+MLScaleQuantizeTable::~MLScaleQuantizeTable()
+{
+}
+
+void MLScaleQuantizeTable::build(const float* pitches)
+{
+	for(int i=0; i<kMLNumRatios; ++i)
+	{
+		mPitches[i] = pitches[i];
+	}
+	for(int i=0; i<kMLNumRatios - 1; ++i)
+	{
+		mMidpoints[i] = (mPitches[i] + mPitches[i + 1])*0.5f;
+	}
+	mMidpoints[kMLNumRatios - 1] = mPitches[kMLNumRatios - 1];
+	
+	mStart = mPitches[0];
+	const float range = mPitches[kMLNumRatios - 1] - mStart;
+	mCellsPerOctave = (range > 0.f) ? (float)kMLQuantizeTableSize / range : 1.f;
+	const float cellSize = 1.f/mCellsPerOctave;
+	int i = 0;
+	for(int c=0; c<kMLQuantizeTableSize; ++c)
+	{
+		const float edge = mStart + c*cellSize;
+		while((i < kMLNumRatios - 1) && (edge > mMidpoints[i]))
+		{
+			i++;
+		}
+		mCells[c] = i;
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLScale
+
+MLScale::MLScale() :
+	mpQuantizeTable(&mQuantizeTables[0])
 {
 	setDefaultScale();
 	setDefaultMapping();
 	recalcRatios();
 }
 
+MLScale::MLScale(const MLScale& b) :
+	mpQuantizeTable(&mQuantizeTables[0])
+{
+	*this = b;
+}
+
 MLScale::~MLScale()
 {
 
@@ -31,6 +90,7 @@ void MLScale::operator= (const MLScale& b)
 	{
 		mNotes[n] = b.mNotes[n];
 	}
+	buildQuantizeTable();
 }
 
 void MLScale::setDefaultScale()
@@ -85,6 +145,16 @@ void MLScale::recalcRatios()
 		mRatios[i] = (float)octaveStartRatio*mRatioList[noteInOctave];
 		mPitches[i] = log2(mRatios[i]);
 	}
+	buildQuantizeTable();
+}
+
+// build the quantize table in the buffer not in use, then swap.
+void MLScale::buildQuantizeTable()
+{
+	MLScaleQuantizeTable* pNext = (mpQuantizeTable == &mQuantizeTables[0]) ? &mQuantizeTables[1] : &mQuantizeTables[0];
+	pNext->build(mPitches);
+	__sync_synchronize();
+	mpQuantizeTable = pNext;
 }
 
 // set up a default scale mapping.  we choose to make octaves on the keyboard wrap to octaves
@@ -148,20 +218,10 @@ float MLScale::noteToPitch(int note)
 }
 
 // quantize an incoming pitch in linear octave space. 
-//
 float MLScale::quantizePitch(float a)
 {
-	float r = 1.0f;
-	for (int i = kMLNumRatios - 1; i > 0; i--)
-	{
-		float p = mPitches[i];
-		if(p <= a) 
-		{
-			r = p;
-			break;
-		}
-	}
-	return r;
+	const MLScaleQuantizeTable* t = mpQuantizeTable;
+	return t->getPitch(t->getNearestIndex(a));
 }
 
 void MLScale::setName(const char* nameStr)
@@ -13,14 +13,62 @@
 
 const int kMLNumRatios = 256;
 const int kMLNumScaleNotes = 128;
+const int kMLQuantizeTableSize = 4096;
+
+// a lookup table for finding the nearest pitch in a scale, in linear octave space.
+// The pitch range of the scale is divided into equal cells, and each cell stores the 
+// index of the nearest scale pitch to its lower edge. A lookup then checks the 
+// midpoints between that pitch and the following ones, so the result is exact for 
+// any size of cell, and usually takes one comparison.
+
+class MLScaleQuantizeTable
+{
+public:
+	MLScaleQuantizeTable();
+	~MLScaleQuantizeTable();
+	
+	// build from kMLNumRatios pitches in increasing order.
+	void build(const float* pitches);
+
+	inline int getNearestIndex(float pitch) const
+	{
+		int c = (int)((pitch - mStart)*mCellsPerOctave);
+		return getNearestIndexInCell(clamp(c, 0, kMLQuantizeTableSize - 1), pitch);
+	}
+	
+	// finish a lookup for a pitch in cell c.
+	inline int getNearestIndexInCell(int c, float pitch) const
+	{
+		int i = mCells[c];
+		while((i < kMLNumRatios - 1) && (pitch > mMidpoints[i]))
+		{
+			i++;
+		}
+		return i;
+	}
+	inline float getPitch(int i) const { return mPitches[i]; }
+	inline float getStart() const { return mStart; }
+	inline float getCellsPerOctave() const { return mCellsPerOctave; }
+	
+private:
+	float mPitches[kMLNumRatios];
+	
+	// midpoint between each pitch and the next.
+	float mMidpoints[kMLNumRatios];
+	uint8_t mCells[kMLQuantizeTableSize];
+	float mStart;
+	float mCellsPerOctave;
+};
 
 class MLScale
 {
 
 public:
 	MLScale();
+	MLScale(const MLScale& b);
 	~MLScale();
 
+	// copies build their own quantize table, so mpQuantizeTable never points into another scale.
 	void operator= (const MLScale& b);
 	void setDefaultScale();
 	void clear();
@@ -41,8 +89,14 @@ public:
 	float noteToPitch(float note);
 	float noteToPitch(int note);
 
+	// return the pitch in the scale nearest to a, in linear octave space.
 	float quantizePitch(float a);
 	
+	// get the current quantize table. recalcRatios() builds a new table in a second buffer 
+	// and then swaps, so the audio thread can keep using a table it got in one process() 
+	// call while the scale is reloaded, unless the scale changes twice during that call.
+	const MLScaleQuantizeTable* getQuantizeTable() const { return mpQuantizeTable; }
+	
 //	double noteToFrequency(int note);  // requires tonic, maybe implement with .kbm mappings
 
 	void setName(const char* nameStr);
@@ -70,6 +124,10 @@ private:
 	// mappings from note number to pitch number.
 	int mNotes[kMLNumScaleNotes];
 	
+	void buildQuantizeTable();
+	MLScaleQuantizeTable mQuantizeTables[2];
+	const MLScaleQuantizeTable* volatile mpQuantizeTable;
+	
 };
 
 
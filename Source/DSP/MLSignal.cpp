@@ -181,6 +181,12 @@ MLSample* MLSignal::setDims (int width, int height, int depth)
 	return mDataAligned;
 }
 
+void MLSignal::setExternalData(MLSample* p)
+{
+	mDataAligned = p ? p : (mData ? alignToCacheLine(mData) : 0);
+	setConstant(false);
+}
+
 // make the copy buffer if needed. 
 // then copy the current data to the copy buffer and return the start of the copy.
 //
@@ -532,6 +538,106 @@ void MLSignal::add(const MLSignal& b)
 	}
 }
 
+// add one group of up to kMaxSumGroup inputs to y. if accumulate is false,
+// y is overwritten, so any input that is also y must be in the first group.
+static const int kMaxSumGroup = 8;
+static void sumGroup(MLSample* y, const MLSample* const* px, const int count,
+	const MLSample offset, const bool accumulate, const int frames)
+{
+	const int vectors = frames >> kMLSamplesPerSSEVectorBits;
+	const __m128 vOffset = _mm_set1_ps(offset);
+	for(int v = 0; v < vectors; ++v)
+	{
+		const int i = v << kMLSamplesPerSSEVectorBits;
+		__m128 acc = accumulate ? _mm_load_ps(y + i) : vOffset;
+		__m128 acc2 = _mm_setzero_ps();
+		int k = 0;
+		for(; k + 1 < count; k += 2)
+		{
+			acc = _mm_add_ps(acc, _mm_load_ps(px[k] + i));
+			acc2 = _mm_add_ps(acc2, _mm_load_ps(px[k + 1] + i));
+		}
+		if(k < count)
+		{
+			acc = _mm_add_ps(acc, _mm_load_ps(px[k] + i));
+		}
+		_mm_store_ps(y + i, _mm_add_ps(acc, acc2));
+	}
+	for(int i = vectors << kMLSamplesPerSSEVectorBits; i < frames; ++i)
+	{
+		MLSample sum = accumulate ? y[i] : offset;
+		for(int k = 0; k < count; ++k)
+		{
+			sum += px[k][i];
+		}
+		y[i] = sum;
+	}
+}
+
+void MLSignal::setToSum(const MLSignal* const* inputs, const int numInputs, const int frames)
+{
+	// fold constants, and find out how many times this signal is an input.
+	MLSample offset = 0.f;
+	int variables = 0;
+	int selfInputs = 0;
+	for(int j = 0; j < numInputs; ++j)
+	{
+		const MLSignal* x = inputs[j];
+		if(x->isConstant())
+		{
+			offset += x->mDataAligned[0];
+		}
+		else if(x == this)
+		{
+			selfInputs++;
+		}
+		else
+		{
+			variables++;
+		}
+	}
+	
+	if(variables + selfInputs == 0)
+	{
+		setToConstant(offset);
+		return;
+	}
+
+	MLSample* py = mDataAligned;
+	const MLSample* group[kMaxSumGroup];
+	int count = 0;
+	bool accumulate = false;
+	
+	// this signal goes in the first group, so it is read before it is written.
+	for(int j = 0; j < selfInputs; ++j)
+	{
+		group[count++] = py;
+		if(count == kMaxSumGroup)
+		{
+			sumGroup(py, group, count, offset, accumulate, frames);
+			accumulate = true;
+			count = 0;
+		}
+	}
+	for(int j = 0; j < numInputs; ++j)
+	{
+		const MLSignal* x = inputs[j];
+		if(x->isConstant() || (x == this)) continue;
+		group[count++] = x->mDataAligned;
+		if(count == kMaxSumGroup)
+		{
+			sumGroup(py, group, count, offset, accumulate, frames);
+			accumulate = true;
+			count = 0;
+		}
+	}
+	if(count > 0)
+	{
+		sumGroup(py, group, count, offset, accumulate, frames);
+	}
+	setConstant(false);
+}
+
 // TODO SSE
 void MLSignal::subtract(const MLSignal& b)
 {
@@ -1250,17 +1356,7 @@ void MLSignal::ssign()
 void MLSignal::log2Approx()
 {
 	MLSample* px1 = getBuffer();
-    
-	int c = getSize() >> kMLSamplesPerSSEVectorBits;
-	__m128 vx1, vy1;
-	
-	for (int n = 0; n < c; ++n)
-	{
-		vx1 = _mm_load_ps(px1);
-		vy1 = log2Approx4(vx1); 		
-		_mm_store_ps(px1, vy1);
-		px1 += kSSEVecSize;
-	}
+	MLLog2(px1, px1, getSize(), kMLMathFast);
 }
 
 void MLSignal::setIdentity()
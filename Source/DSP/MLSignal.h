@@ -77,6 +77,11 @@ public:
 		return mDataAligned;
 	}
 	
+	// use external memory for the signal's data, or the signal's own data again if p is 0.
+	// p must be aligned for SSE and hold all the samples that will be read or written 
+	// while it is in use. The signal does not own p.
+	void setExternalData(MLSample* p);
+	
 	// --------------------------------------------------------------------------------
 	// 1-D access methods 
 	//
@@ -341,6 +346,12 @@ public:
 	void add(const MLSample k);	
 	void subtract(const MLSample k);	
 	void subtractFrom(const MLSample k);	
+
+	// set the first frames samples to the sum of numInputs signals. Constant inputs
+	// are folded into one offset and constant zero inputs are skipped. The other
+	// inputs are added up to eight at a time, so there is one pass over this
+	// signal for each eight. Any input may be this signal.
+	void setToSum(const MLSignal* const* inputs, const int numInputs, const int frames);
 	
 	// should these be friends?  
 	void sigClamp(const MLSample min, const MLSample max);	
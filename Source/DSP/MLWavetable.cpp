@@ -0,0 +1,156 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLWavetable.h"
+
+// ----------------------------------------------------------------
+#pragma mark decimation filter
+
+// half width of the windowed-sinc kernel used to make each level from the one above.
+static const int kDecimateHalfWidth = 63;
+
+// cutoff in cycles per sample of the larger table. A little below the new Nyquist
+// frequency of 0.25, so that the transition band is mostly removed before decimating.
+static const float kDecimateCutoff = 0.21f;
+
+// make a Blackman-windowed sinc lowpass kernel with unity gain at DC.
+static void makeDecimateKernel(std::vector<float>& k)
+{
+	const int width = kDecimateHalfWidth*2 + 1;
+	k.resize(width);
+	float sum = 0.f;
+	for(int i=0; i<width; ++i)
+	{
+		int n = i - kDecimateHalfWidth;
+		float s = (n == 0) ? 1.f : sinf(kMLTwoPi*kDecimateCutoff*n) / (kMLTwoPi*kDecimateCutoff*n);
+		float w = 0.42f - 0.5f*cosf(kMLTwoPi*i/(width - 1)) + 0.08f*cosf(2.f*kMLTwoPi*i/(width - 1));
+		k[i] = s*w;
+		sum += k[i];
+	}
+	for(int i=0; i<width; ++i)
+	{
+		k[i] /= sum;
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLWavetable
+
+MLWavetable::MLWavetable() :
+	mFrames(0),
+	mFrameSize(0),
+	mMaxLevel(0)
+{
+}
+
+MLWavetable::~MLWavetable()
+{
+}
+
+bool MLWavetable::build(const MLSignal& src, int frameSize)
+{
+	int frames, size;
+	if (src.getHeight() > 1)
+	{
+		frames = src.getHeight();
+		size = src.getWidth();
+	}
+	else
+	{
+		size = frameSize ? frameSize : src.getWidth();
+		frames = src.getWidth() / size;
+	}
+	if ((frames < 1) || (size < kMLWavetableMinLevelSize) || (size != (1 << ilog2(size))))
+	{
+		debug() << "MLWavetable::build: bad frame size " << size << "\n";
+		return false;
+	}
+
+	mLevels.clear();
+	mFrames = frames;
+	mFrameSize = size;
+
+	// copy source frames to level 0.
+	MLSignalPtr pTop(new MLSignal(size, frames));
+	const MLSample* pSrc = src.getConstBuffer();
+	for(int j=0; j<frames; ++j)
+	{
+		const MLSample* pSrcFrame = (src.getHeight() > 1) ? pSrc + src.row(j) : pSrc + j*size;
+		std::copy(pSrcFrame, pSrcFrame + size, pTop->getBuffer() + pTop->row(j));
+	}
+	mLevels.push_back(pTop);
+
+	// make band-limited levels down to the minimum size.
+	for(int levelSize = size >> 1; levelSize >= kMLWavetableMinLevelSize; levelSize >>= 1)
+	{
+		MLSignalPtr pLevel(new MLSignal(levelSize, frames));
+		makeNextLevel(*mLevels.back(), *pLevel);
+		mLevels.push_back(pLevel);
+	}
+	mMaxLevel = (int)mLevels.size() - 1;
+	return true;
+}
+
+// low-pass and decimate each frame of src into dest. Because each frame is a single cycle,
+// the filter wraps around the ends of the frame, which keeps the result periodic and in phase
+// with the level above.
+void MLWavetable::makeNextLevel(const MLSignal& src, MLSignal& dest)
+{
+	static std::vector<float> kernel;
+	if (kernel.empty())
+	{
+		makeDecimateKernel(kernel);
+	}
+
+	const int srcSize = src.getWidth();
+	const int srcMask = srcSize - 1;
+	const int destSize = dest.getWidth();
+	const int width = (int)kernel.size();
+	for(int j=0; j<mFrames; ++j)
+	{
+		const MLSample* pSrc = src.getConstBuffer() + src.row(j);
+		MLSample* pDest = dest.getBuffer() + dest.row(j);
+		for(int i=0; i<destSize; ++i)
+		{
+			float sum = 0.f;
+			int base = 2*i - kDecimateHalfWidth;
+			for(int k=0; k<width; ++k)
+			{
+				sum += kernel[k]*pSrc[(base + k) & srcMask];
+			}
+			pDest[i] = sum;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark MLWavetableBank
+
+MLWavetableBank::MLWavetableBank()
+{
+	for(int i=0; i<kMLMaxWavetables; ++i)
+	{
+		mTablePtrs[i] = 0;
+	}
+}
+
+MLWavetableBank::~MLWavetableBank()
+{
+}
+
+void MLWavetableBank::setTable(int index, MLWavetablePtr pTable)
+{
+	if (!within(index, 0, kMLMaxWavetables)) return;
+	if (mTables[index])
+	{
+		mRetiredTables.push_back(mTables[index]);
+	}
+	mTables[index] = pTable;
+	mTablePtrs[index] = pTable.get();
+}
+
+void MLWavetableBank::releaseUnusedTables()
+{
+	mRetiredTables.clear();
+}
@@ -0,0 +1,110 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#ifndef _ML_WAVETABLE_H
+#define _ML_WAVETABLE_H
+
+#include <vector>
+
+#include "MLDSP.h"
+#include "MLSignal.h"
+
+const int kMLWavetableMinLevelSize = 4;
+const int kMLMaxWavetables = 64;
+
+// frame size of wavetable files that hold more than one frame.
+const int kMLWavetableFileFrameSize = 2048;
+
+// ----------------------------------------------------------------
+#pragma mark MLWavetable
+
+// a set of band-limited tables made from one or more single-cycle frames.
+// level 0 holds the source frames at full size. each following level holds
+// the same frames low-passed and decimated by 2, so it has half the size and
+// half the harmonics of the level above it. Each level is a 2D signal with
+// one frame per row.
+//
+// tables are built once, off the audio thread, and are read-only after that.
+
+class MLWavetable
+{
+public:
+	MLWavetable();
+	~MLWavetable();
+
+	// build all levels from src. If src is 2D, each row is one frame.
+	// if src is 1D, it is split into frames of frameSize samples.
+	// frame size must be a power of two. returns false on bad input.
+	bool build(const MLSignal& src, int frameSize = 0);
+
+	int getLevels() const { return (int)mLevels.size(); }
+	int getFrames() const { return mFrames; }
+	int getFrameSize() const { return mFrameSize; }
+	const MLSignal& getLevel(int level) const { return *mLevels[level]; }
+
+	// get the highest quality level that will not alias for a phase increment
+	// given in cycles per sample.
+	inline int getLevelForIncrement(float inc) const
+	{
+		float x = fabsf(inc)*(float)mFrameSize;
+		int level = 0;
+		if (x > 1.f)
+		{
+			level = ilog2((int)ceilf(x) - 1) + 1;
+			level = min(level, mMaxLevel);
+		}
+		return level;
+	}
+
+private:
+	MLWavetable (const MLWavetable&); // unimplemented
+	const MLWavetable& operator= (const MLWavetable&); // unimplemented
+
+	void makeNextLevel(const MLSignal& src, MLSignal& dest);
+
+	std::vector<MLSignalPtr> mLevels;
+	int mFrames;
+	int mFrameSize;
+	int mMaxLevel;
+};
+
+typedef std::tr1::shared_ptr<MLWavetable> MLWavetablePtr;
+
+// ----------------------------------------------------------------
+#pragma mark MLWavetableBank
+
+// singleton store of wavetables, shared by all wavetable procs in all voices
+// so that tables are only built and stored once. Tables are referred to by index.
+//
+// setTable() is called from outside the audio thread. Tables that are replaced
+// are kept alive until releaseUnusedTables() is called while no procs are
+// running, so a proc may finish reading a table after it has been replaced.
+
+class MLWavetableBank
+{
+public:
+	static MLWavetableBank &theBank()  { static MLWavetableBank b; return b; }
+
+	void setTable(int index, MLWavetablePtr pTable);
+
+	// get the current table at index, or 0 if none. Safe to call from process().
+	inline const MLWavetable* getTable(int index) const
+	{
+		return within(index, 0, kMLMaxWavetables) ? mTablePtrs[index] : 0;
+	}
+
+	void releaseUnusedTables();
+
+private:
+	MLWavetableBank();
+	MLWavetableBank(const MLWavetableBank &); // Not implemented
+	MLWavetableBank & operator=(const MLWavetableBank &); // Not implemented
+	~MLWavetableBank();
+
+	MLWavetablePtr mTables[kMLMaxWavetables];
+	const MLWavetable* volatile mTablePtrs[kMLMaxWavetables];
+	std::vector<MLWavetablePtr> mRetiredTables;
+};
+
+#endif // _ML_WAVETABLE_H
@@ -9,7 +9,8 @@
 enum eInputProtocol
 {
 	kInputProtocolMIDI = 0,
-	kInputProtocolOSC = 1
+	kInputProtocolOSC = 1,
+	kInputProtocolMPE = 2	// MIDI with per-note expression, in a lower zone with master channel 1
 };
 
 #endif // ML_INPUT_PROTOCOLS_H
\ No newline at end of file
@@ -46,6 +46,12 @@ File getDefaultFileLocation(eFileTypes whichFiles)
             case kScaleFiles:
                 destStr = ("Scales");
                 break;
+            case kImpulseFiles:
+                destStr = String(MLProjectInfo::projectName) + "/Impulses";
+                break;
+            case kWavetableFiles:
+                destStr = String(MLProjectInfo::projectName) + "/Wavetables";
+                break;
             case kOldPresetFiles:
                 destStr = String("Audio/Presets/") + String(MLProjectInfo::makerName) + String("/") + String(MLProjectInfo::projectName);
                 break;
@@ -16,6 +16,8 @@ enum eFileTypes
 	kPresetFiles     = 0,  
 	kScaleFiles,
 	kSampleFiles,
+	kImpulseFiles,
+	kWavetableFiles,
 	
 	// app persistent state storage
 	kAppPresetFiles,
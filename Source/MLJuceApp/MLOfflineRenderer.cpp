@@ -0,0 +1,315 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOfflineRenderer.h"
+#include "MLConvolver.h"
+
+#include <algorithm>
+
+const int kMLOfflineDefaultBlockSize = 4096;
+
+MLOfflineRenderer::MLOfflineRenderer() :
+	mInputChannels(0),
+	mOutputChannels(0),
+	mSampleRate(44100.),
+	mBlockSize(kMLOfflineDefaultBlockSize),
+	mVoiceThreads(1),
+	mBPM(120.)
+{
+	mFormatManager.registerBasicFormats();
+}
+
+MLOfflineRenderer::~MLOfflineRenderer()
+{
+	clearInputFiles();
+}
+
+MLProc::err MLOfflineRenderer::loadDescription(const char* desc, int inputChannels, int outputChannels)
+{
+	mInputChannels = clamp(inputChannels, 0, kMLEngineMaxChannels);
+	mOutputChannels = clamp(outputChannels, 1, kMLEngineMaxChannels);
+	mEngine.setInputChannels(mInputChannels);
+	mEngine.setOutputChannels(mOutputChannels);
+
+	mpDoc = new XmlDocument(String(desc));
+	MLProc::err e = mEngine.buildGraphAndInputs(&*mpDoc, mInputChannels > 0, true);
+	if (e == MLProc::OK)
+	{
+		mEngine.compileEngine();
+		if (mEngine.getCompileStatus() != MLProc::OK)
+		{
+			e = MLProc::unknownErr;
+		}
+	}
+	if (e != MLProc::OK)
+	{
+		MLError() << "MLOfflineRenderer: couldn't build graph from description!\n";
+	}
+	return e;
+}
+
+bool MLOfflineRenderer::setParam(const MLSymbol name, MLParamValue val)
+{
+	const int index = mEngine.getParamIndex(name);
+	if (index < 0) return false;
+	mEngine.setPublishedParam(index, val);
+	return true;
+}
+
+bool MLOfflineRenderer::addParamChange(const MLSymbol name, MLParamValue val, int time)
+{
+	const int index = mEngine.getParamIndex(name);
+	if (index < 0) return false;
+	ParamChange c;
+	c.index = index;
+	c.value = val;
+	c.time = max(time, 0);
+	mParamChanges.push_back(c);
+	return true;
+}
+
+void MLOfflineRenderer::addEvent(const MLControlEvent& e)
+{
+	if (e.isFree()) return;
+	mEvents.push_back(e);
+	mEvents.back().mTime = max(e.mTime, 0);
+}
+
+bool MLOfflineRenderer::addMIDIFile(const File& f)
+{
+	FileInputStream stream(f);
+	MidiFile midiFile;
+	if (stream.failedToOpen() || !midiFile.readFrom(stream))
+	{
+		MLError() << "MLOfflineRenderer: couldn't read MIDI file " << f.getFullPathName().toUTF8() << "\n";
+		return false;
+	}
+	midiFile.convertTimestampTicksToSeconds();
+
+	for(int t=0; t<midiFile.getNumTracks(); ++t)
+	{
+		const MidiMessageSequence* pTrack = midiFile.getTrack(t);
+		for(int i=0; i<pTrack->getNumEvents(); ++i)
+		{
+			const MidiMessage& message = pTrack->getEventPointer(i)->message;
+			const int time = (int)(message.getTimeStamp()*mSampleRate + 0.5);
+			const int chan = message.getChannel();
+			if (message.isNoteOn())
+			{
+				const int note = message.getNoteNumber();
+				addEvent(MLControlEvent(MLControlEvent::eNoteOn, chan, note, time, (float)note, message.getVelocity() / 127.f));
+			}
+			else if (message.isNoteOff())
+			{
+				const int note = message.getNoteNumber();
+				addEvent(MLControlEvent(MLControlEvent::eNoteOff, chan, note, time, (float)note, message.getVelocity() / 127.f));
+			}
+			else if (message.isSustainPedalOn() || message.isSustainPedalOff())
+			{
+				addEvent(MLControlEvent(MLControlEvent::eSustainPedal, chan, 0, time, message.isSustainPedalOn() ? 1.f : 0.f, 0.f));
+			}
+			else if (message.isController())
+			{
+				addEvent(MLControlEvent(MLControlEvent::eController, chan, 0, time, (float)message.getControllerNumber(), message.getControllerValue() / 127.f));
+			}
+			else if (message.isPitchWheel())
+			{
+				addEvent(MLControlEvent(MLControlEvent::ePitchWheel, chan, 0, time, (float)message.getPitchWheelValue(), 0.f));
+			}
+			else if (message.isAftertouch())
+			{
+				const int note = message.getNoteNumber();
+				addEvent(MLControlEvent(MLControlEvent::eNotePressure, chan, note, time, (float)note, message.getAfterTouchValue() / 127.f));
+			}
+			else if (message.isChannelPressure())
+			{
+				addEvent(MLControlEvent(MLControlEvent::eChannelPressure, chan, 0, time, message.getChannelPressureValue() / 127.f, 0.f));
+			}
+		}
+	}
+	return true;
+}
+
+void MLOfflineRenderer::clearEvents()
+{
+	mEvents.clear();
+	mParamChanges.clear();
+}
+
+bool MLOfflineRenderer::addInputFile(const File& f)
+{
+	int firstChannel = 0;
+	if (mInputFiles.size())
+	{
+		firstChannel = mInputFiles.back().firstChannel + mInputFiles.back().channels;
+	}
+	if (firstChannel >= mInputChannels)
+	{
+		MLError() << "MLOfflineRenderer: no engine inputs left for " << f.getFullPathName().toUTF8() << "\n";
+		return false;
+	}
+
+	AudioFormatReader* pReader = mFormatManager.createReaderFor(f);
+	if (!pReader)
+	{
+		MLError() << "MLOfflineRenderer: couldn't read audio file " << f.getFullPathName().toUTF8() << "\n";
+		return false;
+	}
+
+	InputFile in;
+	in.pReader = pReader;
+	in.firstChannel = firstChannel;
+	in.channels = min(min((int)pReader->numChannels, 2), mInputChannels - firstChannel);
+	mInputFiles.push_back(in);
+	return true;
+}
+
+void MLOfflineRenderer::clearInputFiles()
+{
+	for(unsigned i=0; i<mInputFiles.size(); ++i)
+	{
+		delete mInputFiles[i].pReader;
+	}
+	mInputFiles.clear();
+}
+
+bool MLOfflineRenderer::eventIsEarlier(const MLControlEvent& a, const MLControlEvent& b)
+{
+	return a.mTime < b.mTime;
+}
+
+bool MLOfflineRenderer::paramChangeIsEarlier(const ParamChange& a, const ParamChange& b)
+{
+	return a.time < b.time;
+}
+
+// read frames of each input file into its engine input channels. Files that have ended
+// and inputs with no file are silent.
+void MLOfflineRenderer::readInputs(AudioSampleBuffer& buffer, int startFrame, int frames)
+{
+	buffer.clear(0, frames);
+	AudioSampleBuffer fileBuffer(2, frames);
+	for(unsigned i=0; i<mInputFiles.size(); ++i)
+	{
+		const InputFile& in = mInputFiles[i];
+		in.pReader->read(&fileBuffer, 0, frames, startFrame, true, in.channels > 1);
+		for(int c=0; c<in.channels; ++c)
+		{
+			buffer.copyFrom(in.firstChannel + c, 0, fileBuffer, c, 0, frames);
+		}
+	}
+}
+
+bool MLOfflineRenderer::render(const File& outputFile, int frames, int bitsPerSample)
+{
+	if (mEngine.getCompileStatus() != MLProc::OK) return false;
+
+	const int bufSize = 1 << bitsToContain(mBlockSize);
+	const int chunkSize = min(bufSize, (int)kMLProcessChunkSize);
+	if (mEngine.prepareEngine(mSampleRate, bufSize, chunkSize) != MLProc::OK) return false;
+
+	outputFile.deleteFile();
+	FileOutputStream* pStream = outputFile.createOutputStream();
+	if (!pStream) return false;
+	WavAudioFormat wavFormat;
+	ScopedPointer<AudioFormatWriter> pWriter (wavFormat.createWriterFor(pStream, mSampleRate, mOutputChannels, bitsPerSample, StringPairArray(), 0));
+	if (!pWriter)
+	{
+		delete pStream;
+		MLError() << "MLOfflineRenderer: couldn't write " << outputFile.getFullPathName().toUTF8() << "\n";
+		return false;
+	}
+
+	std::stable_sort(mEvents.begin(), mEvents.end(), eventIsEarlier);
+	std::stable_sort(mParamChanges.begin(), mParamChanges.end(), paramChangeIsEarlier);
+
+	// size the block event list for the busiest block, with room for the null event.
+	const int events = (int)mEvents.size();
+	int maxBlockEvents = 0;
+	for(int i=0, j=0; i<events; i = j)
+	{
+		const int blockEnd = (mEvents[i].mTime / mBlockSize + 1)*mBlockSize;
+		for(j = i; (j < events) && (mEvents[j].mTime < blockEnd); ++j){}
+		maxBlockEvents = max(maxBlockEvents, j - i);
+	}
+	mBlockEvents.assign(maxBlockEvents + 1, kMLNullControlEvent);
+
+	AudioSampleBuffer inputs(max(mInputChannels, 1), mBlockSize);
+	AudioSampleBuffer outputs(mOutputChannels, mBlockSize);
+	MLDSPEngine::ClientIOMap ioMap;
+	for (int i=0; i<mInputChannels; ++i)
+	{
+		ioMap.inputs[i] = inputs.getReadPointer(i);
+	}
+	for (int i=0; i<mOutputChannels; ++i)
+	{
+		ioMap.outputs[i] = outputs.getWritePointer(i);
+	}
+	mEngine.setIOBuffers(ioMap);
+
+	// start from the same state every time. Convolution tails are computed in 
+	// process() so that they never depend on the timing of the worker.
+	mEngine.setVoiceThreads(mVoiceThreads);
+	MLConvolverWorker::theWorker().setEnabled(false);
+	mEngine.clear();
+	MLRandReset();
+	mEngine.setEnabled(true);
+
+	const int changes = (int)mParamChanges.size();
+	int nextEvent = 0;
+	int nextChange = 0;
+	bool ok = true;
+	std::vector<int> blockParams;
+	blockParams.reserve(changes);
+	for(int start = 0; start < frames; )
+	{
+		// the engine keeps only the last queued change to each param per block, so
+		// end the block early at any later change to a param already changed in it.
+		// blocks stay within the mBlockSize grid the event list was sized for.
+		int end = min((start / mBlockSize + 1)*mBlockSize, frames);
+		blockParams.clear();
+		for(int i = nextChange; (i < changes) && (mParamChanges[i].time < end); ++i)
+		{
+			const ParamChange& p = mParamChanges[i];
+			if ((p.time > start) && (std::find(blockParams.begin(), blockParams.end(), p.index) != blockParams.end()))
+			{
+				end = p.time;
+				break;
+			}
+			blockParams.push_back(p.index);
+		}
+		const int n = end - start;
+
+		int c = 0;
+		while((nextEvent < events) && (mEvents[nextEvent].mTime < end))
+		{
+			mBlockEvents[c] = mEvents[nextEvent++];
+			mBlockEvents[c++].mTime -= start;
+		}
+		mBlockEvents[c] = kMLNullControlEvent;
+
+		while((nextChange < changes) && (mParamChanges[nextChange].time < end))
+		{
+			const ParamChange& p = mParamChanges[nextChange++];
+			mEngine.queueParamChange(p.index, p.value, p.time - start);
+		}
+
+		readInputs(inputs, start, n);
+		const double secs = start / mSampleRate;
+		mEngine.processBlock(n, mBlockEvents, start, secs, secs*mBPM/60., mBPM, true);
+
+		if (!pWriter->writeFromAudioSampleBuffer(outputs, 0, n))
+		{
+			MLError() << "MLOfflineRenderer: write error!\n";
+			ok = false;
+			break;
+		}
+		start = end;
+	}
+
+	// stop the voice threads, which spin while waiting for work.
+	mEngine.setVoiceThreads(1);
+	MLConvolverWorker::theWorker().setEnabled(true);
+	return ok;
+}
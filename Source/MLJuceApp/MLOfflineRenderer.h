@@ -0,0 +1,110 @@
+// MadronaLib: a C++ framework for DSP applications.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#ifndef __ML_OFFLINE_RENDERER_H
+#define __ML_OFFLINE_RENDERER_H
+
+// MLOfflineRenderer runs an MLDSPEngine without a host, as fast as it can go.
+// A graph description is rendered with a list of timed control events and param
+// changes, and optional input audio files, to a WAV file.
+//
+// Each render starts from a cleared engine and a reset MLRand() sequence, and
+// procs with random streams seed them in clear(), so rendering the same inputs
+// gives the same output every time. This holds with voice threads too, because
+// each voice always runs on the same thread, and convolution tails are computed
+// in process() instead of on the shared convolver worker.
+
+#include "JuceHeader.h"
+#include "MLDSPEngine.h"
+#include "MLControlEvent.h"
+
+#include <vector>
+
+class MLOfflineRenderer
+{
+public:
+	MLOfflineRenderer();
+	~MLOfflineRenderer();
+
+	// build and compile the graph from a plugin description. Can be called once.
+	MLProc::err loadDescription(const char* desc, int inputChannels, int outputChannels);
+
+	void setSampleRate(double sr) { mSampleRate = sr; }
+
+	// host block size. Blocks are processed in place in vectors of kMLProcessChunkSize,
+	// so large blocks cost nothing extra in latency or copying.
+	void setBlockSize(int frames) { mBlockSize = max(frames, 1); }
+
+	// process the voices of multiple containers on this many threads.
+	void setVoiceThreads(int threads) { mVoiceThreads = max(threads, 1); }
+
+	// tempo and play state reported to the host phasor.
+	void setTempo(double bpm) { mBPM = bpm; }
+
+	// set a published param by name before rendering. returns false if there is no such param.
+	bool setParam(const MLSymbol name, MLParamValue val);
+
+	// change a published param during the render, at the given sample time from the start.
+	bool addParamChange(const MLSymbol name, MLParamValue val, int time);
+
+	// add an event with mTime in samples from the start of the render.
+	void addEvent(const MLControlEvent& e);
+
+	// add the note, controller, pitch wheel and pressure events from all tracks of a
+	// MIDI file. returns false if the file could not be read.
+	bool addMIDIFile(const File& f);
+	void clearEvents();
+
+	// add an audio file to play into the next one or two engine inputs, from the start
+	// of the render. returns false if the file could not be read.
+	bool addInputFile(const File& f);
+	void clearInputFiles();
+
+	// render frames to a WAV file. returns false on error.
+	bool render(const File& outputFile, int frames, int bitsPerSample = 24);
+
+	MLDSPEngine& getEngine() { return mEngine; }
+
+private:
+	struct ParamChange
+	{
+		int index;
+		MLParamValue value;
+		int time;
+	};
+
+	struct InputFile
+	{
+		AudioFormatReader* pReader;
+		int firstChannel;
+		int channels;
+	};
+
+	static bool eventIsEarlier(const MLControlEvent& a, const MLControlEvent& b);
+	static bool paramChangeIsEarlier(const ParamChange& a, const ParamChange& b);
+
+	void readInputs(AudioSampleBuffer& buffer, int startFrame, int frames);
+
+	MLDSPEngine mEngine;
+	ScopedPointer<XmlDocument> mpDoc;
+	int mInputChannels;
+	int mOutputChannels;
+
+	double mSampleRate;
+	int mBlockSize;
+	int mVoiceThreads;
+	double mBPM;
+
+	// events and changes for the whole render, sorted by time before rendering.
+	std::vector<MLControlEvent> mEvents;
+	std::vector<ParamChange> mParamChanges;
+
+	// the events for one block, with times from the block start and a null event after them.
+	MLControlEventVector mBlockEvents;
+
+	AudioFormatManager mFormatManager;
+	std::vector<InputFile> mInputFiles;
+};
+
+#endif // __ML_OFFLINE_RENDERER_H
@@ -4,6 +4,9 @@
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
 #include "MLPluginProcessor.h"
+#include "MLConvolver.h"
+#include "MLWavetable.h"
+
 const int kMaxControlEventsPerBlock = 1024;
 
 MLPluginProcessor::MLPluginProcessor() : 
@@ -14,7 +17,8 @@ MLPluginProcessor::MLPluginProcessor() :
 	mInitialized(false),
 	mInputProtocol(-1),
 	mT3DWaitTime(0),
-	mDataRate(-1)
+	mDataRate(-1),
+	mImpulseSampleRate(0.)
 {
 	mHasParametersSet = false;
 	mNumParameters = 0;
@@ -25,6 +29,16 @@ MLPluginProcessor::MLPluginProcessor() :
     mScaleFiles->setListener(this);
     mScaleFiles->searchForFilesNow();
     
+    // get impulse responses collection
+    mImpulseFiles = MLFileCollectionPtr(new MLFileCollection("impulses", getDefaultFileLocation(kImpulseFiles), "wav"));
+    mImpulseFiles->setListener(this);
+    mImpulseFiles->searchForFilesNow();
+    
+    // get wavetables collection
+    mWavetableFiles = MLFileCollectionPtr(new MLFileCollection("wavetables", getDefaultFileLocation(kWavetableFiles), "wav"));
+    mWavetableFiles->setListener(this);
+    mWavetableFiles->searchForFilesNow();
+    
     scanPresets();
 	scanMIDIPrograms();
     
@@ -169,9 +183,6 @@ void MLPluginProcessor::prepareToPlay (double sr, int maxFramesPerBlock)
 			chunkSize = min((int)bufSize, (int)kMLProcessChunkSize);
 		}	
 		
-		// dsp engine has one chunkSize of latency in order to run constant block size.
-		setLatencySamples(chunkSize);
-		
 		// debug() << "MLPluginProcessor: prepareToPlay: rate " << sr << ", buffer size " << bufSize << ", vector size " << vecSize << ". \n";	
 		
 		// build: turn XML description into graph of processors
@@ -208,6 +219,20 @@ void MLPluginProcessor::prepareToPlay (double sr, int maxFramesPerBlock)
 			debug() << "MLPluginProcessor: prepareToPlay error: \n";
 		}
 		
+		// the engine's latency is fixed by prepareEngine(), so it is reported once here.
+		setLatencySamples(mEngine.getLatencySamples());
+		
+		// impulses are resampled to the engine rate, so reload if it has changed.
+		const std::string& impulseName = getStringProperty("impulse_file");
+		if ((sr != mImpulseSampleRate) && !impulseName.empty())
+		{
+			const MLFilePtr f = mImpulseFiles->getFileByName(impulseName);
+			if(f != MLFilePtr())
+			{
+				loadImpulse(f->mFile, 0);
+			}
+		}
+		
 		// mEngine.dump();
 			
 		// after prepare to play, set state from saved blob if one exists
@@ -487,7 +512,7 @@ void MLPluginProcessor::setParameter (int index, float newValue)
 {
 	if (index < 0) return;	
 
-	mEngine.setPublishedParam(index, newValue);	
+	mEngine.queueParamChange(index, newValue);	
 	mHasParametersSet = true;
 	setPropertyImmediate(getParameterAlias(index), newValue);
 }
@@ -499,7 +524,7 @@ void MLPluginProcessor::setParameterWithoutProperty (MLSymbol paramName, float n
 	int index = getParameterIndex(paramName);
 	if (index < 0) return;	
 
-	mEngine.setPublishedParam(index, newValue);	
+	mEngine.queueParamChange(index, newValue);	
 	mHasParametersSet = true;
 }
 
@@ -524,7 +549,7 @@ void MLPluginProcessor::setParameterAsLinearProportion (int index, float newValu
 	if(p)
 	{
 		p->setValueAsLinearProportion(newValue);	
-		mEngine.setPublishedParam(index, p->getValue());	
+		mEngine.queueParamChange(index, p->getValue());	
 		mHasParametersSet = true;
 		
 		// set MLModel Parameter 
@@ -670,6 +695,24 @@ void MLPluginProcessor::doPropertyChangeAction(MLSymbol property, const MLProper
 			
 			break;
 		case MLProperty::kStringProperty:
+			if (property == "impulse_file")
+			{
+				// the impulse file is loaded into the first slot of the impulse bank.
+				const MLFilePtr f = mImpulseFiles->getFileByName(newVal.getStringValue());
+				if(f != MLFilePtr())
+				{
+					loadImpulse(f->mFile, 0);
+				}
+			}
+			else if (property == "wavetable_file")
+			{
+				// the wavetable file is loaded into the first slot of the wavetable bank.
+				const MLFilePtr f = mWavetableFiles->getFileByName(newVal.getStringValue());
+				if(f != MLFilePtr())
+				{
+					loadWavetable(f->mFile, 0);
+				}
+			}
 			break;
 		case MLProperty::kSignalProperty:
 			break;
@@ -725,6 +768,8 @@ void MLPluginProcessor::getStateAsXML (XmlElement& xml)
 	xml.setAttribute ("pluginVersion", JucePlugin_VersionCode);
 	xml.setAttribute ("presetName", String(getStringProperty("preset").c_str()));
 	xml.setAttribute ("scaleName", String(getStringProperty("key_scale").c_str()));
+	xml.setAttribute ("impulseName", String(getStringProperty("impulse_file").c_str()));
+	xml.setAttribute ("wavetableName", String(getStringProperty("wavetable_file").c_str()));
 
 	// store parameter values to xml as a bunch of attributes.
 	// not XML best practice in general but takes fewer characters.
@@ -921,6 +966,18 @@ void MLPluginProcessor::setStateFromXML(const XmlElement& xmlState, bool setView
         loadDefaultScale();
     }
     
+    const String impulseName = xmlState.getStringAttribute ("impulseName");
+    if(impulseName != String::empty)
+    {
+        setProperty("impulse_file", std::string(impulseName.toUTF8()));
+    }
+    
+    const String wavetableName = xmlState.getStringAttribute ("wavetableName");
+    if(wavetableName != String::empty)
+    {
+        setProperty("wavetable_file", std::string(wavetableName.toUTF8()));
+    }
+    
 	// get preset name saved in blob.  when saving from AU host, name will also be set from RestoreState().
 	const String presetName = xmlState.getStringAttribute ("presetName");
 	setProperty("preset", std::string(presetName.toUTF8()));
@@ -1484,6 +1541,135 @@ void MLPluginProcessor::loadScale(const File& f)
 	broadcastScale(pScale);
 }
 
+// read an audio file, mix it to mono and build it into the engine's impulse bank at index.
+void MLPluginProcessor::loadImpulse(const File& f, int index)
+{
+	AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+	ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor(f));
+	if (reader == nullptr)
+	{
+		MLError() << "MLPluginProcessor::loadImpulse: couldn't read " << f.getFileName() << "\n";
+		return;
+	}
+	
+	const int channels = (int)reader->numChannels;
+	const int length = (int)reader->lengthInSamples;
+	AudioSampleBuffer buffer(channels, length);
+	reader->read(&buffer, 0, length, 0, true, true);
+	
+	MLSignal ir(length);
+	const float gain = 1.f / (float)channels;
+	for(int c=0; c<channels; ++c)
+	{
+		const float* pSrc = buffer.getReadPointer(c);
+		for(int i=0; i<length; ++i)
+		{
+			ir[i] += pSrc[i]*gain;
+		}
+	}
+	
+	// resample to the engine rate with a windowed sinc, lowpassed below the new Nyquist
+	// frequency when downsampling. The result is scaled by the rate ratio to keep the same gain.
+	const double engineRate = getSampleRate();
+	if (engineRate <= 0.)
+	{
+		MLError() << "MLPluginProcessor::loadImpulse: no engine sample rate for " << f.getFileName() << "\n";
+		return;
+	}
+	if (reader->sampleRate != engineRate)
+	{
+		const double ratio = reader->sampleRate / engineRate;
+		const double fc = min(1., 1. / ratio);
+		const int halfWidth = (int)ceil(16. / fc);
+		const int newLength = max((int)(length / ratio), 1);
+		MLSignal resampled(newLength);
+		for(int i=0; i<newLength; ++i)
+		{
+			const double t = i*ratio;
+			const int k0 = (int)t;
+			const int kStart = max(k0 - halfWidth + 1, 0);
+			const int kEnd = min(k0 + halfWidth, length - 1);
+			double sum = 0.;
+			for(int k=kStart; k<=kEnd; ++k)
+			{
+				const double d = t - k;
+				const double u = kMLPi*d*fc;
+				const double sinc = (u == 0.) ? 1. : sin(u)/u;
+				const double window = 0.5 + 0.5*cos(kMLPi*d/halfWidth);
+				sum += ir[k]*fc*sinc*window;
+			}
+			resampled[i] = (MLSample)(sum*ratio);
+		}
+		ir = resampled;
+	}
+	mImpulseSampleRate = engineRate;
+	
+	// free impulses retired by earlier loads, which no convolver can still be reading.
+	// then build the new one outside the lock and swap it in.
+	{
+		const ScopedLock sl (getCallbackLock());
+		MLImpulseBank::theBank().releaseUnusedImpulses();
+	}
+	MLImpulseBank::theBank().setImpulse(index, ir);
+}
+
+// read an audio file of single-cycle frames, mix it to mono and build it into the 
+// wavetable bank at index. A file that is a power of two long up to 
+// kMLWavetableFileFrameSize samples is one frame, otherwise it is split into frames 
+// of kMLWavetableFileFrameSize samples.
+void MLPluginProcessor::loadWavetable(const File& f, int index)
+{
+	AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+	ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor(f));
+	if (reader == nullptr)
+	{
+		MLError() << "MLPluginProcessor::loadWavetable: couldn't read " << f.getFileName() << "\n";
+		return;
+	}
+	
+	const int channels = (int)reader->numChannels;
+	const int length = (int)reader->lengthInSamples;
+	int frameSize = kMLWavetableFileFrameSize;
+	if ((length <= kMLWavetableFileFrameSize) && (length == (1 << ilog2(length))))
+	{
+		frameSize = length;
+	}
+	if ((length < kMLWavetableMinLevelSize) || (length % frameSize != 0))
+	{
+		MLError() << "MLPluginProcessor::loadWavetable: " << f.getFileName() << " is not a whole number of " << frameSize << "-sample frames\n";
+		return;
+	}
+	AudioSampleBuffer buffer(channels, length);
+	reader->read(&buffer, 0, length, 0, true, true);
+	
+	MLSignal src(length);
+	const float gain = 1.f / (float)channels;
+	for(int c=0; c<channels; ++c)
+	{
+		const float* pSrc = buffer.getReadPointer(c);
+		for(int i=0; i<length; ++i)
+		{
+			src[i] += pSrc[i]*gain;
+		}
+	}
+	
+	MLWavetablePtr pTable(new MLWavetable);
+	if (!pTable->build(src, frameSize))
+	{
+		MLError() << "MLPluginProcessor::loadWavetable: couldn't build " << f.getFileName() << "\n";
+		return;
+	}
+	
+	// swap the new table in, then free the old one once no proc can still be reading it.
+	MLWavetableBank::theBank().setTable(index, pTable);
+	{
+		const ScopedLock sl (getCallbackLock());
+		MLWavetableBank::theBank().releaseUnusedTables();
+	}
+}
+
 void MLPluginProcessor::loadDefaultScale()
 {
 	MLScale* pScale = mEngine.getScale();
@@ -1511,6 +1697,8 @@ void MLPluginProcessor::setInputProtocol(int p)
 				break;
 			case kInputProtocolOSC:
 				break;
+			case kInputProtocolMPE:
+				break;
 		}
 		mInputProtocol = p;
 	}
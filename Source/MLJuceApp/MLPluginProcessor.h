@@ -172,6 +172,14 @@ public:
 	void loadScale(const File& f);
 	void loadDefaultScale();
 	virtual void broadcastScale(const MLScale* pScale) = 0;
+
+	// impulse responses
+	
+	void loadImpulse(const File& f, int index);
+	
+	// wavetables
+	
+	void loadWavetable(const File& f, int index);
 	
 	// engine stuff
 
@@ -231,6 +239,9 @@ private:
 
     MLFileCollectionPtr mScaleFiles;
     MLFileCollectionPtr mPresetFiles;
+    MLFileCollectionPtr mImpulseFiles;
+	double mImpulseSampleRate;
+    MLFileCollectionPtr mWavetableFiles;
     
 	File mFactoryPresetsFolder, mUserPresetsFolder;
 	bool mFileLocationsOK;